@@ -0,0 +1,106 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+Measure the throughput of the bulk DiceKey index over synthetic keys.
+
+Usage: bench-dicekey-index [number-of-keys] [batch-size] [max-concurrency]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "dicekey-index.hpp"
+#include "thread-pool.hpp"
+
+// A random key with every face defined, as would be produced by shaking the dice
+static PackedDiceKey randomKey(std::mt19937_64 &random) {
+  PackedDiceKey key;
+  for (int i = 0; i < PackedDiceKey::NumberOfFaces; i++) {
+    const int letterIndex = int(random() % 25);
+    const char letter = char('A' + letterIndex + (letterIndex >= ('Q' - 'A') ? 1 : 0));
+    key.setFace(i, packFace(letter, char('1' + random() % 6), char(random() % 4)));
+  }
+  return key;
+}
+
+static double secondsSince(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *stage, size_t numberOfKeys, double seconds) {
+  printf("%-28s %10zu keys %9.3f s %14.0f keys/s\n", stage, numberOfKeys, seconds, double(numberOfKeys) / seconds);
+}
+
+int main(int argc, char **argv) {
+  const size_t numberOfKeys = argc > 1 ? size_t(strtoull(argv[1], NULL, 10)) : 1000000;
+  const size_t batchSize = argc > 2 ? size_t(strtoull(argv[2], NULL, 10)) : 65536;
+  if (argc > 3) {
+    setMaxConcurrency(unsigned(strtoul(argv[3], NULL, 10)));
+  }
+  printf("Indexing %zu keys in batches of %zu with up to %u threads\n", numberOfKeys, batchSize, getMaxConcurrency());
+
+  std::mt19937_64 random(0x5eed);
+  std::vector<PackedDiceKey> keys(numberOfKeys);
+  for (size_t i = 0; i < numberOfKeys; i++) {
+    keys[i] = randomKey(random);
+  }
+
+  // Insert one key at a time into a table that must grow
+  {
+    DiceKeyIndex index;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numberOfKeys; i++) {
+      index.insert(keys[i], uint32_t(i));
+    }
+    report("insert (growing)", numberOfKeys, secondsSince(start));
+  }
+
+  // Insert in parallel-canonicalized batches into a presized table
+  DiceKeyIndex index(numberOfKeys);
+  size_t duplicates = 0;
+  {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t first = 0; first < numberOfKeys; first += batchSize) {
+      const size_t end = first + batchSize < numberOfKeys ? first + batchSize : numberOfKeys;
+      const std::vector<PackedDiceKey> batch(keys.begin() + first, keys.begin() + end);
+      for (const DiceKeyIndexResult &result : index.insertBatch(batch, uint32_t(first))) {
+        duplicates += result.match != DiceKeyIndexMatch::None ? 1 : 0;
+      }
+    }
+    report("insertBatch (presized)", numberOfKeys, secondsSince(start));
+  }
+
+  // Verify every key (rotated, as a scanner might see it) against its record
+  {
+    const auto start = std::chrono::steady_clock::now();
+    size_t mismatches = 0;
+    for (size_t i = 0; i < numberOfKeys; i++) {
+      const DiceKeyIndexResult result = index.find(keys[i].rotate(int(i % 4)));
+      mismatches += result.match != DiceKeyIndexMatch::Duplicate || result.existingRecordId != uint32_t(i) ? 1 : 0;
+    }
+    report("find (rotated)", numberOfKeys, secondsSince(start));
+    if (mismatches > duplicates) {
+      fprintf(stderr, "%zu keys did not match their records\n", mismatches);
+      return 1;
+    }
+  }
+
+  // Persist and reload
+  const char *path = "bench-dicekey-index.dkindex";
+  {
+    const auto start = std::chrono::steady_clock::now();
+    index.save(path);
+    report("save", numberOfKeys, secondsSince(start));
+  }
+  {
+    const auto start = std::chrono::steady_clock::now();
+    DiceKeyIndex loaded = DiceKeyIndex::load(path);
+    report("load (memory-mapped)", loaded.size(), secondsSince(start));
+  }
+  remove(path);
+
+  printf("%zu duplicates or near-duplicates among the synthetic keys\n", duplicates);
+  return 0;
+}
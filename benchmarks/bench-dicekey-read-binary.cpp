@@ -0,0 +1,106 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+Compare the size of, and time to write and read, the JSON and binary forms
+of a DiceKey read.
+
+Usage: bench-dicekey-read-binary [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "dicekey-read-binary.h"
+
+// A key read with plausible geometry, in which every third face is missing its overline,
+// whose undoverlines are written into the given table
+static DiceKey<FaceRead> syntheticDiceKeyRead(UndoverlineTable &undoverlines) {
+  std::vector<FaceRead> faces;
+  for (int i = 0; i < NumberOfFaces; i++) {
+    const float x = 100.123f + 61.7f * float(i % 5);
+    const float y = 80.456f + 61.7f * float(i / 5);
+    Undoverline underline;
+    underline.found = true;
+    underline.determinedIfUnderlineOrOverline = true;
+    underline.letterDigitEncoding = (unsigned char)(i * 6 + 1);
+    underline.line = { {x - 20.25f, y + 18.5f}, {x + 20.75f, y + 18.25f} };
+    underline.center = midpointOfLine(underline.line);
+    underline.inferredCenterOfFace = cv::Point2f(x, y);
+    underline.faceInferred = decodeUndoverlineByte(false, underline.letterDigitEncoding);
+    Undoverline overline;
+    if (i % 3 != 0) {
+      overline = underline;
+      overline.isOverline = true;
+      overline.line = { {x - 20.5f, y - 18.75f}, {x + 20.5f, y - 18.5f} };
+      overline.center = midpointOfLine(overline.line);
+      overline.faceInferred = decodeUndoverlineByte(true, overline.letterDigitEncoding);
+    }
+    const std::string letters = std::string(1, underline.faceInferred->letter) + "Q";
+    const std::string digits = std::string(1, underline.faceInferred->digit);
+    faces.push_back(FaceRead(undoverlines, FaceUndoverlines(underline, overline), char(i % 4), letters, digits));
+  }
+  return DiceKey<FaceRead>(faces);
+}
+
+static double secondsSince(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *stage, size_t iterations, double seconds, size_t bytes) {
+  printf("%-38s %8zu bytes %10.3f us/key\n", stage, bytes, 1e6 * seconds / double(iterations));
+}
+
+int main(int argc, char **argv) {
+  const size_t iterations = argc > 1 ? size_t(strtoull(argv[1], NULL, 10)) : 100000;
+  UndoverlineTable undoverlines;
+  const DiceKey<FaceRead> diceKey = syntheticDiceKeyRead(undoverlines);
+  // Consumed by each loop so the work is not optimized away
+  size_t checksum = 0;
+
+  std::string json;
+  {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      json = diceKeyReadToJson(diceKey, undoverlines);
+      checksum += json.size();
+    }
+    report("diceKeyReadToJson", iterations, secondsSince(start), json.size());
+  }
+  {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      json.clear();
+      appendJsonDiceKeyRead(json, diceKey, undoverlines);
+      checksum += json.size();
+    }
+    report("appendJsonDiceKeyRead (reused buffer)", iterations, secondsSince(start), json.size());
+  }
+
+  std::vector<unsigned char> binary;
+  {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      writeBinaryDiceKeyRead(diceKey, undoverlines, binary);
+      checksum += binary[i % binary.size()];
+    }
+    report("writeBinaryDiceKeyRead", iterations, secondsSince(start), binary.size());
+  }
+  UndoverlineTable decodedUndoverlines;
+  {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      checksum += diceKeyReadFromBinary(binary, decodedUndoverlines).faces[i % NumberOfFaces].errorSize();
+    }
+    report("diceKeyReadFromBinary", iterations, secondsSince(start), binary.size());
+  }
+
+  const DiceKey<FaceRead> decodedDiceKey = diceKeyReadFromBinary(binary, decodedUndoverlines);
+  if (diceKeyReadToJson(decodedDiceKey, decodedUndoverlines) != json) {
+    fprintf(stderr, "The key decoded from its binary form does not match the key written\n");
+    return 1;
+  }
+  printf("(checksum %zu)\n", checksum);
+  return 0;
+}
@@ -0,0 +1,251 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+Time each stage of reading a DiceKey, and reading one end to end, over every
+image in the test image directory.  The images are decoded, and the input to
+each stage computed, before any stage is timed, so each benchmark measures
+only its own stage.
+
+Results are written as JSON (Google Benchmark's format) to stdout, so that runs
+can be compared between releases, unless another --benchmark_format is given.
+
+Usage: bench-read-dicekey [image-directory] [Google Benchmark options]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <opencv2/imgcodecs.hpp>
+#include "graphics/cv.h"
+#include "graphics/find-rectangles.h"
+#include "graphics/rotate.h"
+#include "../lib-dicekey/externally-generated/dicekey-face-specification.h"
+#include "find-undoverlines.h"
+#include "find-faces.h"
+#include "assemble-dicekey.hpp"
+#include "read-faces.h"
+#include "read-face-characters.h"
+#include "simple-ocr.h"
+#include "font.h"
+#include "read-dicekey.hpp"
+
+// A face found in a frame, with the inputs needed to read its characters
+struct FaceToRead {
+  cv::Point2f center;
+  float angleInRadians;
+  unsigned char whiteBlackThreshold;
+  // The binarized image of the face's letter, as passed to the OCR
+  cv::Mat letterImage;
+};
+
+// A decoded test image, with the inputs to each stage precomputed
+struct Frame {
+  std::string name;
+  cv::Mat grayscale;
+  cv::Mat rgba;
+  std::vector<RectangleDetected> candidateUndoverlines;
+  FaceAndStrayUndoverlinesFound facesAndStrayUndoverlines;
+  FacesOrderedWithMissingFacesInferredFromUnderlines orderedFaces;
+  std::vector<FaceToRead> facesToRead;
+  DiceKey<FaceRead> diceKey;
+  UndoverlineTable undoverlines;
+};
+
+static unsigned char whiteBlackThresholdOfFace(const FaceUndoverlines &face) {
+  return (face.underline.found && face.overline.found) ?
+    (unsigned char)(((unsigned int)(face.underline.whiteBlackThreshold) + (unsigned int)(face.overline.whiteBlackThreshold)) / 2) :
+    face.underline.found ? face.underline.whiteBlackThreshold : face.overline.whiteBlackThreshold;
+}
+
+// Extract a face's letter as readCharactersOnFace does before calling the OCR
+static cv::Mat letterImageOfFace(const cv::Mat &grayscale, const FaceToRead &face, float pixelsPerFaceEdgeWidth) {
+  const cv::Size textRegionSize = textRegionSizeForFace(pixelsPerFaceEdgeWidth);
+  const cv::Mat textImage = copyRotatedRectangle(grayscale, face.center, radiansToDegrees(face.angleInRadians), textRegionSize);
+  cv::Mat textEdges;
+  cv::threshold(textImage, textEdges, face.whiteBlackThreshold, 255, cv::THRESH_BINARY);
+  const int charWidth = int((textRegionSize.width - round(FaceDimensionsFractional::spaceBetweenLetterAndDigit * pixelsPerFaceEdgeWidth)) / 2);
+  return textEdges(cv::Rect(0, 0, charWidth, textRegionSize.height)).clone();
+}
+
+static Frame loadFrame(const std::string &path) {
+  Frame frame;
+  const size_t indexOfLastSlash = path.find_last_of("/\\") + 1;
+  const std::string filename = path.substr(indexOfLastSlash);
+  frame.name = filename.substr(0, filename.find_last_of("."));
+
+  const cv::Mat colorImage = cv::imread(path, cv::IMREAD_COLOR);
+  if (colorImage.empty()) {
+    return frame;
+  }
+  cv::cvtColor(colorImage, frame.grayscale, cv::COLOR_BGR2GRAY);
+  cv::cvtColor(colorImage, frame.rgba, cv::COLOR_BGR2RGBA);
+
+  frame.candidateUndoverlines = findCandidateUndoverlines(frame.grayscale);
+  frame.facesAndStrayUndoverlines = findFacesAndStrayUndoverlines(frame.grayscale);
+  frame.orderedFaces = orderFacesAndInferMissingUndoverlines(frame.grayscale, frame.facesAndStrayUndoverlines);
+  if (frame.orderedFaces.valid) {
+    for (const FaceUndoverlines &face : frame.orderedFaces.orderedFaces) {
+      if (face.underline.determinedIfUnderlineOrOverline || face.overline.determinedIfUnderlineOrOverline) {
+        FaceToRead faceToRead;
+        faceToRead.center = face.center();
+        faceToRead.angleInRadians = face.inferredAngleInRadians();
+        faceToRead.whiteBlackThreshold = whiteBlackThresholdOfFace(face);
+        faceToRead.letterImage = letterImageOfFace(frame.grayscale, faceToRead, frame.orderedFaces.pixelsPerFaceEdgeWidth);
+        frame.facesToRead.push_back(faceToRead);
+      }
+    }
+  }
+  ReadFaceResult facesRead = readOrderedFaces(frame.grayscale, frame.orderedFaces);
+  if (facesRead.success && facesRead.faces.size() == NumberOfFaces) {
+    frame.diceKey = DiceKey<FaceRead>(facesRead.faces);
+    frame.undoverlines = std::move(facesRead.undoverlines);
+  }
+  return frame;
+}
+
+static std::vector<Frame> loadFrames(const std::string &directory) {
+  std::vector<cv::String> paths;
+  cv::glob(directory + "/*", paths, false);
+  std::vector<Frame> frames;
+  for (const cv::String &path : paths) {
+    const std::string extension = path.substr(path.find_last_of(".") + 1);
+    if (extension != "jpg" && extension != "jpeg" && extension != "png") {
+      continue;
+    }
+    Frame frame = loadFrame(path);
+    if (!frame.grayscale.empty()) {
+      frames.push_back(frame);
+    }
+  }
+  return frames;
+}
+
+static void benchFindRectangles(benchmark::State &state, const Frame *frame) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(findRectangles(frame->grayscale));
+  }
+}
+
+static void benchFindCandidateUndoverlines(benchmark::State &state, const Frame *frame) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(findCandidateUndoverlines(frame->grayscale));
+  }
+}
+
+static void benchReadUndoverline(benchmark::State &state, const Frame *frame) {
+  for (auto _ : state) {
+    for (const RectangleDetected &candidate : frame->candidateUndoverlines) {
+      benchmark::DoNotOptimize(readUndoverline(frame->grayscale, candidate.rotatedRect));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(frame->candidateUndoverlines.size()));
+}
+
+static void benchFindFacesAndStrayUndoverlines(benchmark::State &state, const Frame *frame) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(findFacesAndStrayUndoverlines(frame->grayscale));
+  }
+}
+
+static void benchOrderFacesAndInferMissingUndoverlines(benchmark::State &state, const Frame *frame) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(orderFacesAndInferMissingUndoverlines(frame->grayscale, frame->facesAndStrayUndoverlines));
+  }
+}
+
+static void benchReadCharactersOnFace(benchmark::State &state, const Frame *frame) {
+  const float pixelsPerFaceEdgeWidth = frame->orderedFaces.pixelsPerFaceEdgeWidth;
+  for (auto _ : state) {
+    for (const FaceToRead &face : frame->facesToRead) {
+      benchmark::DoNotOptimize(readCharactersOnFace(
+        frame->grayscale, face.center, face.angleInRadians, pixelsPerFaceEdgeWidth, face.whiteBlackThreshold
+      ));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(frame->facesToRead.size()));
+}
+
+static void benchFindClosestMatchingCharacter(benchmark::State &state, const Frame *frame) {
+  const OcrFont &font = *getFont();
+  for (auto _ : state) {
+    for (const FaceToRead &face : frame->facesToRead) {
+      benchmark::DoNotOptimize(findClosestMatchingCharacter(font, font.letters, face.letterImage));
+    }
+  }
+  state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(frame->facesToRead.size()));
+}
+
+static void benchMergePrevious(benchmark::State &state, const Frame *frame) {
+  // The key merged with itself rotated, as when the camera turns between frames
+  const DiceKey<FaceRead> previous = frame->diceKey.rotate(1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(frame->diceKey.mergePrevious(previous));
+  }
+}
+
+static void benchToJson(benchmark::State &state, const Frame *frame) {
+  std::string json;
+  for (auto _ : state) {
+    json.clear();
+    appendJsonDiceKeyRead(json, frame->diceKey, frame->undoverlines);
+    benchmark::DoNotOptimize(json.data());
+  }
+  state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(json.size()));
+}
+
+static void benchProcessRGBAImage(benchmark::State &state, const Frame *frame) {
+  // One processor reads the frame repeatedly, as it would a still camera
+  DiceKeyImageProcessor processor;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(processor.processRGBAImage(frame->rgba.cols, frame->rgba.rows, (const uint32_t*) frame->rgba.data));
+  }
+}
+
+static void registerBenchmarks(const std::vector<Frame> &frames) {
+  for (const Frame &frame : frames) {
+    const Frame *f = &frame;
+    benchmark::RegisterBenchmark(("findRectangles/" + frame.name).c_str(), benchFindRectangles, f);
+    benchmark::RegisterBenchmark(("findCandidateUndoverlines/" + frame.name).c_str(), benchFindCandidateUndoverlines, f);
+    benchmark::RegisterBenchmark(("readUndoverline/" + frame.name).c_str(), benchReadUndoverline, f);
+    benchmark::RegisterBenchmark(("findFacesAndStrayUndoverlines/" + frame.name).c_str(), benchFindFacesAndStrayUndoverlines, f);
+    benchmark::RegisterBenchmark(("orderFacesAndInferMissingUndoverlines/" + frame.name).c_str(), benchOrderFacesAndInferMissingUndoverlines, f);
+    if (!frame.facesToRead.empty()) {
+      benchmark::RegisterBenchmark(("readCharactersOnFace/" + frame.name).c_str(), benchReadCharactersOnFace, f);
+      benchmark::RegisterBenchmark(("findClosestMatchingCharacter/" + frame.name).c_str(), benchFindClosestMatchingCharacter, f);
+    }
+    if (frame.diceKey.isInitialized()) {
+      benchmark::RegisterBenchmark(("DiceKey::mergePrevious/" + frame.name).c_str(), benchMergePrevious, f);
+      benchmark::RegisterBenchmark(("DiceKey::toJson/" + frame.name).c_str(), benchToJson, f);
+    }
+    benchmark::RegisterBenchmark(("processRGBAImage/" + frame.name).c_str(), benchProcessRGBAImage, f);
+  }
+}
+
+int main(int argc, char **argv) {
+  // Default to JSON output, which the caller can override
+  std::vector<char*> args(argv, argv + argc);
+  bool formatGiven = false;
+  for (int i = 1; i < argc; i++) {
+    formatGiven = formatGiven || strncmp(argv[i], "--benchmark_format", strlen("--benchmark_format")) == 0;
+  }
+  char jsonFormat[] = "--benchmark_format=json";
+  if (!formatGiven) {
+    args.push_back(jsonFormat);
+  }
+  int benchmarkArgc = int(args.size());
+  benchmark::Initialize(&benchmarkArgc, args.data());
+
+  // Any argument Google Benchmark did not consume is the image directory
+  const std::string directory = benchmarkArgc > 1 ? args[1] : BENCH_READ_DICEKEY_IMAGE_DIRECTORY;
+  const std::vector<Frame> frames = loadFrames(directory);
+  if (frames.empty()) {
+    fprintf(stderr, "No images found in %s\n", directory.c_str());
+    return 1;
+  }
+  registerBenchmarks(frames);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,19 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+A module loaded by bench-startup, so that loading it loads the library (and
+runs whatever the library does at load time) and calling it processes the
+library's first frame.
+*/
+
+#include <stdint.h>
+#include <vector>
+#include "read-dicekey.hpp"
+
+extern "C" int benchStartupProcessFirstFrame(int width, int height) {
+  // A blank frame: no key is found, but every stage up to finding undoverlines runs
+  std::vector<uint32_t> rgba(size_t(width) * size_t(height), 0xFFFFFFFF);
+  DiceKeyImageProcessor processor;
+  processor.processRGBAImage(width, height, rgba.data());
+  return processor.isFinished() ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+Time how long it takes from loading the library to processing its first frame:
+the dlopen of a module linked against the library (which loads the library and
+runs its static initializers), and then the first frame processed.
+
+Run once per process; only the first run in a process is cold.  To also measure
+a cold page cache, drop caches before running.
+
+Usage: bench-startup [width height]
+*/
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+typedef int (*ProcessFirstFrame)(int width, int height);
+
+static double millisecondsSince(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+  const int width = argc > 2 ? atoi(argv[1]) : 1280;
+  const int height = argc > 2 ? atoi(argv[2]) : 720;
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  void *module = dlopen(BENCH_STARTUP_PROBE_PATH, RTLD_NOW | RTLD_LOCAL);
+  if (module == NULL) {
+    fprintf(stderr, "Could not load %s: %s\n", BENCH_STARTUP_PROBE_PATH, dlerror());
+    return 1;
+  }
+  const double loadMilliseconds = millisecondsSince(start);
+
+  const ProcessFirstFrame processFirstFrame =
+    (ProcessFirstFrame) dlsym(module, "benchStartupProcessFirstFrame");
+  if (processFirstFrame == NULL) {
+    fprintf(stderr, "Could not find benchStartupProcessFirstFrame: %s\n", dlerror());
+    return 1;
+  }
+  const std::chrono::steady_clock::time_point firstFrameStart = std::chrono::steady_clock::now();
+  processFirstFrame(width, height);
+  const double firstFrameMilliseconds = millisecondsSince(firstFrameStart);
+
+  const std::chrono::steady_clock::time_point secondFrameStart = std::chrono::steady_clock::now();
+  processFirstFrame(width, height);
+  const double secondFrameMilliseconds = millisecondsSince(secondFrameStart);
+
+  printf("%-28s %10.3f ms\n", "dlopen", loadMilliseconds);
+  printf("%-28s %10.3f ms\n", "first frame", firstFrameMilliseconds);
+  printf("%-28s %10.3f ms\n", "dlopen to first frame", loadMilliseconds + firstFrameMilliseconds);
+  printf("%-28s %10.3f ms\n", "second frame (warm)", secondFrameMilliseconds);
+  dlclose(module);
+  return 0;
+}
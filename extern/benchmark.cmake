@@ -0,0 +1,31 @@
+include(FetchContent)
+
+set (BENCHMARK_VERSION "v1.6.1" CACHE STRING "Google Benchmark Version to Use")
+
+message("Downloading Google Benchmark ${BENCHMARK_VERSION}")
+
+FetchContent_Declare(
+    benchmark
+    GIT_REPOSITORY https://github.com/google/benchmark.git
+    GIT_TAG        ${BENCHMARK_VERSION}
+    UPDATE_DISCONNECTED # since we're using a fixed version, only download once
+)
+
+# Build only the library, not Google Benchmark's own tests (which would also
+# want their own copy of googletest)
+set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_GTEST_TESTS OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+set(BENCHMARK_ENABLE_WERROR OFF CACHE BOOL "" FORCE)
+
+FetchContent_MakeAvailable(benchmark)
+
+mark_as_advanced(
+    BENCHMARK_ENABLE_TESTING BENCHMARK_ENABLE_GTEST_TESTS
+    BENCHMARK_ENABLE_INSTALL BENCHMARK_ENABLE_WERROR
+)
+
+set_target_properties(benchmark PROPERTIES FOLDER extern)
+set_target_properties(benchmark_main PROPERTIES FOLDER extern)
+
+message("Google Benchmark downloaded.")
@@ -0,0 +1,393 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <utility>
+#include "dicekey-index.hpp"
+#include "thread-pool.hpp"
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+static_assert(sizeof(DiceKeyIndexSlot) == 40, "The slot layout is part of the index file format");
+
+static const size_t minimumCapacity = 16;
+
+/*
+The header at the start of an index file, followed by the key slots and
+then the near-duplicate slots.
+*/
+struct DiceKeyIndexFileHeader {
+  char magic[8];
+  uint32_t version;
+  // Written as 0x01020304 so that a file from a machine of different endianness is rejected
+  uint32_t endiannessMarker;
+  uint32_t slotSize;
+  uint32_t reserved;
+  uint64_t keyCapacity;
+  uint64_t keyCount;
+  uint64_t nearDuplicateCapacity;
+  uint64_t nearDuplicateCount;
+  uint64_t reserved2;
+};
+static_assert(sizeof(DiceKeyIndexFileHeader) == 64, "The header layout is part of the index file format");
+
+static const char indexFileMagic[8] = {'D', 'K', 'I', 'N', 'D', 'E', 'X', '1'};
+static const uint32_t indexFileEndiannessMarker = 0x01020304;
+
+// The smallest power of two that keeps the table at most half full
+static size_t capacityFor(size_t numberOfKeys) {
+  size_t capacity = minimumCapacity;
+  while (capacity < 2 * numberOfKeys) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+static bool slotHoldsKey(const DiceKeyIndexSlot &slot, const PackedDiceKey &key) {
+  return slot.words[0] == key.words[0] && slot.words[1] == key.words[1] &&
+    slot.words[2] == key.words[2] && slot.words[3] == key.words[3];
+}
+
+// Returned by findSlot for a key that is not in a table with no empty slots,
+// which only a corrupt index file can have (tables are kept at most half full)
+static const size_t noSlot = size_t(-1);
+
+/*
+Find the slot holding key or, if the key is not in the table, the empty slot
+at which it should be inserted.  Probing stops once every slot has been visited,
+returning noSlot, so that a full table can't be probed forever.
+*/
+static size_t findSlot(const DiceKeyIndexSlot *slots, size_t capacity, const PackedDiceKey &key) {
+  const size_t mask = capacity - 1;
+  size_t i = size_t(key.hash()) & mask;
+  for (size_t probes = 0; probes < capacity; probes++) {
+    if (!slots[i].occupied || slotHoldsKey(slots[i], key)) {
+      return i;
+    }
+    i = (i + 1) & mask;
+  }
+  return noSlot;
+}
+
+static void fillSlot(DiceKeyIndexSlot &slot, const PackedDiceKey &key, uint32_t recordId) {
+  memcpy(slot.words, key.words, sizeof(slot.words));
+  slot.recordId = recordId;
+  slot.occupied = 1;
+}
+
+static std::vector<DiceKeyIndexSlot> rehash(const DiceKeyIndexSlot *slots, size_t capacity, size_t newCapacity) {
+  std::vector<DiceKeyIndexSlot> newSlots(newCapacity, DiceKeyIndexSlot());
+  for (size_t i = 0; i < capacity; i++) {
+    if (slots[i].occupied) {
+      PackedDiceKey key;
+      memcpy(key.words, slots[i].words, sizeof(key.words));
+      newSlots[findSlot(newSlots.data(), newCapacity, key)] = slots[i];
+    }
+  }
+  return newSlots;
+}
+
+DiceKeyIndex::DiceKeyIndex(size_t expectedNumberOfKeys) :
+  ownedKeySlots(capacityFor(expectedNumberOfKeys), DiceKeyIndexSlot()),
+  ownedNearDuplicateSlots(capacityFor(expectedNumberOfKeys), DiceKeyIndexSlot()),
+  keySlots(ownedKeySlots.data()),
+  nearDuplicateSlots(ownedNearDuplicateSlots.data()),
+  keyCapacity(ownedKeySlots.size()),
+  keyCount(0),
+  nearDuplicateCapacity(ownedNearDuplicateSlots.size()),
+  nearDuplicateCount(0),
+  mappedFile(NULL),
+  mappedFileLength(0)
+{}
+
+DiceKeyIndex::~DiceKeyIndex() {
+  releaseMappedFile();
+}
+
+DiceKeyIndex::DiceKeyIndex(DiceKeyIndex &&other) :
+  ownedKeySlots(std::move(other.ownedKeySlots)),
+  ownedNearDuplicateSlots(std::move(other.ownedNearDuplicateSlots)),
+  keySlots(other.keySlots),
+  nearDuplicateSlots(other.nearDuplicateSlots),
+  keyCapacity(other.keyCapacity),
+  keyCount(other.keyCount),
+  nearDuplicateCapacity(other.nearDuplicateCapacity),
+  nearDuplicateCount(other.nearDuplicateCount),
+  mappedFile(other.mappedFile),
+  mappedFileLength(other.mappedFileLength)
+{
+  // Leave other as a valid, empty index that owns nothing
+  other.keySlots = other.nearDuplicateSlots = NULL;
+  other.keyCapacity = other.keyCount = other.nearDuplicateCapacity = other.nearDuplicateCount = 0;
+  other.mappedFile = NULL;
+  other.mappedFileLength = 0;
+}
+
+DiceKeyIndex &DiceKeyIndex::operator=(DiceKeyIndex &&other) {
+  if (this != &other) {
+    releaseMappedFile();
+    ownedKeySlots = std::move(other.ownedKeySlots);
+    ownedNearDuplicateSlots = std::move(other.ownedNearDuplicateSlots);
+    keySlots = other.keySlots;
+    nearDuplicateSlots = other.nearDuplicateSlots;
+    keyCapacity = other.keyCapacity;
+    keyCount = other.keyCount;
+    nearDuplicateCapacity = other.nearDuplicateCapacity;
+    nearDuplicateCount = other.nearDuplicateCount;
+    mappedFile = other.mappedFile;
+    mappedFileLength = other.mappedFileLength;
+    other.keySlots = other.nearDuplicateSlots = NULL;
+    other.keyCapacity = other.keyCount = other.nearDuplicateCapacity = other.nearDuplicateCount = 0;
+    other.mappedFile = NULL;
+    other.mappedFileLength = 0;
+  }
+  return *this;
+}
+
+void DiceKeyIndex::releaseMappedFile() {
+#ifndef _WIN32
+  if (mappedFile != NULL) {
+    munmap(mappedFile, mappedFileLength);
+  }
+#endif
+  mappedFile = NULL;
+  mappedFileLength = 0;
+}
+
+void DiceKeyIndex::copyMappedTablesIntoOwnedTables() {
+  if (mappedFile == NULL) {
+    return;
+  }
+  ownedKeySlots.assign(keySlots, keySlots + keyCapacity);
+  ownedNearDuplicateSlots.assign(nearDuplicateSlots, nearDuplicateSlots + nearDuplicateCapacity);
+  keySlots = ownedKeySlots.data();
+  nearDuplicateSlots = ownedNearDuplicateSlots.data();
+  releaseMappedFile();
+}
+
+void DiceKeyIndex::growKeysIfNeeded() {
+  if (2 * (keyCount + 1) <= keyCapacity) {
+    return;
+  }
+  copyMappedTablesIntoOwnedTables();
+  const size_t newCapacity = capacityFor(keyCount + 1);
+  ownedKeySlots = rehash(keySlots, keyCapacity, newCapacity);
+  keySlots = ownedKeySlots.data();
+  keyCapacity = newCapacity;
+}
+
+void DiceKeyIndex::growNearDuplicatesIfNeeded() {
+  if (2 * (nearDuplicateCount + 1) <= nearDuplicateCapacity) {
+    return;
+  }
+  copyMappedTablesIntoOwnedTables();
+  const size_t newCapacity = capacityFor(nearDuplicateCount + 1);
+  ownedNearDuplicateSlots = rehash(nearDuplicateSlots, nearDuplicateCapacity, newCapacity);
+  nearDuplicateSlots = ownedNearDuplicateSlots.data();
+  nearDuplicateCapacity = newCapacity;
+}
+
+DiceKeyIndexResult DiceKeyIndex::find(const PackedDiceKey &key) const {
+  DiceKeyIndexResult result = {DiceKeyIndexMatch::None, 0};
+  if (keyCapacity == 0) {
+    return result;
+  }
+  const size_t keySlotIndex = findSlot(keySlots, keyCapacity, key.rotateToCanonicalOrientation());
+  if (keySlotIndex != noSlot && keySlots[keySlotIndex].occupied) {
+    result.match = DiceKeyIndexMatch::Duplicate;
+    result.existingRecordId = keySlots[keySlotIndex].recordId;
+    return result;
+  }
+  const size_t nearDuplicateSlotIndex =
+    findSlot(nearDuplicateSlots, nearDuplicateCapacity, key.canonicalFormWithoutOrientations());
+  if (nearDuplicateSlotIndex != noSlot && nearDuplicateSlots[nearDuplicateSlotIndex].occupied) {
+    result.match = DiceKeyIndexMatch::NearDuplicate;
+    result.existingRecordId = nearDuplicateSlots[nearDuplicateSlotIndex].recordId;
+  }
+  return result;
+}
+
+DiceKeyIndexResult DiceKeyIndex::insertCanonical(
+  const PackedDiceKey &canonicalKey,
+  const PackedDiceKey &canonicalKeyWithoutOrientations,
+  uint32_t recordId
+) {
+  growKeysIfNeeded();
+  DiceKeyIndexResult result = {DiceKeyIndexMatch::None, 0};
+  const size_t keySlotIndex = findSlot(keySlots, keyCapacity, canonicalKey);
+  if (keySlotIndex == noSlot) {
+    throw std::runtime_error("DiceKey index is corrupt: its table of keys has no empty slots");
+  }
+  DiceKeyIndexSlot &keySlot = keySlots[keySlotIndex];
+  if (keySlot.occupied) {
+    result.match = DiceKeyIndexMatch::Duplicate;
+    result.existingRecordId = keySlot.recordId;
+    return result;
+  }
+  fillSlot(keySlot, canonicalKey, recordId);
+  keyCount++;
+
+  growNearDuplicatesIfNeeded();
+  const size_t nearDuplicateSlotIndex = findSlot(nearDuplicateSlots, nearDuplicateCapacity, canonicalKeyWithoutOrientations);
+  if (nearDuplicateSlotIndex == noSlot) {
+    throw std::runtime_error("DiceKey index is corrupt: its table of near-duplicates has no empty slots");
+  }
+  DiceKeyIndexSlot &nearDuplicateSlot = nearDuplicateSlots[nearDuplicateSlotIndex];
+  if (nearDuplicateSlot.occupied) {
+    // Report the first key indexed with these faces
+    result.match = DiceKeyIndexMatch::NearDuplicate;
+    result.existingRecordId = nearDuplicateSlot.recordId;
+    return result;
+  }
+  fillSlot(nearDuplicateSlot, canonicalKeyWithoutOrientations, recordId);
+  nearDuplicateCount++;
+  return result;
+}
+
+DiceKeyIndexResult DiceKeyIndex::insert(const PackedDiceKey &key, uint32_t recordId) {
+  return insertCanonical(key.rotateToCanonicalOrientation(), key.canonicalFormWithoutOrientations(), recordId);
+}
+
+std::vector<DiceKeyIndexResult> DiceKeyIndex::insertBatch(const std::vector<PackedDiceKey> &keys, uint32_t firstRecordId) {
+  std::vector<PackedDiceKey> canonicalKeys(keys.size());
+  std::vector<PackedDiceKey> canonicalKeysWithoutOrientations(keys.size());
+  parallelFor(keys.size(), [&](size_t i) {
+    canonicalKeys[i] = keys[i].rotateToCanonicalOrientation();
+    canonicalKeysWithoutOrientations[i] = keys[i].canonicalFormWithoutOrientations();
+  });
+
+  std::vector<DiceKeyIndexResult> results(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    results[i] = insertCanonical(canonicalKeys[i], canonicalKeysWithoutOrientations[i], firstRecordId + uint32_t(i));
+  }
+  return results;
+}
+
+void DiceKeyIndex::save(const std::string &path) const {
+  DiceKeyIndexFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, indexFileMagic, sizeof(header.magic));
+  header.version = FileFormatVersion;
+  header.endiannessMarker = indexFileEndiannessMarker;
+  header.slotSize = uint32_t(sizeof(DiceKeyIndexSlot));
+  header.keyCapacity = keyCapacity;
+  header.keyCount = keyCount;
+  header.nearDuplicateCapacity = nearDuplicateCapacity;
+  header.nearDuplicateCount = nearDuplicateCount;
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == NULL) {
+    throw std::runtime_error("Could not open DiceKey index file for writing: " + path);
+  }
+  const bool written =
+    fwrite(&header, sizeof(header), 1, file) == 1 &&
+    fwrite(keySlots, sizeof(DiceKeyIndexSlot), keyCapacity, file) == keyCapacity &&
+    fwrite(nearDuplicateSlots, sizeof(DiceKeyIndexSlot), nearDuplicateCapacity, file) == nearDuplicateCapacity;
+  const bool closed = fclose(file) == 0;
+  if (!written || !closed) {
+    throw std::runtime_error("Could not write DiceKey index file: " + path);
+  }
+}
+
+static void validateHeader(const DiceKeyIndexFileHeader &header, size_t fileLength, const std::string &path) {
+  if (memcmp(header.magic, indexFileMagic, sizeof(header.magic)) != 0) {
+    throw std::runtime_error("Not a DiceKey index file: " + path);
+  }
+  if (header.version != DiceKeyIndex::FileFormatVersion ||
+      header.endiannessMarker != indexFileEndiannessMarker ||
+      header.slotSize != sizeof(DiceKeyIndexSlot)) {
+    throw std::runtime_error("DiceKey index file was written in an incompatible format: " + path);
+  }
+  const bool isPowerOfTwo =
+    header.keyCapacity >= minimumCapacity && (header.keyCapacity & (header.keyCapacity - 1)) == 0 &&
+    header.nearDuplicateCapacity >= minimumCapacity && (header.nearDuplicateCapacity & (header.nearDuplicateCapacity - 1)) == 0;
+  // The capacities are bounded by the number of slots the file could hold before
+  // they are multiplied, so that a corrupt header can't overflow the file's expected length
+  const uint64_t slotsInFile = (fileLength - sizeof(header)) / sizeof(DiceKeyIndexSlot);
+  if (!isPowerOfTwo ||
+      header.keyCapacity > slotsInFile ||
+      header.nearDuplicateCapacity > slotsInFile - header.keyCapacity ||
+      header.keyCount > header.keyCapacity / 2 ||
+      header.nearDuplicateCount > header.nearDuplicateCapacity / 2 ||
+      fileLength != sizeof(header) + (header.keyCapacity + header.nearDuplicateCapacity) * sizeof(DiceKeyIndexSlot)) {
+    throw std::runtime_error("DiceKey index file is corrupt: " + path);
+  }
+}
+
+DiceKeyIndex DiceKeyIndex::load(const std::string &path) {
+  DiceKeyIndex index;
+#ifdef _WIN32
+  // Without mmap, read the file into tables we own
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    throw std::runtime_error("Could not open DiceKey index file: " + path);
+  }
+  DiceKeyIndexFileHeader header;
+  fseek(file, 0, SEEK_END);
+  const long fileLength = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (fileLength < long(sizeof(header)) || fread(&header, sizeof(header), 1, file) != 1) {
+    fclose(file);
+    throw std::runtime_error("Not a DiceKey index file: " + path);
+  }
+  try {
+    validateHeader(header, size_t(fileLength), path);
+  } catch (...) {
+    fclose(file);
+    throw;
+  }
+  index.ownedKeySlots.resize(size_t(header.keyCapacity));
+  index.ownedNearDuplicateSlots.resize(size_t(header.nearDuplicateCapacity));
+  const bool read =
+    fread(index.ownedKeySlots.data(), sizeof(DiceKeyIndexSlot), index.ownedKeySlots.size(), file) == index.ownedKeySlots.size() &&
+    fread(index.ownedNearDuplicateSlots.data(), sizeof(DiceKeyIndexSlot), index.ownedNearDuplicateSlots.size(), file) == index.ownedNearDuplicateSlots.size();
+  fclose(file);
+  if (!read) {
+    throw std::runtime_error("Could not read DiceKey index file: " + path);
+  }
+  index.keySlots = index.ownedKeySlots.data();
+  index.nearDuplicateSlots = index.ownedNearDuplicateSlots.data();
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open DiceKey index file: " + path);
+  }
+  struct stat fileStatus;
+  if (fstat(fd, &fileStatus) != 0 || size_t(fileStatus.st_size) < sizeof(DiceKeyIndexFileHeader)) {
+    close(fd);
+    throw std::runtime_error("Not a DiceKey index file: " + path);
+  }
+  const size_t fileLength = size_t(fileStatus.st_size);
+  // A private mapping lets the loaded index be added to without modifying the file
+  void *mapped = mmap(NULL, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    throw std::runtime_error("Could not map DiceKey index file: " + path);
+  }
+  const DiceKeyIndexFileHeader &header = *static_cast<const DiceKeyIndexFileHeader *>(mapped);
+  try {
+    validateHeader(header, fileLength, path);
+  } catch (...) {
+    munmap(mapped, fileLength);
+    throw;
+  }
+  index.ownedKeySlots.clear();
+  index.ownedNearDuplicateSlots.clear();
+  index.mappedFile = mapped;
+  index.mappedFileLength = fileLength;
+  DiceKeyIndexSlot *slots = reinterpret_cast<DiceKeyIndexSlot *>(static_cast<char *>(mapped) + sizeof(DiceKeyIndexFileHeader));
+  index.keySlots = slots;
+  index.nearDuplicateSlots = slots + header.keyCapacity;
+#endif
+  index.keyCapacity = size_t(header.keyCapacity);
+  index.keyCount = size_t(header.keyCount);
+  index.nearDuplicateCapacity = size_t(header.nearDuplicateCapacity);
+  index.nearDuplicateCount = size_t(header.nearDuplicateCount);
+  return index;
+}
@@ -0,0 +1,120 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "packed-dicekey.hpp"
+
+/*
+An entry in one of the index's open-addressing tables.  Slots are stored in the
+index file exactly as they are laid out in memory, so this layout is part of the
+file format.
+*/
+struct DiceKeyIndexSlot {
+  uint64_t words[PackedDiceKey::NumberOfWords];
+  uint32_t recordId;
+  uint32_t occupied;
+};
+
+enum class DiceKeyIndexMatch {
+  // No key in the index shares this key's faces
+  None,
+  // The same key, possibly rotated, is already in the index
+  Duplicate,
+  // A key whose faces differ from this key's only in their orientations is already in the index
+  NearDuplicate
+};
+
+struct DiceKeyIndexResult {
+  DiceKeyIndexMatch match;
+  // The record of the key already in the index (if match is not None)
+  uint32_t existingRecordId;
+};
+
+/*
+An index of (possibly millions of) DiceKeys for verifying that every key produced
+is unique and matches its record.
+
+Keys are indexed by their canonical packed form (see PackedDiceKey), so a key matches
+any rotation of itself.  A second table, keyed on the canonical form of each key with
+face orientations ignored, detects near-duplicates: keys that differ only in the
+orientations of their faces.
+
+Both tables use open addressing with linear probing and are kept at most half full.
+An index can be saved to a file and loaded back by memory-mapping that file, so that
+a large index is available without reading or rehashing it.  A loaded index can still
+be added to; pages are copied only as they are written, and the file is never modified.
+*/
+class DiceKeyIndex {
+public:
+  static const uint32_t FileFormatVersion = 1;
+
+  explicit DiceKeyIndex(size_t expectedNumberOfKeys = 0);
+  ~DiceKeyIndex();
+
+  DiceKeyIndex(DiceKeyIndex &&other);
+  DiceKeyIndex &operator=(DiceKeyIndex &&other);
+  DiceKeyIndex(const DiceKeyIndex &) = delete;
+  DiceKeyIndex &operator=(const DiceKeyIndex &) = delete;
+
+  // The number of distinct keys (not counting rotations) in the index
+  size_t size() const { return keyCount; }
+
+  /*
+  Look up a key (in any orientation) without adding it.
+  */
+  DiceKeyIndexResult find(const PackedDiceKey &key) const;
+
+  /*
+  Add a key, associating it with recordId, unless the key is already in the index.
+  A near-duplicate is still added, as it is a distinct key.
+  */
+  DiceKeyIndexResult insert(const PackedDiceKey &key, uint32_t recordId);
+
+  /*
+  Add a batch of keys, associating keys[i] with record firstRecordId + i.
+  The keys are canonicalized in parallel (see thread-pool.hpp) and then inserted in
+  order, so the results are the same as inserting each key in turn.
+  */
+  std::vector<DiceKeyIndexResult> insertBatch(const std::vector<PackedDiceKey> &keys, uint32_t firstRecordId);
+
+  /*
+  Write the index to a file.  Throws std::runtime_error if the file cannot be written.
+  */
+  void save(const std::string &path) const;
+
+  /*
+  Load an index written by save() by memory-mapping the file.
+  Throws std::runtime_error if the file cannot be read or is not an index
+  written with this version of the file format on a machine of the same endianness.
+  */
+  static DiceKeyIndex load(const std::string &path);
+
+private:
+  // Tables we allocated, or empty if the tables live in a memory-mapped file
+  std::vector<DiceKeyIndexSlot> ownedKeySlots;
+  std::vector<DiceKeyIndexSlot> ownedNearDuplicateSlots;
+  DiceKeyIndexSlot *keySlots;
+  DiceKeyIndexSlot *nearDuplicateSlots;
+  size_t keyCapacity;
+  size_t keyCount;
+  size_t nearDuplicateCapacity;
+  size_t nearDuplicateCount;
+  // The memory-mapped file (if loaded), which the tables point into
+  void *mappedFile;
+  size_t mappedFileLength;
+
+  void releaseMappedFile();
+  void copyMappedTablesIntoOwnedTables();
+  void growKeysIfNeeded();
+  void growNearDuplicatesIfNeeded();
+
+  DiceKeyIndexResult insertCanonical(
+    const PackedDiceKey &canonicalKey,
+    const PackedDiceKey &canonicalKeyWithoutOrientations,
+    uint32_t recordId
+  );
+};
@@ -3,13 +3,53 @@
 #pragma once
 
 #include <cassert>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <string>
 #include <type_traits>
 #include <vector>
 #include <stdexcept>
 #include "face.hpp"
+#include "packed-dicekey.hpp"
 
 const int NumberOfFaces = 25;
 
+/*
+For each number of clockwise turns (0-3), the index of the face that moves into each
+position of the 5x5 square when the square is rotated by that many turns.
+*/
+constexpr unsigned char RotationIndexesFor5x5Square[4][NumberOfFaces] = {
+  {
+    0,  1,  2,  3,  4,
+    5,  6,  7,  8,  9,
+    10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19,
+    20, 21, 22, 23, 24
+  },
+  {
+    20, 15, 10,  5,  0,
+    21, 16, 11,  6,  1,
+    22, 17, 12,  7,  2,
+    23, 18, 13,  8,  3,
+    24, 19, 14,  9,  4
+  },
+  {
+    24, 23, 22, 21, 20,
+    19, 18, 17, 16, 15,
+    14, 13, 12, 11, 10,
+     9,  8,  7,  6,  5,
+     4,  3,  2,  1,  0
+  },
+  {
+    4,  9, 14, 19, 24,
+    3,  8, 13, 18, 23,
+    2,  7, 12, 17, 22,
+    1,  6, 11, 16, 21,
+    0,  5, 10, 15, 20
+  }
+};
+
 const std::vector<unsigned char> getRotationIndexesFor5x5Square(int clockwiseTurns);
 std::string rotateHumanReadableForm(const std::string humanReadableForm, int clockwiseTurns);
 const int rotationsToCanonicalForm(std::string humanReadableForm);
@@ -19,9 +59,48 @@ const int rotationsToCanonicalForm(std::string humanReadableForm);
  */
 template<typename F, typename std::enable_if<std::is_base_of<Rotateable<F>, F>::value>::type* = nullptr>
 class DiceKey {
+  private:
+    // True once the DiceKey has been constructed from 25 faces
+    bool initialized = false;
+
+    /**
+     * Determine whether the faces of another DiceKey, if it were rotated by the
+     * specified number of clockwise turns, could be a match for this DiceKey,
+     * without constructing the rotated key.
+     */
+    bool isPotentialMatch(const DiceKey &other, unsigned otherClockwiseTurns0to3) const {
+      const unsigned char *indexToMoveFaceFrom = RotationIndexesFor5x5Square[otherClockwiseTurns0to3];
+      int numMatchingFaces = 0;
+      for (int i=0; i < NumberOfFaces; i++) {
+        const F &face = faces[i];
+        const F &otherFace = other.faces[indexToMoveFaceFrom[i]];
+        const char otherOrientation = otherFace.orientationAs0to3ClockwiseTurnsFromUpright();
+        const char otherOrientationRotated = otherOrientation == '?' ? '?' :
+          char(clockwiseTurnsToRange0To3(otherOrientation + otherClockwiseTurns0to3));
+        if (
+          face.isDefined() &&
+          face.letter() == otherFace.letter() &&
+          face.digit() == otherFace.digit() &&
+          face.orientationAs0to3ClockwiseTurnsFromUpright() == otherOrientationRotated
+        ) {
+          numMatchingFaces++;
+        } else {
+          // faces don't match
+          if (otherFace.errorSize() == 0 && face.errorSize() == 0) {
+            // The faces are different, but neither is supposed to be in error.
+            // This means the entire grid must be different.  Either we're now
+            // looking at another set of faces, the orientation rotated, or there
+            // was an undetected face read error.
+            return false;
+          }
+        }
+      }
+      return numMatchingFaces > 9;
+    }
+
   public:
     // const
-    std::vector<F> faces;
+    std::array<F, NumberOfFaces> faces;
 
     // DiceKey();
 
@@ -31,16 +110,31 @@ class DiceKey {
       faces = copyFrom.faces;
     }
 
-    DiceKey(const std::vector<F> _faces) : faces(_faces) {
+    DiceKey(const std::vector<F> &_faces) {
+      if (_faces.size() != NumberOfFaces) {
+	    	throw std::invalid_argument( (
+          "A DiceKey must contain " + std::to_string(NumberOfFaces) + " faces but only has " + std::to_string(_faces.size())
+        ).c_str() );
+	    }
+      std::copy(_faces.begin(), _faces.end(), faces.begin());
+      initialized = true;
+    }
+
+    // Take the faces from a vector that will no longer be needed, moving rather than copying them
+    DiceKey(std::vector<F> &&_faces) {
       if (_faces.size() != NumberOfFaces) {
 	    	throw std::invalid_argument( (
           "A DiceKey must contain " + std::to_string(NumberOfFaces) + " faces but only has " + std::to_string(_faces.size())
         ).c_str() );
 	    }
+      std::move(_faces.begin(), _faces.end(), faces.begin());
+      initialized = true;
     }
 
+    DiceKey(const std::array<F, NumberOfFaces> &_faces) : initialized(true), faces(_faces) {}
+
     bool isInitialized() const {
-      return faces.size() == NumberOfFaces;
+      return initialized;
     }
 
     bool isDefined() const {
@@ -72,18 +166,28 @@ class DiceKey {
      *
      */
     std::string toJson() const {
+      std::string json;
+      appendJson(json);
+      return json;
+    }
+
+    /**
+     * Append the DiceKey, in the JSON format of toJson, to a buffer
+     * (which the caller may reuse to avoid reallocating it).
+     */
+    void appendJson(std::string &json) const {
       if (!isInitialized()) {
-        return "null";
+        json += "null";
+        return;
       }
-      std::string json = "[";
+      json += "[";
       for (int i = 0; i < NumberOfFaces; i++) {
         if (i!=0) {
           json += ",";
         }
-        json += faces[i].toJson();
+        faces[i].appendJson(json);
       }
       json += "]";
-      return json;
     }
 
     /**
@@ -93,7 +197,7 @@ class DiceKey {
      * FUTURE -- build string in place in memory that can be zeroed
      */
     std::string toHumanReadableForm(bool includeFaceOrientations) const {
-      assert(faces.size() == NumberOfFaces);
+      assert(isInitialized());
       std::string humanReadableForm = "";
       for (const F &face : faces) {
         humanReadableForm += face.toHumanReadableForm(includeFaceOrientations);
@@ -111,9 +215,9 @@ class DiceKey {
       if (!isInitialized()) {
         return false;
       }
-      std::vector<char> letters;
-      for (const F &face : faces) {
-        letters.push_back(face.letter);
+      std::array<char, NumberOfFaces> letters;
+      for (int i = 0; i < NumberOfFaces; i++) {
+        letters[i] = faces[i].letter();
       }
       std::sort(letters.begin(), letters.end(), [](char a, char b) { return a < b; });
       for (int i = 0; i < NumberOfFaces; i++) {
@@ -125,20 +229,46 @@ class DiceKey {
     }
 
 
+  /**
+   * Rotate this DiceKey, in place, by the specified number of clockwise turns.
+   */
+  void rotateInPlace(int clockwiseTurns) {
+    assert(isInitialized());
+    const unsigned clockwiseTurns0to3 = clockwiseTurnsToRange0To3(clockwiseTurns);
+    if (clockwiseTurns0to3 == 0) {
+      return;
+    }
+    const unsigned char *indexToMoveFaceFrom = RotationIndexesFor5x5Square[clockwiseTurns0to3];
+    // Move the faces along each cycle of the permutation, holding aside
+    // only the first face of the cycle.
+    bool moved[NumberOfFaces] = {};
+    for (int cycleStart = 0; cycleStart < NumberOfFaces; cycleStart++) {
+      if (moved[cycleStart]) {
+        continue;
+      }
+      F firstFaceOfCycle = std::move(faces[cycleStart]);
+      int to = cycleStart;
+      while (indexToMoveFaceFrom[to] != cycleStart) {
+        faces[to] = std::move(faces[indexToMoveFaceFrom[to]]);
+        moved[to] = true;
+        to = indexToMoveFaceFrom[to];
+      }
+      faces[to] = std::move(firstFaceOfCycle);
+      moved[to] = true;
+    }
+    for (F &face : faces) {
+      face = face.rotate(clockwiseTurns0to3);
+    }
+  }
+
   /**
    * Return a copy of this DiceKey that has been rotated by the specified
    * number of clockwise turns.
    */
   const DiceKey<F> rotate(int clockwiseTurns) const {
-//    return DiceKey(rotateDiceKeyFaces<F>(faces, clockwiseTurns));
-    assert(faces.size() == NumberOfFaces);
-    const unsigned clockwiseTurns0to3 = clockwiseTurnsToRange0To3(clockwiseTurns);
-    const std::vector<unsigned char> &indexToMoveFaceFrom = getRotationIndexesFor5x5Square(clockwiseTurns0to3);
-    std::vector<F> rotatedFaces;
-    for (size_t i = 0; i < NumberOfFaces; i++) {
-      rotatedFaces.push_back(faces[indexToMoveFaceFrom[i]].rotate(clockwiseTurns0to3));
-    }
-    return DiceKey<F>(rotatedFaces);
+    DiceKey<F> rotated(*this);
+    rotated.rotateInPlace(clockwiseTurns);
+    return rotated;
   }
 
   /**
@@ -147,29 +277,27 @@ class DiceKey {
    * top left of the 5x5 square.
    */
   const DiceKey rotateToCanonicalOrientation() const {
+    // Keys whose faces can all be packed are compared in packed form, without building
+    // strings.  Others (e.g., with faces OCR read as characters not on any die) cannot be.
+    PackedDiceKey packed;
     return rotate(
-      rotationsToCanonicalForm(toHumanReadableForm(true))
+      isInitialized() && PackedDiceKey::tryFromFaces(faces, packed) ?
+        packed.rotationsToCanonicalForm() :
+        rotationsToCanonicalForm(toHumanReadableForm(true))
     );
 //    return DiceKey(toCanonicalOrientation(faces));
   }
 
+  /**
+   * Return the packed binary form of this DiceKey.
+   * Throws std::invalid_argument unless every face can be packed (see PackedDiceKey::tryFromFaces).
+   */
+  PackedDiceKey toPacked() const {
+    return PackedDiceKey::fromFaces(faces);
+  }
+
   bool isPotentialMatch(const DiceKey &other) const {
-    int numMatchingFaces = 0;
-    for (int i=0; i < NumberOfFaces; i++) {
-      if (faces[i].equals(other.faces[i])) {
-        numMatchingFaces++;
-      } else {
-        // faces don't match
-        if (other.faces[i].errorSize() == 0 && faces[i].errorSize() == 0) {
-          // The faces are different, but neither is supposed to be in error.
-          // This means the entire grid must be different.  Either we're now
-          // looking at another set of faces, the orientation rotated, or there
-          // was an undetected face read error.
-          return false;
-        }
-      }
-    }
-    return numMatchingFaces > 9;
+    return isPotentialMatch(other, 0);
   }
 
   /**
@@ -178,8 +306,17 @@ class DiceKey {
    * be scanned without error in one of the two scans.
    **/
   const DiceKey<F> mergePrevious(const DiceKey<F> &previous) const {
+    DiceKey<F> merged(*this);
+    merged.mergePreviousInPlace(previous);
+    return merged;
+  }
+
+  /**
+   * Merge an earlier-scanned DiceKey into this one, in place (see mergePrevious),
+   * copying only those faces that were scanned with fewer errors in the past.
+   **/
+  void mergePreviousInPlace(const DiceKey<F> &previous) {
     if (isPotentialMatch(previous)) {
-      std::vector<F> newFaces;
       // There are enough matching faces in the previously-scanned DiceKey,
       // and no clear conflicts, so we can merge faces from the previous
       // DiceKey in cases where the face was scanned with fewer errors in the
@@ -190,30 +327,28 @@ class DiceKey {
         // The face from the previous scan
         const F &previousFace = previous.faces[i];
 
-        newFaces.push_back((
-            !previousFace.isDefined() ||
-            (face.isDefined() && face.errorSize() <= previousFace.errorSize())
-          ) ?
-            face :
-            previousFace
-        );
+        if (
+          previousFace.isDefined() &&
+          !(face.isDefined() && face.errorSize() <= previousFace.errorSize())
+        ) {
+          faces[i] = previousFace;
+        }
       }
-      return DiceKey<F>(newFaces);
+      initialized = true;
     } else {
       // isPotentialMatch failed, so the previous scan was incompatible with the faces
       // from the current scan.  Perhaps the previous scan was at a different frame of
       // reference and the grid was rotated.
-      for (int clockwiseTurns = 1; clockwiseTurns < 4; clockwiseTurns++) {
+      for (unsigned clockwiseTurns = 1; clockwiseTurns < 4; clockwiseTurns++) {
         // Since this rotation wasn't a potential match, try the 3 other potential
         // rotations and recurse a single time only if one is a match.
         // (where it will enter the above clause)
-        DiceKey<F> rotatedKey = previous.rotate(clockwiseTurns);
-        if (isPotentialMatch(rotatedKey)) {
-          return mergePrevious(rotatedKey);
+        if (isPotentialMatch(previous, clockwiseTurns)) {
+          mergePreviousInPlace(previous.rotate(clockwiseTurns));
+          return;
         }
       }
-      // No match with previous, so just return new faces
-      return DiceKey<F>(faces);
+      // No match with previous, so just keep the new faces
     }
   }
 
@@ -8,14 +8,14 @@
 #include "dicekey-face-specification.h"
 #include <assert.h>
 
-const std::string FaceLetters = "ABCDEFGHIJKLMNOPRSTUVWXYZ";
-const std::string FaceDigits = "123456";
-const std::string FaceRotationLetters = "trbl";
+const char FaceLetters[] = "ABCDEFGHIJKLMNOPRSTUVWXYZ";
+const char FaceDigits[] = "123456";
+const char FaceRotationLetters[] = "trbl";
 
 const FaceSpecification NullFaceSpecification = {'\0', '\0', 0, 0};
 
 namespace FaceDimensionsFractional {
-  const std::vector<float> dotCentersAsFractionOfUndoverline = {
+  const float dotCentersAsFractionOfUndoverline[NumberOfDotsInUndoverline] = {
     float(0.0967745),
     float(0.1774195),
     float(0.2580645),
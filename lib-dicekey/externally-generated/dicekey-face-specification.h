@@ -27,9 +27,9 @@
 #include <string>
 #include <vector>
 
-extern const std::string FaceLetters;
-extern const std::string FaceDigits;
-extern const std::string FaceRotationLetters;
+extern const char FaceLetters[];
+extern const char FaceDigits[];
+extern const char FaceRotationLetters[];
 
 const int NumberOfDotsInUndoverline = 11;
 const int MinNumberOfBlackDotsInUndoverline = 4;
@@ -73,29 +73,29 @@ namespace FaceDimensionsFractional {
   const float spaceBetweenLetterAndDigit = float(0.04375);
   const float textRegionWidth = float(0.785685);
   const float textRegionHeight = float(0.488194);
-  extern const std::vector<float> dotCentersAsFractionOfUndoverline;
+  extern const float dotCentersAsFractionOfUndoverline[NumberOfDotsInUndoverline];
 };
 
 namespace JsonKeys {
 	namespace Line {
-		const std::string start = "start";
-		const std::string end = "end";
+		const char start[] = "start";
+		const char end[] = "end";
 	};
 	namespace Point {
-		const std::string x = "x";
-		const std::string y = "y";
+		const char x[] = "x";
+		const char y[] = "y";
 	};
 	namespace Undoverline {
-		const std::string line = "line";
-		const std::string code = "code";
+		const char line[] = "line";
+		const char code[] = "code";
 	};
 	namespace FaceRead {
-		const std::string underline = "underline";
-		const std::string overline = "overline";
-		const std::string orientationAsLowercaseLetterTrbl = "orientationAsLowercaseLetterTrbl";
-		const std::string ocrLetterCharsFromMostToLeastLikely = "ocrLetterCharsFromMostToLeastLikely";
-		const std::string ocrDigitCharsFromMostToLeastLikely = "ocrDigitCharsFromMostToLeastLikely";
-		const std::string center = "center";
+		const char underline[] = "underline";
+		const char overline[] = "overline";
+		const char orientationAsLowercaseLetterTrbl[] = "orientationAsLowercaseLetterTrbl";
+		const char ocrLetterCharsFromMostToLeastLikely[] = "ocrLetterCharsFromMostToLeastLikely";
+		const char ocrDigitCharsFromMostToLeastLikely[] = "ocrDigitCharsFromMostToLeastLikely";
+		const char center[] = "center";
 	};
 };
 
@@ -12,6 +12,12 @@ char Face::orientationAs0to3ClockwiseTurnsFromUpright() const {
   return _orientationAs0to3ClockwiseTurnsFromUpright;
 }
 
+Face::Face() :
+  _letter('?'),
+  _digit('?'),
+  _orientationAs0to3ClockwiseTurnsFromUpright('?')
+{}
+
 Face::Face(
   const IFace &copyFrom
 ) : 
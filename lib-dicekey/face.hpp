@@ -73,6 +73,10 @@ class IFace {
         "', orientationAsLowercaseLetterTRBL: '" + std::string(1, orientationAsLowercaseLetterTRBL()) +
         "'}";
     }
+    // Append the face, in JSON format, to a buffer
+    virtual void appendJson(std::string &json) const {
+      json += toJson();
+    }
 
     virtual unsigned int errorSize() const { return 0; }
     virtual int errorLocation() const { return 0; }
@@ -121,8 +125,8 @@ public:
 
 class Face : public IFace, public Rotateable<Face> {
 private:
-	const char _letter;
-	const char _digit;
+	char _letter;
+	char _digit;
 	char _orientationAs0to3ClockwiseTurnsFromUpright;
 public:
 	// The face letter, an english capital letter other than 'Q', or '?' if unknown
@@ -134,6 +138,9 @@ public:
 
 	Face rotate(int clockwiseTurnsToRight) const;
 
+	// An unknown face, with letter, digit, and orientation all '?'
+	Face();
+
 	Face(
 		std::string letterDigitOrientationTriple
 	);
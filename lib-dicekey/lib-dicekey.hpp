@@ -1,3 +1,5 @@
 #include "face.hpp"
 #include "dicekey.hpp"
+#include "packed-dicekey.hpp"
+#include "dicekey-index.hpp"
 #include "dicekey-from-human-readable-form.hpp"
\ No newline at end of file
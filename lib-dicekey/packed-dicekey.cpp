@@ -0,0 +1,174 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include "dicekey.hpp"
+#include "packed-dicekey.hpp"
+
+static_assert(PackedDiceKey::NumberOfFaces == NumberOfFaces, "A packed DiceKey must have the same number of faces as a DiceKey");
+static_assert(PackedDiceKey::NumberOfFaces * PackedDiceKey::BitsPerFace <= PackedDiceKey::NumberOfWords * 64,
+  "The faces of a packed DiceKey must fit within its words");
+
+// The orientation rank of a face after rotating it [clockwiseTurns][rank]
+static const unsigned char rotatedOrientationRank[4][4] = {
+  {0, 1, 2, 3},
+  // Rotating clockwise: b -> l, l -> t, r -> b, t -> r
+  {1, 3, 0, 2},
+  // b -> t, l -> r, r -> l, t -> b
+  {3, 2, 1, 0},
+  // b -> r, l -> b, r -> t, t -> l
+  {2, 0, 3, 1},
+};
+
+PackedFace PackedDiceKey::getFace(int faceIndex) const {
+  const int firstBit = faceIndex * BitsPerFace;
+  const int wordIndex = firstBit / 64;
+  const int bitWithinWord = firstBit % 64;
+  const int bitsInFirstWord = 64 - bitWithinWord;
+  if (bitsInFirstWord >= BitsPerFace) {
+    return PackedFace((words[wordIndex] >> (bitsInFirstWord - BitsPerFace)) & 0x3FF);
+  }
+  // The face spans two words
+  const int bitsInSecondWord = BitsPerFace - bitsInFirstWord;
+  const uint64_t highBits = words[wordIndex] & ((uint64_t(1) << bitsInFirstWord) - 1);
+  const uint64_t lowBits = words[wordIndex + 1] >> (64 - bitsInSecondWord);
+  return PackedFace((highBits << bitsInSecondWord) | lowBits);
+}
+
+void PackedDiceKey::setFace(int faceIndex, PackedFace face) {
+  const int firstBit = faceIndex * BitsPerFace;
+  const int wordIndex = firstBit / 64;
+  const int bitWithinWord = firstBit % 64;
+  const int bitsInFirstWord = 64 - bitWithinWord;
+  const uint64_t value = uint64_t(face) & 0x3FF;
+  if (bitsInFirstWord >= BitsPerFace) {
+    const int shift = bitsInFirstWord - BitsPerFace;
+    words[wordIndex] = (words[wordIndex] & ~(uint64_t(0x3FF) << shift)) | (value << shift);
+    return;
+  }
+  // The face spans two words
+  const int bitsInSecondWord = BitsPerFace - bitsInFirstWord;
+  const uint64_t firstWordMask = (uint64_t(1) << bitsInFirstWord) - 1;
+  words[wordIndex] = (words[wordIndex] & ~firstWordMask) | (value >> bitsInSecondWord);
+  const int shift = 64 - bitsInSecondWord;
+  const uint64_t secondWordMask = ((uint64_t(1) << bitsInSecondWord) - 1) << shift;
+  words[wordIndex + 1] = (words[wordIndex + 1] & ~secondWordMask) | ((value << shift) & secondWordMask);
+}
+
+bool PackedDiceKey::tryParse(const std::string &humanReadableForm, PackedDiceKey &result) {
+  if (humanReadableForm.length() != 3 * NumberOfFaces) {
+    return false;
+  }
+  PackedDiceKey parsed;
+  for (int i = 0; i < NumberOfFaces; i++) {
+    const PackedFace face = packFace(
+      humanReadableForm[3 * i],
+      humanReadableForm[3 * i + 1],
+      orientationAsLowercaseLetterTrblToClockwiseTurnsFromUpright(humanReadableForm[3 * i + 2])
+    );
+    if (face == InvalidPackedFace) {
+      return false;
+    }
+    parsed.setFace(i, face);
+  }
+  result = parsed;
+  return true;
+}
+
+PackedDiceKey::PackedDiceKey(const std::string &humanReadableForm) : words{0, 0, 0, 0} {
+  if (!tryParse(humanReadableForm, *this)) {
+    throw std::invalid_argument("Only the 75-character human-readable form of a DiceKey with all faces defined can be packed");
+  }
+}
+
+std::array<Face, PackedDiceKey::NumberOfFaces> PackedDiceKey::toFaces() const {
+  std::array<Face, NumberOfFaces> faces;
+  for (int i = 0; i < NumberOfFaces; i++) {
+    const PackedFace face = getFace(i);
+    const char triple[4] = {
+      packedFaceLetter(face),
+      packedFaceDigit(face),
+      trbl(packedFaceOrientationAs0to3ClockwiseTurnsFromUpright(face)),
+      0
+    };
+    faces[i] = Face(triple);
+  }
+  return faces;
+}
+
+std::string PackedDiceKey::toHumanReadableForm(bool includeFaceOrientations) const {
+  std::string humanReadableForm;
+  humanReadableForm.reserve((includeFaceOrientations ? 3 : 2) * NumberOfFaces);
+  for (int i = 0; i < NumberOfFaces; i++) {
+    const PackedFace face = getFace(i);
+    humanReadableForm += packedFaceLetter(face);
+    humanReadableForm += packedFaceDigit(face);
+    if (includeFaceOrientations) {
+      humanReadableForm += trbl(packedFaceOrientationAs0to3ClockwiseTurnsFromUpright(face));
+    }
+  }
+  return humanReadableForm;
+}
+
+// Rotate faces that have already been unpacked, packing the result
+static PackedDiceKey rotateFaces(const PackedFace faces[NumberOfFaces], unsigned clockwiseTurns0to3) {
+  const unsigned char *indexToMoveFaceFrom = RotationIndexesFor5x5Square[clockwiseTurns0to3];
+  const unsigned char *rotateRank = rotatedOrientationRank[clockwiseTurns0to3];
+  PackedDiceKey rotated;
+  for (int i = 0; i < NumberOfFaces; i++) {
+    const PackedFace face = faces[indexToMoveFaceFrom[i]];
+    rotated.setFace(i, PackedFace((face & ~PackedFace(3)) | rotateRank[face & 3]));
+  }
+  return rotated;
+}
+
+PackedDiceKey PackedDiceKey::rotate(int clockwiseTurns) const {
+  PackedFace faces[NumberOfFaces];
+  for (int i = 0; i < NumberOfFaces; i++) {
+    faces[i] = getFace(i);
+  }
+  return rotateFaces(faces, clockwiseTurnsToRange0To3(clockwiseTurns));
+}
+
+int PackedDiceKey::rotationsToCanonicalForm() const {
+  PackedFace faces[NumberOfFaces];
+  for (int i = 0; i < NumberOfFaces; i++) {
+    faces[i] = getFace(i);
+  }
+  PackedDiceKey firstInSortOrder = *this;
+  int clockwiseTurnsToFirstInSortOrder = 0;
+  for (unsigned clockwiseTurns = 1; clockwiseTurns < 4; clockwiseTurns++) {
+    const PackedDiceKey rotated = rotateFaces(faces, clockwiseTurns);
+    if (rotated < firstInSortOrder) {
+      firstInSortOrder = rotated;
+      clockwiseTurnsToFirstInSortOrder = int(clockwiseTurns);
+    }
+  }
+  return clockwiseTurnsToFirstInSortOrder;
+}
+
+PackedDiceKey PackedDiceKey::rotateToCanonicalOrientation() const {
+  return rotate(rotationsToCanonicalForm());
+}
+
+PackedDiceKey PackedDiceKey::withoutOrientations() const {
+  PackedDiceKey result = *this;
+  for (int i = 0; i < NumberOfFaces; i++) {
+    result.setFace(i, PackedFace(getFace(i) & ~PackedFace(3)));
+  }
+  return result;
+}
+
+PackedDiceKey PackedDiceKey::canonicalFormWithoutOrientations() const {
+  PackedFace faces[NumberOfFaces];
+  for (int i = 0; i < NumberOfFaces; i++) {
+    faces[i] = PackedFace(getFace(i) & ~PackedFace(3));
+  }
+  PackedDiceKey firstInSortOrder = rotateFaces(faces, 0);
+  for (unsigned clockwiseTurns = 1; clockwiseTurns < 4; clockwiseTurns++) {
+    // Rotation changes only orientations, which we then clear again
+    const PackedDiceKey rotated = rotateFaces(faces, clockwiseTurns).withoutOrientations();
+    if (rotated < firstInSortOrder) {
+      firstInSortOrder = rotated;
+    }
+  }
+  return firstInSortOrder;
+}
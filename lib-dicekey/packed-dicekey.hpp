@@ -0,0 +1,180 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <string>
+#include <stdexcept>
+#include "face.hpp"
+
+/*
+Each face of a packed DiceKey is a 10-bit code:
+  bits 9-5: the index of the letter within FaceLetters (0-24)
+  bits 4-2: the index of the digit within FaceDigits (0-5)
+  bits 1-0: the orientation's rank in the order 'b' < 'l' < 'r' < 't'
+Ranking the orientation (rather than storing the number of clockwise turns)
+makes the packed order match the order of the human-readable form.
+*/
+typedef uint16_t PackedFace;
+
+const PackedFace InvalidPackedFace = 0xFFFF;
+
+inline int packedFaceLetterIndex(char letter) {
+  // FaceLetters is the alphabet without 'Q'
+  return (letter < 'A' || letter > 'Z' || letter == 'Q') ? -1 :
+    letter < 'Q' ? letter - 'A' : letter - 'A' - 1;
+}
+
+inline int packedFaceDigitIndex(char digit) {
+  return (digit < '1' || digit > '6') ? -1 : digit - '1';
+}
+
+// Convert 0-3 clockwise turns from upright ('t', 'r', 'b', 'l') to the orientation's rank
+// in sort order ('b' < 'l' < 'r' < 't'), and back.
+const unsigned char ClockwiseTurnsToOrientationRank[4] = {3, 2, 0, 1};
+const unsigned char OrientationRankToClockwiseTurns[4] = {2, 3, 1, 0};
+
+/*
+Pack a face's letter, digit, and orientation (as 0-3 clockwise turns from upright), or
+return InvalidPackedFace if any of them is undefined.
+*/
+inline PackedFace packFace(char letter, char digit, char orientationAs0to3ClockwiseTurnsFromUpright) {
+  const int letterIndex = packedFaceLetterIndex(letter);
+  const int digitIndex = packedFaceDigitIndex(digit);
+  if (letterIndex < 0 || digitIndex < 0 ||
+      orientationAs0to3ClockwiseTurnsFromUpright < 0 || orientationAs0to3ClockwiseTurnsFromUpright > 3) {
+    return InvalidPackedFace;
+  }
+  return PackedFace(
+    (letterIndex << 5) | (digitIndex << 2) |
+    ClockwiseTurnsToOrientationRank[int(orientationAs0to3ClockwiseTurnsFromUpright)]
+  );
+}
+
+inline char packedFaceLetter(PackedFace face) { return char('A' + (face >> 5) + ((face >> 5) >= ('Q' - 'A') ? 1 : 0)); }
+inline char packedFaceDigit(PackedFace face) { return char('1' + ((face >> 2) & 7)); }
+inline char packedFaceOrientationAs0to3ClockwiseTurnsFromUpright(PackedFace face) {
+  return char(OrientationRankToClockwiseTurns[face & 3]);
+}
+
+/*
+A DiceKey whose 25 faces are all defined, packed into four 64-bit words (250 bits).
+
+Faces are packed in order, starting at the most significant bit of the first word,
+so that comparing the words in order compares the keys in the same order as
+comparing their human-readable forms.  This makes choosing the canonical
+orientation a matter of comparing four integers rather than building strings.
+*/
+class PackedDiceKey {
+public:
+  static const int NumberOfFaces = 25;
+  static const int BitsPerFace = 10;
+  static const int NumberOfWords = 4;
+
+  // The packed faces, most significant word first
+  uint64_t words[NumberOfWords];
+
+  PackedDiceKey() : words{0, 0, 0, 0} {}
+
+  /*
+  Parse a 75-character human-readable form (letter, digit, and orientation for each face).
+  Throws std::invalid_argument if the form is not of that length or any face is undefined.
+  */
+  explicit PackedDiceKey(const std::string &humanReadableForm);
+
+  /*
+  Parse a 75-character human-readable form, returning false (rather than throwing)
+  if it does not describe 25 defined faces.
+  */
+  static bool tryParse(const std::string &humanReadableForm, PackedDiceKey &result);
+
+  /*
+  Pack an array of faces, such as the faces of a DiceKey<Face> or DiceKey<FaceRead>,
+  returning false (rather than throwing) if any face has a letter, digit, or
+  orientation that cannot be packed, as faces read by OCR may.
+  */
+  template <typename F>
+  static bool tryFromFaces(const std::array<F, NumberOfFaces> &faces, PackedDiceKey &result) {
+    for (int i = 0; i < NumberOfFaces; i++) {
+      const PackedFace face = packFace(faces[i].letter(), faces[i].digit(), faces[i].orientationAs0to3ClockwiseTurnsFromUpright());
+      if (face == InvalidPackedFace) {
+        return false;
+      }
+      result.setFace(i, face);
+    }
+    return true;
+  }
+
+  /*
+  Pack an array of faces, as tryFromFaces does.
+  Throws std::invalid_argument if any face cannot be packed.
+  */
+  template <typename F>
+  static PackedDiceKey fromFaces(const std::array<F, NumberOfFaces> &faces) {
+    PackedDiceKey result;
+    if (!tryFromFaces(faces, result)) {
+      throw std::invalid_argument("Only a DiceKey with all faces defined can be packed");
+    }
+    return result;
+  }
+
+  PackedFace getFace(int faceIndex) const;
+  void setFace(int faceIndex, PackedFace face);
+
+  std::array<Face, NumberOfFaces> toFaces() const;
+  std::string toHumanReadableForm(bool includeFaceOrientations = true) const;
+
+  /*
+  Return this key rotated by the specified number of clockwise turns.
+  */
+  PackedDiceKey rotate(int clockwiseTurns) const;
+
+  /*
+  The number of clockwise turns (0-3) that rotates this key into its canonical
+  orientation: the orientation that comes first in sort order.
+  */
+  int rotationsToCanonicalForm() const;
+
+  PackedDiceKey rotateToCanonicalOrientation() const;
+
+  /*
+  Return this key with the orientation of every face cleared (set to the rank of 'b').
+  */
+  PackedDiceKey withoutOrientations() const;
+
+  /*
+  The canonical form of this key once face orientations are ignored: the first, in
+  sort order, of the four rotations of the key with all orientations cleared.
+  Keys that differ only in the orientations of their faces share this form.
+  */
+  PackedDiceKey canonicalFormWithoutOrientations() const;
+
+  /*
+  A hash of the packed words, suitable for hash tables.
+  */
+  uint64_t hash() const {
+    uint64_t h = words[0];
+    for (int i = 1; i < NumberOfWords; i++) {
+      h = (h ^ (h >> 31)) * 0x9E3779B97F4A7C15ull + words[i];
+    }
+    // The splitmix64 finalizer
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+  }
+
+  bool operator==(const PackedDiceKey &other) const {
+    return words[0] == other.words[0] && words[1] == other.words[1] &&
+      words[2] == other.words[2] && words[3] == other.words[3];
+  }
+  bool operator!=(const PackedDiceKey &other) const { return !(*this == other); }
+  bool operator<(const PackedDiceKey &other) const {
+    for (int i = 0; i < NumberOfWords; i++) {
+      if (words[i] != other.words[i]) {
+        return words[i] < other.words[i];
+      }
+    }
+    return false;
+  }
+};
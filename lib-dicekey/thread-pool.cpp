@@ -0,0 +1,210 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <vector>
+#ifndef DICEKEY_SINGLE_THREADED
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+#include "thread-pool.hpp"
+
+static unsigned int defaultConcurrency() {
+#ifdef DICEKEY_SINGLE_THREADED
+	return 1;
+#else
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 0 ? hardwareThreads : 1;
+#endif
+}
+
+static std::atomic<unsigned int> maxConcurrency(0);
+
+void setMaxConcurrency(unsigned int maxThreads) {
+	maxConcurrency = maxThreads;
+}
+
+unsigned int getMaxConcurrency() {
+	const unsigned int limit = maxConcurrency;
+	return limit == 0 ? defaultConcurrency() : limit;
+}
+
+#ifndef DICEKEY_SINGLE_THREADED
+
+namespace {
+
+/*
+A call to parallelFor, which the calling thread and up to maxHelpers
+threads from the pool work on together, each claiming the next
+unclaimed index until none remain.
+*/
+class ParallelForJob {
+public:
+	const size_t count;
+	const std::function<void(size_t)> &task;
+	const unsigned int maxHelpers;
+	// The number of pool threads that have joined the job, and the number
+	// still working on it, both guarded by the pool's mutex.
+	unsigned int helpers = 0;
+	unsigned int activeHelpers = 0;
+
+	ParallelForJob(size_t _count, const std::function<void(size_t)> &_task, unsigned int _maxHelpers) :
+		count(_count), task(_task), maxHelpers(_maxHelpers) {}
+
+	void run() {
+		for (size_t i = nextIndex++; i < count; i = nextIndex++) {
+			try {
+				task(i);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(exceptionMutex);
+				if (!exception) {
+					exception = std::current_exception();
+				}
+			}
+		}
+	}
+
+	void rethrowIfAnyTaskThrew() {
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+	}
+
+private:
+	std::atomic<size_t> nextIndex{0};
+	std::mutex exceptionMutex;
+	std::exception_ptr exception;
+};
+
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned int numberOfThreads) {
+		for (unsigned int i = 0; i < numberOfThreads; i++) {
+			threads.push_back(std::thread([this] { work(); }));
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		workAvailable.notify_all();
+		for (auto &thread : threads) {
+			thread.join();
+		}
+	}
+
+	unsigned int numberOfThreads() const { return (unsigned int) threads.size(); }
+
+	void runWithHelpers(ParallelForJob &job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(&job);
+		}
+		if (job.maxHelpers == 1) {
+			workAvailable.notify_one();
+		} else {
+			workAvailable.notify_all();
+		}
+		// The calling thread works on its own job rather than waiting idly
+		job.run();
+		{
+			// Every index has been claimed, so stop any further helpers from joining
+			// and wait for those that joined to finish the indexes they claimed.
+			std::unique_lock<std::mutex> lock(mutex);
+			removeJob(&job);
+			helperFinished.wait(lock, [&job] { return job.activeHelpers == 0; });
+		}
+		job.rethrowIfAnyTaskThrew();
+	}
+
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable helperFinished;
+	std::deque<ParallelForJob*> jobs;
+	bool stopping = false;
+
+	// Must be called with the mutex held
+	void removeJob(ParallelForJob* job) {
+		for (auto it = jobs.begin(); it != jobs.end(); it++) {
+			if (*it == job) {
+				jobs.erase(it);
+				return;
+			}
+		}
+	}
+
+	void work() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			workAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping) {
+				return;
+			}
+			ParallelForJob* job = jobs.front();
+			if (++job->helpers >= job->maxHelpers) {
+				// The job has all the help it is allowed
+				jobs.pop_front();
+			}
+			// The job's caller waits for active helpers before the job is destroyed
+			job->activeHelpers++;
+			lock.unlock();
+			job->run();
+			lock.lock();
+			if (--job->activeHelpers == 0) {
+				helperFinished.notify_all();
+			}
+		}
+	}
+};
+
+ThreadPool& sharedThreadPool() {
+	// The calling thread is one of the threads that runs each stage,
+	// so the pool needs one fewer thread than the hardware provides.
+	static ThreadPool pool(defaultConcurrency() - 1);
+	return pool;
+}
+
+}
+
+void parallelFor(size_t count, const std::function<void(size_t)> &task) {
+	const unsigned int concurrency = getMaxConcurrency();
+	if (count <= 1 || concurrency <= 1) {
+		for (size_t i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+	ThreadPool &pool = sharedThreadPool();
+	unsigned int maxHelpers = concurrency - 1;
+	if (maxHelpers > pool.numberOfThreads()) {
+		maxHelpers = pool.numberOfThreads();
+	}
+	if (size_t(maxHelpers) > count - 1) {
+		maxHelpers = (unsigned int)(count - 1);
+	}
+	if (maxHelpers == 0) {
+		for (size_t i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+	ParallelForJob job(count, task, maxHelpers);
+	pool.runWithHelpers(job);
+}
+
+#else
+
+void parallelFor(size_t count, const std::function<void(size_t)> &task) {
+	for (size_t i = 0; i < count; i++) {
+		task(i);
+	}
+}
+
+#endif
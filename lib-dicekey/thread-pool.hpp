@@ -0,0 +1,40 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+
+/*
+A single pool of worker threads shared by every parallel stage, whether reading a
+DiceKey from an image or indexing DiceKeys in bulk, so that no stage spawns threads
+of its own for each frame or batch.
+
+The pool's threads are created the first time they are needed, and are never created
+if the concurrency limit is 1 (or if built with DICEKEY_SINGLE_THREADED, as we do for
+targets without thread support).
+*/
+
+/*
+Set the maximum number of threads, including the calling thread, that will run a
+parallel stage.  A limit of 1 runs all work on the calling thread, which mobile
+callers may prefer.  A limit of 0 restores the default (the number of hardware threads).
+*/
+void setMaxConcurrency(unsigned int maxThreads);
+
+/*
+Get the maximum number of threads, including the calling thread, that will run a
+parallel stage.
+*/
+unsigned int getMaxConcurrency();
+
+/*
+Call task(i) for every i in [0, count), spreading the calls over the shared pool
+and the calling thread, and return once all calls have completed.
+
+Calls may run in any order and concurrently, so each should write its result into
+a slot reserved for index i (e.g., element i of a pre-sized vector) so that the
+results are deterministic.  If any call throws, the first exception thrown is
+rethrown to the caller after all calls have completed.
+*/
+void parallelFor(size_t count, const std::function<void(size_t)> &task);
@@ -11,6 +11,7 @@
 #include "find-undoverlines.h"
 #include "find-faces.h"
 #include "assemble-dicekey.hpp"
+#include "frame-stats.h"
 
 
 class DiceKeyGridModel {
@@ -204,6 +205,7 @@ FacesOrderedWithMissingFacesInferredFromUnderlines orderFacesAndInferMissingUndo
 	const FaceAndStrayUndoverlinesFound& faceAndStrayUndoverlinesFound,
 	float maxMmFromRowOrColumnLine // = 1.0f // 1 mm
 ) {
+	FRAME_STATS_TIME_STAGE(gridFittingMicroseconds);
 	// Uncomment for debugging
 	// cv::Mat colorImage;
 	// cv::cvtColor(grayscaleImage, colorImage, cv::COLOR_GRAY2BGR);
@@ -265,7 +267,27 @@ FacesOrderedWithMissingFacesInferredFromUnderlines orderFacesAndInferMissingUndo
 	return FacesOrderedWithMissingFacesInferredFromUnderlines(
 		orderedFaces,
 		grid.angleInRadians,
-		faceAndStrayUndoverlinesFound.pixelsPerFaceEdgeWidth
+		faceAndStrayUndoverlinesFound.pixelsPerFaceEdgeWidth,
+		cv::RotatedRect(
+			grid.centerPoint,
+			cv::Size2f(grid.distanceBetweenColumns * 5, grid.distanceBetweenRows * 5),
+			radiansToDegrees(grid.angleInRadians)
+		)
 	);
 
 }
+
+std::vector<FacesOrderedWithMissingFacesInferredFromUnderlines> orderFacesOfEachDiceKeyAndInferMissingUndoverlines(
+	const cv::Mat &grayscaleImage,
+	const std::vector<FaceAndStrayUndoverlinesFound>& facesAndStrayUndoverlinesOfEachDiceKey,
+	float maxMmFromRowOrColumnLine // = 1.0f // 1 mm
+) {
+	std::vector<FacesOrderedWithMissingFacesInferredFromUnderlines> orderedFacesOfEachDiceKey;
+	for (const auto &faceAndStrayUndoverlinesFound : facesAndStrayUndoverlinesOfEachDiceKey) {
+		auto orderedFaces = orderFacesAndInferMissingUndoverlines(grayscaleImage, faceAndStrayUndoverlinesFound, maxMmFromRowOrColumnLine);
+		if (orderedFaces.valid) {
+			orderedFacesOfEachDiceKey.push_back(std::move(orderedFaces));
+		}
+	}
+	return orderedFacesOfEachDiceKey;
+}
@@ -13,19 +13,23 @@ class FacesOrderedWithMissingFacesInferredFromUnderlines {
 	// The angle of what was read on the page, without any conversion to have
 	// the top left be the corner with the earliest letter in the alphabet
 	float angleInRadiansNonCanonicalForm = NAN;
-	float pixelsPerFaceEdgeWidth;
+	float pixelsPerFaceEdgeWidth = 0;
+	// The box bounding the 5x5 grid of faces within the image
+	cv::RotatedRect bounds = cv::RotatedRect();
 
 	FacesOrderedWithMissingFacesInferredFromUnderlines() {}
 
 	FacesOrderedWithMissingFacesInferredFromUnderlines(
 		std::vector<FaceUndoverlines> _orderedFaces,
 		float _angleInRadiansNonCanonicalForm,
-		float _pixelsPerFaceEdgeWidth
+		float _pixelsPerFaceEdgeWidth,
+		cv::RotatedRect _bounds
 	) {
 		valid = true;
 		orderedFaces = _orderedFaces;
 		angleInRadiansNonCanonicalForm = _angleInRadiansNonCanonicalForm;
 		pixelsPerFaceEdgeWidth = _pixelsPerFaceEdgeWidth;
+		bounds = _bounds;
 	}
 };
 
@@ -33,4 +37,15 @@ FacesOrderedWithMissingFacesInferredFromUnderlines orderFacesAndInferMissingUndo
 	const cv::Mat &grayscaleImage,
 	const FaceAndStrayUndoverlinesFound& faceAndStrayUndoverlinesFound,
 	float maxMmFromRowOrColumnLine = 1.0f // 1 mm
-);
\ No newline at end of file
+);
+
+/**
+ * Fit a grid to the faces of each of the DiceKeys found by
+ * findFacesAndStrayUndoverlinesOfEachDiceKey, returning only those
+ * for which a grid could be fit.
+ **/
+std::vector<FacesOrderedWithMissingFacesInferredFromUnderlines> orderFacesOfEachDiceKeyAndInferMissingUndoverlines(
+	const cv::Mat &grayscaleImage,
+	const std::vector<FaceAndStrayUndoverlinesFound>& facesAndStrayUndoverlinesOfEachDiceKey,
+	float maxMmFromRowOrColumnLine = 1.0f // 1 mm
+);
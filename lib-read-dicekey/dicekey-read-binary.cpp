@@ -0,0 +1,212 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "dicekey-read-binary.h"
+
+/*
+Fields are written and read a byte at a time, at the offsets of the structs'
+fields, so the bytes are little-endian whatever the endianness of this machine.
+*/
+
+static void putUint16(unsigned char *at, uint16_t value) {
+  at[0] = (unsigned char)(value & 0xFF);
+  at[1] = (unsigned char)(value >> 8);
+}
+
+static void putFloat(unsigned char *at, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 4; i++) {
+    at[i] = (unsigned char)((bits >> (8 * i)) & 0xFF);
+  }
+}
+
+static uint16_t getUint16(const unsigned char *at) {
+  return uint16_t(at[0] | (at[1] << 8));
+}
+
+static float getFloat(const unsigned char *at) {
+  uint32_t bits = 0;
+  for (int i = 0; i < 4; i++) {
+    bits |= uint32_t(at[i]) << (8 * i);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+#define FIELD(base, type, field) ((base) + offsetof(type, field))
+
+static void writeUndoverline(unsigned char *at, const Undoverline &undoverline) {
+  at[offsetof(DiceKeyReadBinaryUndoverline, flags)] = (unsigned char)(
+    (undoverline.found ? DiceKeyReadBinary::UndoverlineFlags::Found : 0) |
+    (undoverline.determinedIfUnderlineOrOverline ? DiceKeyReadBinary::UndoverlineFlags::DeterminedIfUnderlineOrOverline : 0) |
+    (undoverline.isOverline ? DiceKeyReadBinary::UndoverlineFlags::IsOverline : 0)
+  );
+  at[offsetof(DiceKeyReadBinaryUndoverline, letterDigitEncoding)] = undoverline.letterDigitEncoding;
+  putFloat(FIELD(at, DiceKeyReadBinaryUndoverline, startX), undoverline.line.start.x);
+  putFloat(FIELD(at, DiceKeyReadBinaryUndoverline, startY), undoverline.line.start.y);
+  putFloat(FIELD(at, DiceKeyReadBinaryUndoverline, endX), undoverline.line.end.x);
+  putFloat(FIELD(at, DiceKeyReadBinaryUndoverline, endY), undoverline.line.end.y);
+}
+
+static void writeOcrCandidates(unsigned char *countAt, unsigned char *charactersAt, unsigned char *errorScoresAt, const OcrCandidates &candidates) {
+  *countAt = candidates.count;
+  for (int i = 0; i < candidates.count; i++) {
+    charactersAt[i] = (unsigned char) candidates.characters[i];
+    putUint16(errorScoresAt + i * sizeof(uint16_t), candidates.errorScores[i]);
+  }
+}
+
+static void writeFace(unsigned char *at, const FaceRead &face, const UndoverlineTable &undoverlines) {
+  const FaceError error = face.error();
+  const cv::Point2f center = face.center(undoverlines);
+  at[offsetof(DiceKeyReadBinaryFace, letter)] = (unsigned char) face.letter();
+  at[offsetof(DiceKeyReadBinaryFace, digit)] = (unsigned char) face.digit();
+  at[offsetof(DiceKeyReadBinaryFace, orientationAs0to3ClockwiseTurnsFromUpright)] =
+    (unsigned char) face.orientationAs0to3ClockwiseTurnsFromUpright();
+  at[offsetof(DiceKeyReadBinaryFace, errorMagnitude)] = error.magnitude;
+  at[offsetof(DiceKeyReadBinaryFace, errorLocation)] = error.location;
+  writeOcrCandidates(
+    FIELD(at, DiceKeyReadBinaryFace, ocrLetterCount),
+    FIELD(at, DiceKeyReadBinaryFace, ocrLetters),
+    FIELD(at, DiceKeyReadBinaryFace, ocrLetterErrorScores),
+    face.ocrLetterCandidates()
+  );
+  writeOcrCandidates(
+    FIELD(at, DiceKeyReadBinaryFace, ocrDigitCount),
+    FIELD(at, DiceKeyReadBinaryFace, ocrDigits),
+    FIELD(at, DiceKeyReadBinaryFace, ocrDigitErrorScores),
+    face.ocrDigitCandidates()
+  );
+  putFloat(FIELD(at, DiceKeyReadBinaryFace, centerX), center.x);
+  putFloat(FIELD(at, DiceKeyReadBinaryFace, centerY), center.y);
+  writeUndoverline(FIELD(at, DiceKeyReadBinaryFace, underline), face.underline(undoverlines));
+  writeUndoverline(FIELD(at, DiceKeyReadBinaryFace, overline), face.overline(undoverlines));
+}
+
+void writeBinaryDiceKeyRead(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines, std::vector<unsigned char> &binary) {
+  binary.assign(DiceKeyReadBinarySize, 0);
+  unsigned char *header = binary.data();
+  memcpy(FIELD(header, DiceKeyReadBinaryHeader, magic), DiceKeyReadBinary::Magic, sizeof(DiceKeyReadBinary::Magic));
+  putUint16(FIELD(header, DiceKeyReadBinaryHeader, version), DiceKeyReadBinary::Version);
+  putUint16(FIELD(header, DiceKeyReadBinaryHeader, headerSize), uint16_t(sizeof(DiceKeyReadBinaryHeader)));
+  putUint16(FIELD(header, DiceKeyReadBinaryHeader, faceSize), uint16_t(sizeof(DiceKeyReadBinaryFace)));
+  header[offsetof(DiceKeyReadBinaryHeader, numberOfFaces)] = NumberOfFaces;
+  if (!diceKey.isInitialized()) {
+    return;
+  }
+  header[offsetof(DiceKeyReadBinaryHeader, flags)] = DiceKeyReadBinary::HeaderFlags::Initialized;
+
+  unsigned int totalError = 0;
+  unsigned int maxError = 0;
+  for (size_t i = 0; i < NumberOfFaces; i++) {
+    unsigned char *face = header + sizeof(DiceKeyReadBinaryHeader) + i * sizeof(DiceKeyReadBinaryFace);
+    writeFace(face, diceKey.faces[i], undoverlines);
+    const unsigned int errorMagnitude = face[offsetof(DiceKeyReadBinaryFace, errorMagnitude)];
+    totalError += errorMagnitude;
+    maxError = std::max(maxError, errorMagnitude);
+  }
+  putUint16(FIELD(header, DiceKeyReadBinaryHeader, totalError), uint16_t(totalError));
+  header[offsetof(DiceKeyReadBinaryHeader, maxError)] = (unsigned char) maxError;
+}
+
+std::vector<unsigned char> diceKeyReadToBinary(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines) {
+  std::vector<unsigned char> binary;
+  writeBinaryDiceKeyRead(diceKey, undoverlines, binary);
+  return binary;
+}
+
+static Undoverline readUndoverline(const unsigned char *at, const cv::Point2f &centerOfFace) {
+  Undoverline undoverline;
+  const uint8_t flags = at[offsetof(DiceKeyReadBinaryUndoverline, flags)];
+  undoverline.found = (flags & DiceKeyReadBinary::UndoverlineFlags::Found) != 0;
+  undoverline.determinedIfUnderlineOrOverline = (flags & DiceKeyReadBinary::UndoverlineFlags::DeterminedIfUnderlineOrOverline) != 0;
+  undoverline.isOverline = (flags & DiceKeyReadBinary::UndoverlineFlags::IsOverline) != 0;
+  undoverline.letterDigitEncoding = at[offsetof(DiceKeyReadBinaryUndoverline, letterDigitEncoding)];
+  undoverline.line.start.x = getFloat(FIELD(at, DiceKeyReadBinaryUndoverline, startX));
+  undoverline.line.start.y = getFloat(FIELD(at, DiceKeyReadBinaryUndoverline, startY));
+  undoverline.line.end.x = getFloat(FIELD(at, DiceKeyReadBinaryUndoverline, endX));
+  undoverline.line.end.y = getFloat(FIELD(at, DiceKeyReadBinaryUndoverline, endY));
+  if (undoverline.found) {
+    undoverline.center = midpointOfLine(undoverline.line);
+    // Restores the face's center if the other undoverline was not found
+    undoverline.inferredCenterOfFace = centerOfFace;
+  }
+  if (undoverline.determinedIfUnderlineOrOverline) {
+    undoverline.faceInferred = decodeUndoverlineByte(undoverline.isOverline, undoverline.letterDigitEncoding);
+  }
+  return undoverline;
+}
+
+static OcrCandidates readOcrCandidates(const unsigned char *countAt, const unsigned char *charactersAt, const unsigned char *errorScoresAt) {
+  OcrCandidates candidates = noOcrCandidates();
+  candidates.count = *countAt < OcrCandidates::MaxCandidates ? *countAt : (unsigned char) OcrCandidates::MaxCandidates;
+  for (int i = 0; i < candidates.count; i++) {
+    candidates.characters[i] = (char) charactersAt[i];
+    candidates.errorScores[i] = getUint16(errorScoresAt + i * sizeof(uint16_t));
+  }
+  return candidates;
+}
+
+static FaceRead readFace(const unsigned char *at, UndoverlineTable &undoverlines) {
+  const cv::Point2f center(
+    getFloat(FIELD(at, DiceKeyReadBinaryFace, centerX)),
+    getFloat(FIELD(at, DiceKeyReadBinaryFace, centerY))
+  );
+  return FaceRead(
+    undoverlines,
+    FaceUndoverlines(
+      readUndoverline(FIELD(at, DiceKeyReadBinaryFace, underline), center),
+      readUndoverline(FIELD(at, DiceKeyReadBinaryFace, overline), center)
+    ),
+    (char) at[offsetof(DiceKeyReadBinaryFace, orientationAs0to3ClockwiseTurnsFromUpright)],
+    readOcrCandidates(
+      FIELD(at, DiceKeyReadBinaryFace, ocrLetterCount),
+      FIELD(at, DiceKeyReadBinaryFace, ocrLetters),
+      FIELD(at, DiceKeyReadBinaryFace, ocrLetterErrorScores)
+    ),
+    readOcrCandidates(
+      FIELD(at, DiceKeyReadBinaryFace, ocrDigitCount),
+      FIELD(at, DiceKeyReadBinaryFace, ocrDigits),
+      FIELD(at, DiceKeyReadBinaryFace, ocrDigitErrorScores)
+    )
+  );
+}
+
+DiceKey<FaceRead> diceKeyReadFromBinary(const unsigned char *binary, size_t length, UndoverlineTable &undoverlines) {
+  if (length < sizeof(DiceKeyReadBinaryHeader) || memcmp(binary, DiceKeyReadBinary::Magic, sizeof(DiceKeyReadBinary::Magic)) != 0) {
+    throw std::invalid_argument("Not the binary form of a DiceKey read");
+  }
+  const uint16_t version = getUint16(FIELD(binary, DiceKeyReadBinaryHeader, version));
+  if (version != DiceKeyReadBinary::Version) {
+    throw std::invalid_argument("Unsupported version of the binary form of a DiceKey read: " + std::to_string(version));
+  }
+  const size_t headerSize = getUint16(FIELD(binary, DiceKeyReadBinaryHeader, headerSize));
+  const size_t faceSize = getUint16(FIELD(binary, DiceKeyReadBinaryHeader, faceSize));
+  const size_t numberOfFaces = binary[offsetof(DiceKeyReadBinaryHeader, numberOfFaces)];
+  if (
+    headerSize < sizeof(DiceKeyReadBinaryHeader) ||
+    faceSize < sizeof(DiceKeyReadBinaryFace) ||
+    numberOfFaces != NumberOfFaces ||
+    length < headerSize + numberOfFaces * faceSize
+  ) {
+    throw std::invalid_argument("The binary form of a DiceKey read is truncated or malformed");
+  }
+  undoverlines.clear();
+  if ((binary[offsetof(DiceKeyReadBinaryHeader, flags)] & DiceKeyReadBinary::HeaderFlags::Initialized) == 0) {
+    return DiceKey<FaceRead>();
+  }
+  std::array<FaceRead, NumberOfFaces> faces;
+  for (size_t i = 0; i < NumberOfFaces; i++) {
+    faces[i] = readFace(binary + headerSize + i * faceSize, undoverlines);
+  }
+  return DiceKey<FaceRead>(faces);
+}
+
+DiceKey<FaceRead> diceKeyReadFromBinary(const std::vector<unsigned char> &binary, UndoverlineTable &undoverlines) {
+  return diceKeyReadFromBinary(binary.data(), binary.size(), undoverlines);
+}
@@ -0,0 +1,119 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "../lib-dicekey/dicekey.hpp"
+#include "face-read.h"
+
+/*
+A versioned binary form of a DiceKey<FaceRead>, for passing results to a UI
+in the same process or through shared memory without formatting and parsing JSON.
+
+The form is a DiceKeyReadBinaryHeader followed by NumberOfFaces
+DiceKeyReadBinaryFace records.  Every field is at a fixed offset, integers and
+floats (IEEE 754 single precision) are little-endian, and there is no padding
+the compiler could place differently, so on a little-endian machine a reader
+can overlay these structs (or C structs with the same fields) directly onto
+the bytes.  On other machines, use diceKeyReadFromBinary.
+
+Readers should check the magic bytes and the version, which changes whenever
+the layout does, and should find the faces using headerSize and faceSize.
+*/
+namespace DiceKeyReadBinary {
+  const char Magic[4] = {'D', 'K', 'R', 'B'};
+  const uint16_t Version = 1;
+
+  namespace HeaderFlags {
+    // The key was read (DiceKey::isInitialized); if not, the faces are empty
+    const uint8_t Initialized = 1;
+  }
+
+  namespace UndoverlineFlags {
+    const uint8_t Found = 1;
+    const uint8_t DeterminedIfUnderlineOrOverline = 2;
+    const uint8_t IsOverline = 4;
+  }
+}
+
+// 20 bytes
+struct DiceKeyReadBinaryUndoverline {
+  // DiceKeyReadBinary::UndoverlineFlags
+  uint8_t flags;
+  uint8_t letterDigitEncoding;
+  uint8_t reserved[2];
+  // The line, from the side of the face with the letter to the side with the digit
+  float startX;
+  float startY;
+  float endX;
+  float endY;
+};
+
+// 68 bytes
+struct DiceKeyReadBinaryFace {
+  // The face as read, with '?' for a letter, digit, or orientation not read
+  char letter;
+  char digit;
+  // 0-3 clockwise turns from upright, or '?'
+  char orientationAs0to3ClockwiseTurnsFromUpright;
+  // See FaceError
+  uint8_t errorMagnitude;
+  uint8_t errorLocation;
+  uint8_t ocrLetterCount;
+  uint8_t ocrDigitCount;
+  uint8_t reserved;
+  // OCR candidates, most likely first (see OcrCandidates)
+  char ocrLetters[OcrCandidates::MaxCandidates];
+  char ocrDigits[OcrCandidates::MaxCandidates];
+  uint16_t ocrLetterErrorScores[OcrCandidates::MaxCandidates];
+  uint16_t ocrDigitErrorScores[OcrCandidates::MaxCandidates];
+  float centerX;
+  float centerY;
+  DiceKeyReadBinaryUndoverline underline;
+  DiceKeyReadBinaryUndoverline overline;
+};
+
+// 16 bytes
+struct DiceKeyReadBinaryHeader {
+  char magic[4];
+  uint16_t version;
+  uint16_t headerSize;
+  uint16_t faceSize;
+  uint8_t numberOfFaces;
+  // DiceKeyReadBinary::HeaderFlags
+  uint8_t flags;
+  // See DiceKey::totalError and DiceKey::maxError (0 if not initialized)
+  uint16_t totalError;
+  uint8_t maxError;
+  uint8_t reserved;
+};
+
+static_assert(sizeof(DiceKeyReadBinaryUndoverline) == 20, "The binary undoverline layout must not change");
+static_assert(sizeof(DiceKeyReadBinaryFace) == 68, "The binary face layout must not change");
+static_assert(offsetof(DiceKeyReadBinaryFace, centerX) == 20, "The binary face layout must not change");
+static_assert(offsetof(DiceKeyReadBinaryFace, underline) == 28, "The binary face layout must not change");
+static_assert(sizeof(DiceKeyReadBinaryHeader) == 16, "The binary header layout must not change");
+
+const size_t DiceKeyReadBinarySize = sizeof(DiceKeyReadBinaryHeader) + NumberOfFaces * sizeof(DiceKeyReadBinaryFace);
+
+/*
+Write the binary form of a DiceKey read, whose faces' undoverlines are in the
+given table, into a buffer, replacing its contents.
+Callers that serialize every frame can pass the same buffer each time so that its
+storage is reused.
+*/
+void writeBinaryDiceKeyRead(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines, std::vector<unsigned char> &binary);
+std::vector<unsigned char> diceKeyReadToBinary(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines);
+
+/*
+Decode the binary form of a DiceKey read, replacing the contents of the table
+with the undoverlines of its faces.  Face images are not carried, and
+undoverlines carry only what toJson() writes: each face's center is restored,
+but other geometry inferred from the undoverlines (e.g., their rotated rects) is not.
+Throws std::invalid_argument if the bytes are not a DiceKey read in a version
+of the binary form this code can read.
+*/
+DiceKey<FaceRead> diceKeyReadFromBinary(const unsigned char *binary, size_t length, UndoverlineTable &undoverlines);
+DiceKey<FaceRead> diceKeyReadFromBinary(const std::vector<unsigned char> &binary, UndoverlineTable &undoverlines);
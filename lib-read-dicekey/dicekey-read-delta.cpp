@@ -0,0 +1,83 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include "dicekey-read-delta.h"
+#include "json.h"
+
+std::string DiceKeyReadDelta::toJson() const {
+	std::string json;
+	appendJson(json);
+	return json;
+}
+
+void DiceKeyReadDelta::appendJson(std::string &json) const {
+	json += '{';
+	jsonAppendKey(json, JsonKeys::DiceKeyReadDelta::sequenceNumber);
+	jsonAppendUnsigned(json, sequenceNumber);
+	json += ", ";
+	jsonAppendKey(json, JsonKeys::DiceKeyReadDelta::isInitialized);
+	json += isInitialized ? "true" : "false";
+	json += ", ";
+	jsonAppendKey(json, JsonKeys::DiceKeyReadDelta::faces);
+	json += '[';
+	for (size_t i = 0; i < changedFaces.size(); i++) {
+		if (i != 0) {
+			json += ',';
+		}
+		json += '{';
+		jsonAppendKey(json, JsonKeys::DiceKeyReadDelta::index);
+		jsonAppendUnsigned(json, (unsigned int) changedFaces[i].faceIndex);
+		json += ", ";
+		jsonAppendKey(json, JsonKeys::DiceKeyReadDelta::face);
+		changedFaces[i].face.appendJson(json, undoverlines);
+		json += '}';
+	}
+	json += "]}";
+}
+
+DiceKeyReadDeltaTracker::ReportedFace DiceKeyReadDeltaTracker::reportOf(const FaceRead &face, const UndoverlineTable &undoverlines) {
+	ReportedFace reported;
+	reported.letter = face.letter();
+	reported.digit = face.digit();
+	reported.orientationAs0to3ClockwiseTurnsFromUpright = face.orientationAs0to3ClockwiseTurnsFromUpright();
+	reported.error = face.error();
+	reported.center = face.center(undoverlines);
+	return reported;
+}
+
+bool DiceKeyReadDeltaTracker::hasChanged(const ReportedFace &reported, const ReportedFace &current) const {
+	if (
+		reported.letter != current.letter ||
+		reported.digit != current.digit ||
+		reported.orientationAs0to3ClockwiseTurnsFromUpright != current.orientationAs0to3ClockwiseTurnsFromUpright ||
+		reported.error.magnitude != current.error.magnitude ||
+		reported.error.location != current.error.location
+	) {
+		return true;
+	}
+	const float dx = current.center.x - reported.center.x;
+	const float dy = current.center.y - reported.center.y;
+	return dx * dx + dy * dy > positionThresholdInPixels * positionThresholdInPixels;
+}
+
+void DiceKeyReadDeltaTracker::delta(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines, DiceKeyReadDelta &delta) {
+	delta.sequenceNumber = ++sequenceNumber;
+	delta.isInitialized = diceKey.isInitialized();
+	delta.changedFaces.clear();
+	delta.undoverlines.clear();
+	if (!diceKey.isInitialized()) {
+		reportedInitialized = false;
+		return;
+	}
+	for (size_t i = 0; i < NumberOfFaces; i++) {
+		const FaceRead &face = diceKey.faces[i];
+		const ReportedFace current = reportOf(face, undoverlines);
+		if (!reportedInitialized || hasChanged(reportedFaces[i], current)) {
+			// Only the faces reported move their baseline, so that slow drift
+			// is reported once it accumulates past the threshold
+			reportedFaces[i] = current;
+			FaceReadChange change = { i, face.withUndoverlinesCopiedTo(delta.undoverlines, undoverlines) };
+			delta.changedFaces.push_back(change);
+		}
+	}
+	reportedInitialized = true;
+}
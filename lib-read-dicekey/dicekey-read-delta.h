@@ -0,0 +1,103 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <string>
+#include <vector>
+#include "../lib-dicekey/dicekey.hpp"
+#include "face-read.h"
+
+namespace JsonKeys {
+	namespace DiceKeyReadDelta {
+		const char sequenceNumber[] = "sequenceNumber";
+		const char isInitialized[] = "isInitialized";
+		const char faces[] = "faces";
+		const char index[] = "index";
+		const char face[] = "face";
+	};
+};
+
+/**
+ * A face that changed since the last delta, and its index within the DiceKey.
+ * The face's undoverlines are in the table of the delta.
+ **/
+struct FaceReadChange {
+	size_t faceIndex;
+	FaceRead face;
+};
+
+/**
+ * The faces of a DiceKey read that have changed since the previous delta.
+ *
+ * Deltas are numbered in sequence, starting at 1, so that a consumer applying them
+ * in turn can tell if it has missed one (and should ask for a full resend with
+ * DiceKeyReadDeltaTracker::reset).  A delta in which isInitialized is false means
+ * that no key is being read, and the consumer should discard the faces it has;
+ * the next delta in which a key is read will contain all of its faces.
+ **/
+struct DiceKeyReadDelta {
+	uint32_t sequenceNumber = 0;
+	bool isInitialized = false;
+	std::vector<FaceReadChange> changedFaces;
+	// The undoverlines of the faces that changed
+	UndoverlineTable undoverlines;
+
+	/**
+	 * {"sequenceNumber": N, "isInitialized": B, "faces": [{"index": I, "face": F}, ...]}
+	 * where each F is in the format of FaceRead::toJson.
+	 **/
+	std::string toJson() const;
+	void appendJson(std::string &json) const;
+};
+
+/**
+ * Track the faces of a DiceKey read that were last reported to a consumer, so that
+ * only the faces that have since changed need be reported again.
+ *
+ * A face has changed if its letter, digit, orientation, or error (magnitude or
+ * location) differs from that last reported, or if its center has moved more than
+ * positionThresholdInPixels.
+ **/
+class DiceKeyReadDeltaTracker {
+private:
+	// What was last reported for each face
+	struct ReportedFace {
+		char letter;
+		char digit;
+		char orientationAs0to3ClockwiseTurnsFromUpright;
+		FaceError error;
+		cv::Point2f center;
+	};
+
+	uint32_t sequenceNumber = 0;
+	bool reportedInitialized = false;
+	std::array<ReportedFace, NumberOfFaces> reportedFaces;
+	float positionThresholdInPixels = 1.0f;
+
+	static ReportedFace reportOf(const FaceRead &face, const UndoverlineTable &undoverlines);
+	bool hasChanged(const ReportedFace &reported, const ReportedFace &current) const;
+
+public:
+	/**
+	 * Faces whose centers have moved no more than this many pixels since they were
+	 * last reported (and which have not otherwise changed) are left out of deltas.
+	 * Defaults to 1 pixel.
+	 **/
+	void setPositionThreshold(float pixels) { positionThresholdInPixels = pixels; }
+
+	/**
+	 * Forget what was reported, so that the next delta contains every face.
+	 * Sequence numbers continue from where they were.
+	 **/
+	void reset() { reportedInitialized = false; }
+
+	/**
+	 * Return the faces of the key (whose undoverlines are in the given table) that
+	 * have changed since the previous delta, and record them as reported.  The delta
+	 * is written into the caller's delta, replacing its contents, so that callers can
+	 * reuse its storage.
+	 **/
+	void delta(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines, DiceKeyReadDelta &delta);
+};
@@ -3,4 +3,4 @@
 
 #include "ocr-font.h"
 
-extern OcrFont Inconsolata700;
+extern const OcrFont Inconsolata700;
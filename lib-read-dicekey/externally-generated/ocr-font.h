@@ -1,7 +1,25 @@
-
 #pragma once
 
-#include <vector>
+#include <stddef.h>
+
+/*
+A view of a constant array, which (unlike a std::vector) can be constant-initialized
+so that the font's tables are placed in read-only data rather than built on the heap
+when the library loads.
+*/
+template <typename T>
+struct ConstArray {
+	const T* elements;
+	size_t length;
+
+	template <size_t N>
+	constexpr ConstArray(const T (&array)[N]) : elements(array), length(N) {}
+
+	size_t size() const { return length; }
+	const T& operator[](size_t index) const { return elements[index]; }
+	const T* begin() const { return elements; }
+	const T* end() const { return elements + length; }
+};
 
 struct UShortPoint {
 	unsigned short x;
@@ -10,12 +28,12 @@ struct UShortPoint {
 
 struct OcrChar {
 	char character;
-	const std::vector<UShortPoint> outlinePoints;
+	ConstArray<UShortPoint> outlinePoints;
 };
 
 struct OcrAlphabet {
 	// A description of each character
-	std::vector<OcrChar> characters;
+	ConstArray<OcrChar> characters;
 
 	// [ocrCharHeightInPixels][ocrCharWidthInPixels][characters.size()]
 	// entry = [y][x][characterIndex]
@@ -26,32 +26,40 @@ namespace FaceErrors {
 
 FaceRead FaceRead::rotate(int clockwiseTurnsToRight) const
 {
-  return FaceRead(
-    underline,
-    overline,
+  FaceRead rotated(*this);
+  rotated._orientationAs0to3ClockwiseTurnsFromUpright =
     (int) orientationAs0to3ClockwiseTurnsFromUpright() == '?' ? '?' :
-      clockwiseTurnsToRange0To3(orientationAs0to3ClockwiseTurnsFromUpright() + clockwiseTurnsToRight),
-    ocrLetterFromMostToLeastLikely,
-    ocrDigitFromMostToLeastLikely
-  );
+      char(clockwiseTurnsToRange0To3(orientationAs0to3ClockwiseTurnsFromUpright() + clockwiseTurnsToRight));
+  return rotated;
+}
+
+FaceRead FaceRead::withUndoverlinesCopiedTo(UndoverlineTable &undoverlines, const UndoverlineTable &fromUndoverlines) const {
+  FaceRead copy(*this);
+  if (underlineIndex() != UndoverlineTable::NoIndex) {
+    copy.underlineReference.tableIndex = undoverlines.add(fromUndoverlines[underlineIndex()]);
+  }
+  if (overlineIndex() != UndoverlineTable::NoIndex) {
+    copy.overlineReference.tableIndex = undoverlines.add(fromUndoverlines[overlineIndex()]);
+  }
+  return copy;
 }
 
 char FaceRead::ocrLetterMostLikely() const {
-	return ocrLetterFromMostToLeastLikely.length() == 0 ? '?' : ocrLetterFromMostToLeastLikely[0];
+	return ocrLetters.mostLikely();
 }
 char FaceRead::ocrDigitMostLikely() const {
-	return ocrDigitFromMostToLeastLikely.length() == 0 ? '?' : ocrDigitFromMostToLeastLikely[0];
+	return ocrDigits.mostLikely();
 }
 
 char FaceRead::letter() const {
 	const char letter = majorityOfThree(
-		underline.faceInferred->letter, overline.faceInferred->letter, ocrLetterMostLikely()
+		underlineReference.faceInferred->letter, overlineReference.faceInferred->letter, ocrLetterMostLikely()
 	);
 	return letter != 0 ? letter : '?';
 }
 char FaceRead::digit() const {
 	const char digit = majorityOfThree(
-		underline.faceInferred->digit, overline.faceInferred->digit, ocrDigitMostLikely()
+		underlineReference.faceInferred->digit, overlineReference.faceInferred->digit, ocrDigitMostLikely()
 	);
 	return digit != 0 ? digit : '?';
 }
@@ -64,55 +72,61 @@ unsigned int FaceRead::errorSize() const {
 	return error().magnitude;
 }
 
-std::string FaceRead::toJson() const {
-	std::ostringstream jsonStream;
-	jsonStream <<
-		"{" <<
-			"\"" << JsonKeys::FaceRead::underline << "\": " << underline.toJson() << ", " <<
-			"\"" << JsonKeys::FaceRead::overline << "\": " << overline.toJson() << ", " <<
-			"\"" << JsonKeys::FaceRead::center << "\": " << pointToJson(center()) << ", " <<
-			"\"" << JsonKeys::FaceRead::orientationAsLowercaseLetterTrbl << "\": \"" << std::string(1, orientationAsLowercaseLetterTRBL()) << "\"," <<
-			"\"" << JsonKeys::FaceRead::ocrLetterCharsFromMostToLeastLikely << "\": \"" <<
-				ocrLetterFromMostToLeastLikely << "\", " <<
-			"\"" << JsonKeys::FaceRead::ocrDigitCharsFromMostToLeastLikely << "\": \"" <<
-				ocrDigitFromMostToLeastLikely << "\"" <<
-		"}";
-	return jsonStream.str();
+std::string FaceRead::toJson(const UndoverlineTable &undoverlines) const {
+	std::string json;
+	appendJson(json, undoverlines);
+	return json;
+}
+
+void FaceRead::appendJson(std::string &json, const UndoverlineTable &undoverlines) const {
+	json += '{';
+	jsonAppendKey(json, JsonKeys::FaceRead::underline);
+	underline(undoverlines).appendJson(json);
+	json += ", ";
+	jsonAppendKey(json, JsonKeys::FaceRead::overline);
+	overline(undoverlines).appendJson(json);
+	json += ", ";
+	jsonAppendKey(json, JsonKeys::FaceRead::center);
+	jsonAppendPoint(json, center(undoverlines));
+	json += ", ";
+	const char orientation = orientationAsLowercaseLetterTRBL();
+	jsonAppendKey(json, JsonKeys::FaceRead::orientationAsLowercaseLetterTrbl);
+	jsonAppendQuoted(json, &orientation, 1);
+	json += ',';
+	jsonAppendKey(json, JsonKeys::FaceRead::ocrLetterCharsFromMostToLeastLikely);
+	jsonAppendQuoted(json, ocrLetters.characters, ocrLetters.count);
+	json += ", ";
+	jsonAppendKey(json, JsonKeys::FaceRead::ocrDigitCharsFromMostToLeastLikely);
+	jsonAppendQuoted(json, ocrDigits.characters, ocrDigits.count);
+	json += '}';
 }
 
-// Return an estimate of the error in reading an element face.
-// If the underline, overline, and OCR results match, the error is 0.
-// If the only error is a 1-3 bit error in either the underline or overline,
-// the result is the number of bits (hamming distance) in the underline or overline
-// that doesn't match the OCR result.
-// If the underline and overline match but matched with the OCR's second choice of
-// letter or digit, we return 2.
 FaceError FaceRead::error() const {
-		if (ocrLetterFromMostToLeastLikely.length() == 0 || ocrDigitFromMostToLeastLikely.length() == 0) {
+		if (ocrLetters.count == 0 || ocrDigits.count == 0) {
 			return FaceErrors::WorstPossible;
 		}
 		unsigned char errorLocation = 0;
 		unsigned int errorMagnitude = 0;
-		const char ocrLetter0 = ocrLetterMostLikely();
-		const char ocrDigit0 = ocrDigitMostLikely();
-		const FaceSpecification* pUnderlineFaceInferred = underline.faceInferred;
-		const FaceSpecification* pOverlineFaceInferred = overline.faceInferred;
+		const char ocrLetter0 = ocrLetters.mostLikely();
+		const char ocrDigit0 = ocrDigits.mostLikely();
+		const FaceSpecification* pUnderlineFaceInferred = underlineReference.faceInferred;
+		const FaceSpecification* pOverlineFaceInferred = overlineReference.faceInferred;
 
 		// Test hypothesis of no error
 		if (pUnderlineFaceInferred == pOverlineFaceInferred) {
 			// The underline and overline map to the same face
-			const FaceSpecification& undoverlineFaceInferred = *(underline.faceInferred);
+			const FaceSpecification& undoverlineFaceInferred = *pUnderlineFaceInferred;
 
 			// Check for OCR errors for the letter read
-			if (undoverlineFaceInferred.letter != ocrLetterMostLikely()) {
+			if (undoverlineFaceInferred.letter != ocrLetter0) {
 				errorLocation |= FaceErrors::Location::OcrLetter;
-				errorMagnitude += undoverlineFaceInferred.letter == ocrLetterFromMostToLeastLikely[1] ?
+				errorMagnitude += undoverlineFaceInferred.letter == ocrLetters.secondMostLikely() ?
 					FaceErrors::Magnitude::OcrCharacterWasSecondChoice :
 					FaceErrors::Magnitude::OcrCharacterInvalid;
 			}
-			if (undoverlineFaceInferred.digit != ocrDigitMostLikely()) {
+			if (undoverlineFaceInferred.digit != ocrDigit0) {
 				errorLocation |= FaceErrors::Location::OcrDigit;
-				errorMagnitude += undoverlineFaceInferred.digit == ocrDigitFromMostToLeastLikely[1] ?
+				errorMagnitude += undoverlineFaceInferred.digit == ocrDigits.secondMostLikely() ?
 					FaceErrors::Magnitude::OcrCharacterWasSecondChoice :
 					FaceErrors::Magnitude::OcrCharacterInvalid;
 			}
@@ -123,9 +137,9 @@ FaceError FaceRead::error() const {
 		if (underlineFaceInferred.letter == ocrLetter0 && underlineFaceInferred.digit == ocrDigit0) {
 			// The underline matches the OCR result, so the error is in the overline
 			return {
-					overline.found ?
+					overlineReference.found ?
 						// The magnitude of the error is the hamming distance error in overline
-						(unsigned char)hammingDistance(underlineFaceInferred.overlineCode, overline.letterDigitEncoding) :
+						(unsigned char)hammingDistance(underlineFaceInferred.overlineCode, overlineReference.letterDigitEncoding) :
 						// Since the overline was not found, the magnitude is specified via a constant
 						FaceErrors::Magnitude::UnderlineOrOverlineMissing,
 					FaceErrors::Location::Overline
@@ -134,9 +148,9 @@ FaceError FaceRead::error() const {
 		if (overlineFaceInferred.letter == ocrLetter0 && overlineFaceInferred.digit == ocrDigit0) {
 			// Since overline matches the OCR result, so the error is in the underline
 			return {
-				underline.found ?
+				underlineReference.found ?
 					// The magnitude of the error is the hamming distance error in underline
-					(unsigned char)hammingDistance(overlineFaceInferred.underlineCode, underline.letterDigitEncoding) :				
+					(unsigned char)hammingDistance(overlineFaceInferred.underlineCode, underlineReference.letterDigitEncoding) :
 					// Since the underline was not found, the magnitude is specified via a constant
 					FaceErrors::Magnitude::UnderlineOrOverlineMissing,
 					FaceErrors::Location::Underline
@@ -144,4 +158,25 @@ FaceError FaceRead::error() const {
 		}
 		// No good matching.  Return max error
 		return {std::numeric_limits<unsigned char>::max(), std::numeric_limits<unsigned char>::max()};
-	};
+}
+
+void appendJsonDiceKeyRead(std::string &json, const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines) {
+	if (!diceKey.isInitialized()) {
+		json += "null";
+		return;
+	}
+	json += "[";
+	for (int i = 0; i < NumberOfFaces; i++) {
+		if (i != 0) {
+			json += ",";
+		}
+		diceKey.faces[i].appendJson(json, undoverlines);
+	}
+	json += "]";
+}
+
+std::string diceKeyReadToJson(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines) {
+	std::string json;
+	appendJsonDiceKeyRead(json, diceKey, undoverlines);
+	return json;
+}
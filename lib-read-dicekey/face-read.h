@@ -3,6 +3,9 @@
 #pragma once
 
 
+#include <assert.h>
+#include <stdint.h>
+#include <type_traits>
 #include <string>
 #include <vector>
 #include "graphics/cv.h"
@@ -122,57 +125,210 @@ namespace FaceErrors {
   extern const FaceError None;
 }
 
-class FaceRead final: public FaceUndoverlines, public IFace, public Rotateable<FaceRead> {
+/*
+The characters that OCR found most likely to be a face's letter (or digit), most
+likely first, with their error scores (lower is better).  Held in place, rather
+than in a std::string, so that copying a face never allocates.
+*/
+struct OcrCandidates {
+  static const int MaxCandidates = 2;
+  // The number of candidates (0 if the character was not read)
+  unsigned char count;
+  char characters[MaxCandidates];
+  uint16_t errorScores[MaxCandidates];
+
+  char mostLikely() const { return count == 0 ? '?' : characters[0]; }
+  // The second choice, or 0 if there is none
+  char secondMostLikely() const { return count < 2 ? 0 : characters[1]; }
+
+  std::string toString() const { return std::string(characters, count); }
+};
+
+// Candidates for a character that was not read
+inline OcrCandidates noOcrCandidates() {
+  OcrCandidates candidates = {0, {0, 0}, {0, 0}};
+  return candidates;
+}
+
+// The most likely candidates of an OCR result
+inline OcrCandidates ocrCandidatesFromOcrResult(const OcrResult &ocrResult) {
+  OcrCandidates candidates = noOcrCandidates();
+  for (size_t i = 0; i < ocrResult.size() && candidates.count < OcrCandidates::MaxCandidates; i++) {
+    const int errorScore = ocrResult[i].errorScore;
+    candidates.characters[candidates.count] = ocrResult[i].character;
+    candidates.errorScores[candidates.count] = uint16_t(errorScore < 0 ? 0 : errorScore > 0xFFFF ? 0xFFFF : errorScore);
+    candidates.count++;
+  }
+  return candidates;
+}
+
+// Candidates from the characters of a string, most likely first (without scores)
+inline OcrCandidates ocrCandidatesFromString(const std::string &charactersFromMostToLeastLikely) {
+  OcrCandidates candidates = noOcrCandidates();
+  for (size_t i = 0; i < charactersFromMostToLeastLikely.length() && candidates.count < OcrCandidates::MaxCandidates; i++) {
+    candidates.characters[candidates.count++] = charactersFromMostToLeastLikely[i];
+  }
+  return candidates;
+}
+
+/*
+The undoverlines of the faces read from a frame, which each FaceRead refers to by
+index so that a face holds no geometry of its own and is cheap to copy.
+A table holds at most NoIndex undoverlines.
+*/
+class UndoverlineTable {
 private:
+  std::vector<Undoverline> undoverlines;
+
+public:
+  // The index of an undoverline that is not in any table
+  static const unsigned char NoIndex = 0xFF;
+
+  // Add an undoverline to the table, returning its index
+  unsigned char add(const Undoverline &undoverline) {
+    assert(undoverlines.size() < NoIndex);
+    undoverlines.push_back(undoverline);
+    return (unsigned char)(undoverlines.size() - 1);
+  }
+
+  // The undoverline at an index, or one that was not found if the index is NoIndex
+  const Undoverline &operator[](unsigned char index) const {
+    static const Undoverline notFound;
+    return index == NoIndex ? notFound : undoverlines[index];
+  }
+
+  size_t size() const { return undoverlines.size(); }
+  void clear() { undoverlines.clear(); }
+  std::vector<Undoverline>::iterator begin() { return undoverlines.begin(); }
+  std::vector<Undoverline>::iterator end() { return undoverlines.end(); }
+};
+
+/*
+A face's reference to one of its undoverlines, holding in place what the face's
+letter, digit, and error are decoded from, so that they don't require the table.
+*/
+struct UndoverlineReference {
+  // The index of the undoverline within its UndoverlineTable
+  unsigned char tableIndex;
+  bool found;
+  unsigned char letterDigitEncoding;
+  const FaceSpecification *faceInferred;
+};
+
+/*
+A face read from a frame.  The face holds its orientation, the OCR candidates
+for its letter and digit, and references to its underline and overline, whose
+geometry is in the UndoverlineTable of the faces read with it.  Accessors that
+need that geometry take the table.
+*/
+class FaceRead final: public IFace, public Rotateable<FaceRead> {
+private:
+  UndoverlineReference underlineReference;
+  UndoverlineReference overlineReference;
 	char _orientationAs0to3ClockwiseTurnsFromUpright;
-  std::string ocrLetterFromMostToLeastLikely;
-  std::string ocrDigitFromMostToLeastLikely;
+  OcrCandidates ocrLetters;
+  OcrCandidates ocrDigits;
+
+  // A reference to no undoverline
+  static UndoverlineReference noReference() {
+    const UndoverlineReference reference = { UndoverlineTable::NoIndex, false, 0, &NullFaceSpecification };
+    return reference;
+  }
+
+  static UndoverlineReference referenceTo(const UndoverlineTable &undoverlines, unsigned char tableIndex) {
+    const Undoverline &undoverline = undoverlines[tableIndex];
+    const UndoverlineReference reference = {
+      tableIndex, undoverline.found, undoverline.letterDigitEncoding, undoverline.faceInferred
+    };
+    return reference;
+  }
+
 public:
 
 	FaceRead() :
-    FaceUndoverlines(),
+    underlineReference(noReference()),
+    overlineReference(noReference()),
 		_orientationAs0to3ClockwiseTurnsFromUpright(0),
-    ocrLetterFromMostToLeastLikely(""),
-    ocrDigitFromMostToLeastLikely("")
+    ocrLetters(noOcrCandidates()),
+    ocrDigits(noOcrCandidates())
 	{}
 
+  // A face whose underline and overline are already in the table
   FaceRead(
-		const FaceUndoverlines undoverlines,
+    const UndoverlineTable &undoverlines,
+    unsigned char underlineIndex,
+    unsigned char overlineIndex,
 		const char __orientationAs0to3ClockwiseTurnsFromUpright,
-    const std::string _ocrLetterFromMostToLeastLikely,
-    const std::string _ocrDigitFromMostToLeastLikely
+    const OcrCandidates &_ocrLetters,
+    const OcrCandidates &_ocrDigits
 	) :
-    FaceUndoverlines(undoverlines.underline, undoverlines.overline),
+    underlineReference(referenceTo(undoverlines, underlineIndex)),
+    overlineReference(referenceTo(undoverlines, overlineIndex)),
 		_orientationAs0to3ClockwiseTurnsFromUpright(__orientationAs0to3ClockwiseTurnsFromUpright),
-    ocrLetterFromMostToLeastLikely(_ocrLetterFromMostToLeastLikely),
-    ocrDigitFromMostToLeastLikely(_ocrDigitFromMostToLeastLikely)
-
+    ocrLetters(_ocrLetters),
+    ocrDigits(_ocrDigits)
   {}
 
-	FaceRead(
-		const Undoverline _underline,
-		const Undoverline _overline,
-		const int __orientationAs0to3ClockwiseTurnsFromUpright,
-    const std::string _ocrLetterFromMostToLeastLikely,
-    const std::string _ocrDigitFromMostToLeastLikely
+  // A face whose underline and overline are added to the table
+  FaceRead(
+    UndoverlineTable &undoverlines,
+		const FaceUndoverlines &faceUndoverlines,
+		const char __orientationAs0to3ClockwiseTurnsFromUpright,
+    const OcrCandidates &_ocrLetters,
+    const OcrCandidates &_ocrDigits
 	) :
-    FaceUndoverlines(_underline, _overline),
 		_orientationAs0to3ClockwiseTurnsFromUpright(__orientationAs0to3ClockwiseTurnsFromUpright),
-    ocrLetterFromMostToLeastLikely(_ocrLetterFromMostToLeastLikely),
-    ocrDigitFromMostToLeastLikely(_ocrDigitFromMostToLeastLikely)
-  {}
+    ocrLetters(_ocrLetters),
+    ocrDigits(_ocrDigits)
+  {
+    underlineReference = referenceTo(undoverlines, undoverlines.add(faceUndoverlines.underline));
+    overlineReference = referenceTo(undoverlines, undoverlines.add(faceUndoverlines.overline));
+  }
+
+  FaceRead(
+    UndoverlineTable &undoverlines,
+		const FaceUndoverlines &faceUndoverlines,
+		const char __orientationAs0to3ClockwiseTurnsFromUpright,
+    const std::string _ocrLetterFromMostToLeastLikely,
+    const std::string _ocrDigitFromMostToLeastLikely
+	) : FaceRead(
+    undoverlines, faceUndoverlines, __orientationAs0to3ClockwiseTurnsFromUpright,
+    ocrCandidatesFromString(_ocrLetterFromMostToLeastLikely),
+    ocrCandidatesFromString(_ocrDigitFromMostToLeastLikely)
+  ) {}
 
 
   FaceRead rotate(int clockwiseTurnsToRight) const;
 
+  // The indexes of the face's underline and overline within their table
+  unsigned char underlineIndex() const { return underlineReference.tableIndex; }
+  unsigned char overlineIndex() const { return overlineReference.tableIndex; }
+
+  // The face's underline and overline, from the table of the faces read with it
+  const Undoverline &underline(const UndoverlineTable &undoverlines) const { return undoverlines[underlineIndex()]; }
+  const Undoverline &overline(const UndoverlineTable &undoverlines) const { return undoverlines[overlineIndex()]; }
+  FaceUndoverlines undoverlines(const UndoverlineTable &undoverlines) const {
+    return FaceUndoverlines(underline(undoverlines), overline(undoverlines));
+  }
+
 	// Calculated after face location and angle are derived from
 	// the underline and/or overline (both if possible)
+  cv::Point2f center(const UndoverlineTable &undoverlines) const { return this->undoverlines(undoverlines).center(); }
+  float inferredAngleInRadians(const UndoverlineTable &undoverlines) const { return this->undoverlines(undoverlines).inferredAngleInRadians(); }
+  float inferredSizeInPixels(const UndoverlineTable &undoverlines) const { return this->undoverlines(undoverlines).inferredSizeInPixels(); }
+
+  // Return a copy of the face that refers to copies of its undoverlines,
+  // added to another table
+  FaceRead withUndoverlinesCopiedTo(UndoverlineTable &undoverlines, const UndoverlineTable &fromUndoverlines) const;
 
-  //
-	std::string toJson() const;
+  // The face in JSON format, including the geometry of its undoverlines
+	std::string toJson(const UndoverlineTable &undoverlines) const;
+  void appendJson(std::string &json, const UndoverlineTable &undoverlines) const;
 
   char ocrLetterMostLikely() const;
   char ocrDigitMostLikely() const;
+  const OcrCandidates &ocrLetterCandidates() const { return ocrLetters; }
+  const OcrCandidates &ocrDigitCandidates() const { return ocrDigits; }
 
   char letter() const;
   char digit() const;
@@ -187,7 +343,14 @@ public:
   // letter or digit, we return 2.
 	FaceError error() const;
 
-  std::vector<unsigned char>imageData;
-
 	unsigned int errorSize() const;
-};
\ No newline at end of file
+};
+
+static_assert(std::is_trivially_destructible<FaceRead>::value, "Faces must own nothing, so that copying one copies no more than its bytes");
+
+/*
+Append a DiceKey read, in the JSON format of DiceKey::toJson but with each face in
+the format of FaceRead::toJson, to a buffer.
+*/
+void appendJsonDiceKeyRead(std::string &json, const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines);
+std::string diceKeyReadToJson(const DiceKey<FaceRead> &diceKey, const UndoverlineTable &undoverlines);
@@ -1,17 +1,21 @@
 //  © 2019 Stuart Edward Schechter (Github: @uppajung)
 #include <float.h>
+#include <math.h>
+#include <algorithm>
+#include "utilities/vfunctional.h"
 #include "utilities/statistics.h"
 #include "graphics/cv.h"
 #include "graphics/geometry.h"
 #include "find-undoverlines.h"
 #include "read-faces.h"
 #include "find-faces.h"
+#include "frame-stats.h"
 #include "../lib-dicekey/externally-generated/dicekey-face-specification.h"
 
-FaceAndStrayUndoverlinesFound findFacesAndStrayUndoverlines(
-	const cv::Mat &grayscaleImage
+FaceAndStrayUndoverlinesFound pairUndoverlinesIntoFaces(
+	const UnderlinesAndOverlines &undoverlines
 ) {
-	const auto undoverlines = findReadableUndoverlines(grayscaleImage);
+	FRAME_STATS_TIME_STAGE(pairingMicroseconds);
 
 	std::vector<Undoverline> underlines(undoverlines.underlines);
 	std::vector<Undoverline> overlines(undoverlines.overlines);
@@ -63,5 +67,157 @@ FaceAndStrayUndoverlinesFound findFacesAndStrayUndoverlines(
 	// stray undoverlines.
 	strayUndoverlines.insert(strayUndoverlines.end(), overlines.begin(), overlines.end());
 
+	FRAME_STATS_COUNT(facesFound, unsigned(facesFound.size()));
+	FRAME_STATS_COUNT(strayUndoverlines, unsigned(strayUndoverlines.size()));
+
 	return { facesFound, strayUndoverlines, pixelsPerFaceEdgeWidth };
 }
+
+FaceAndStrayUndoverlinesFound findFacesAndStrayUndoverlines(
+	const cv::Mat &grayscaleImage
+) {
+	return pairUndoverlinesIntoFaces(findReadableUndoverlines(grayscaleImage));
+}
+
+/*
+	Group undoverlines that are close enough in length, and in angle modulo 90 degrees
+	(since the dice in a DiceKey may be rotated to any of four orientations), that
+	they may belong to the same DiceKey.
+*/
+static std::vector<UnderlinesAndOverlines> groupUndoverlinesBySizeAndAngle(
+	const UnderlinesAndOverlines &undoverlines,
+	const float maxLengthRatio,
+	const float maxAngleDifferenceInRadians
+) {
+	struct UndoverlineGroup {
+		float length;
+		float angleInRadians;
+		UnderlinesAndOverlines members;
+	};
+	std::vector<UndoverlineGroup> groups;
+	const auto addToGroup = [&](const Undoverline &undoverline) {
+		const float length = lineLength(undoverline.line);
+		const float angleInRadians = angleOfLineInSignedRadians2f(undoverline.line);
+		UndoverlineGroup *group = nullptr;
+		for (auto &candidate : groups) {
+			if (
+				std::max(length, candidate.length) <= maxLengthRatio * std::min(length, candidate.length) &&
+				distanceInModCircularRangeFromNegativeNToN(angleInRadians, candidate.angleInRadians, float(M_PI / 4)) <= maxAngleDifferenceInRadians
+			) {
+				group = &candidate;
+				break;
+			}
+		}
+		if (group == nullptr) {
+			groups.push_back({ length, angleInRadians, {} });
+			group = &groups.back();
+		}
+		(undoverline.isOverline ? group->members.overlines : group->members.underlines).push_back(undoverline);
+	};
+	for (const auto &underline : undoverlines.underlines) {
+		addToGroup(underline);
+	}
+	for (const auto &overline : undoverlines.overlines) {
+		addToGroup(overline);
+	}
+	std::vector<UnderlinesAndOverlines> undoverlinesOfEachGroup;
+	for (auto &group : groups) {
+		undoverlinesOfEachGroup.push_back(std::move(group.members));
+	}
+	return undoverlinesOfEachGroup;
+}
+
+/*
+	Split faces (and stray undoverlines) of the same size and angle into the sets that
+	are near each other.  Faces are linked to any face within one and a half times the
+	typical distance between neighboring faces, which reaches diagonal neighbors and
+	so across a single missing face, but not across the gap between two DiceKey boxes.
+*/
+static std::vector<FaceAndStrayUndoverlinesFound> separateFacesByProximity(
+	const FaceAndStrayUndoverlinesFound &faceAndStrayUndoverlinesFound
+) {
+	const std::vector<FaceUndoverlines> &faces = faceAndStrayUndoverlinesFound.facesFound;
+	const std::vector<Undoverline> &strays = faceAndStrayUndoverlinesFound.strayUndoverlines;
+	if (faces.size() < 2) {
+		return { faceAndStrayUndoverlinesFound };
+	}
+	// The points to link are the centers of faces followed by the inferred face centers of strays
+	std::vector<cv::Point2f> points = vmap<FaceUndoverlines, cv::Point2f>(faces,
+		[](const FaceUndoverlines *face) { return face->center(); });
+	for (const auto &stray : strays) {
+		points.push_back(stray.inferredCenterOfFace);
+	}
+
+	std::vector<float> nearestNeighborDistances;
+	for (size_t i = 0; i < faces.size(); i++) {
+		float nearest = FLT_MAX;
+		for (size_t j = 0; j < faces.size(); j++) {
+			if (i != j) {
+				nearest = std::min(nearest, distance2f(points[i], points[j]));
+			}
+		}
+		nearestNeighborDistances.push_back(nearest);
+	}
+	const float maxLinkDistance = 1.5f * medianInPlace(nearestNeighborDistances);
+
+	// Label each point with the set it belongs to by flooding out from unlabeled faces
+	std::vector<int> setOfPoint(points.size(), -1);
+	int numberOfSets = 0;
+	for (size_t start = 0; start < faces.size(); start++) {
+		if (setOfPoint[start] >= 0) {
+			continue;
+		}
+		std::vector<size_t> toVisit = { start };
+		setOfPoint[start] = numberOfSets;
+		while (!toVisit.empty()) {
+			const size_t i = toVisit.back();
+			toVisit.pop_back();
+			for (size_t j = 0; j < points.size(); j++) {
+				if (setOfPoint[j] < 0 && distance2f(points[i], points[j]) <= maxLinkDistance) {
+					setOfPoint[j] = numberOfSets;
+					toVisit.push_back(j);
+				}
+			}
+		}
+		numberOfSets++;
+	}
+
+	std::vector<FaceAndStrayUndoverlinesFound> sets((size_t) numberOfSets);
+	for (auto &set : sets) {
+		set.pixelsPerFaceEdgeWidth = faceAndStrayUndoverlinesFound.pixelsPerFaceEdgeWidth;
+	}
+	for (size_t i = 0; i < faces.size(); i++) {
+		sets[size_t(setOfPoint[i])].facesFound.push_back(faces[i]);
+	}
+	for (size_t i = 0; i < strays.size(); i++) {
+		// Strays too far from any face belong to no DiceKey
+		const int set = setOfPoint[faces.size() + i];
+		if (set >= 0) {
+			sets[size_t(set)].strayUndoverlines.push_back(strays[i]);
+		}
+	}
+	return sets;
+}
+
+std::vector<FaceAndStrayUndoverlinesFound> findFacesAndStrayUndoverlinesOfEachDiceKey(
+	const cv::Mat &grayscaleImage
+) {
+	const auto undoverlines = findReadableUndoverlines(grayscaleImage, true);
+	std::vector<FaceAndStrayUndoverlinesFound> candidateDiceKeys;
+	// Undoverlines more than 25% longer or 10 degrees rotated from each other
+	// are assumed to be on different DiceKeys
+	for (const auto &group : groupUndoverlinesBySizeAndAngle(undoverlines, 1.25f, float(M_PI / 18))) {
+		if (group.underlines.empty()) {
+			// Faces can't be sized, or paired, without an underline
+			continue;
+		}
+		for (auto &faces : separateFacesByProximity(pairUndoverlinesIntoFaces(group))) {
+			// A 5x5 grid can only be fit to a row and a column of five faces,
+			// which together have at least nine faces.
+			if (faces.facesFound.size() >= 9) {
+				candidateDiceKeys.push_back(std::move(faces));
+			}
+		}
+	}
+	return candidateDiceKeys;
+}
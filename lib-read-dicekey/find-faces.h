@@ -6,6 +6,7 @@
 #include <vector>
 #include "graphics/cv.h"
 #include "face-read.h"
+#include "find-undoverlines.h"
 
 struct FaceAndStrayUndoverlinesFound {
 	std::vector<FaceUndoverlines> facesFound;
@@ -16,3 +17,23 @@ struct FaceAndStrayUndoverlinesFound {
 FaceAndStrayUndoverlinesFound findFacesAndStrayUndoverlines(
 	const cv::Mat &grayscaleImage
 );
+
+/**
+ * Pair each underline with the overline of the same face.  The faces are
+ * assumed to be of one size, derived from the median length of the underlines.
+ **/
+FaceAndStrayUndoverlinesFound pairUndoverlinesIntoFaces(
+	const UnderlinesAndOverlines &undoverlines
+);
+
+/**
+ * Find the faces and stray undoverlines of each of the DiceKeys in an image
+ * that may contain more than one, using a single pass to find undoverlines.
+ * Undoverlines are grouped by size and angle, so that each group has its own
+ * pixelsPerFaceEdgeWidth, and the faces of each group are then separated into
+ * the sets that are near each other.  Sets with too few faces to fit a grid
+ * to are dropped.
+ **/
+std::vector<FaceAndStrayUndoverlinesFound> findFacesAndStrayUndoverlinesOfEachDiceKey(
+	const cv::Mat &grayscaleImage
+);
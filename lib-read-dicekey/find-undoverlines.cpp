@@ -9,6 +9,8 @@
 #include "graphics/geometry.h"
 #include "graphics/find-rectangles.h"
 #include "graphics/rectangle.h"
+#include "frame-stats.h"
+#include "trace.h"
 #include "graphics/rotate.h"
 #include "graphics/sample-point.h"
 #include "graphics/draw-rotated-rect.h"
@@ -36,7 +38,9 @@ float findTighestModalAreaOfRects(const std::vector<RectangleDetected> &rects, s
 	std::sort(areas.begin(), areas.end(), [](float a, float b) -> bool {return a < b;});
 	float tightestModeRange = std::numeric_limits<float>::max();
 	float areaAtTigghtestMode = NAN;
-	int maxPossibleIndex = int(areas.size() - (halfModeSize + 2));
+	// Small sets (e.g., the candidates left for another DiceKey when reading
+	// several) have room for at least the window starting at the smallest area
+	const size_t maxPossibleIndex = MAX(areas.size() - MIN(areas.size(), halfModeSize + 2), halfModeSize + 1);
 	for (size_t i = halfModeSize; i < maxPossibleIndex; i++) {
 		const float modeRange = areas[i + halfModeSize] / areas[i - halfModeSize];
 
@@ -53,58 +57,115 @@ float findTighestModalAreaOfRects(const std::vector<RectangleDetected> &rects, s
 }
 
 
+/*
+Candidates of similar area, which for a single DiceKey are the candidates for
+its undoverlines, along with their modal area and angle.
+*/
+struct CandidateUndoverlinesOfOneSize {
+	std::vector<RectangleDetected> candidates;
+	float tightestArea;
+	float targetAngleInDegrees;
+};
+
+// A group of candidates smaller than this has too few undoverlines for the nine
+// faces needed to fit a grid to a DiceKey
+const size_t minCandidatesOfOneSizeForAnotherDiceKey = 2 * 9;
+
+/*
+Move the candidates within 25% of the modal area of the candidates into a group of their own.
+*/
+static CandidateUndoverlinesOfOneSize takeCandidatesOfModalSize(std::vector<RectangleDetected> &candidateUndoverlines) {
+	CandidateUndoverlinesOfOneSize group;
+	group.tightestArea = findTighestModalAreaOfRects(candidateUndoverlines);
+	const float minArea = 0.75f * group.tightestArea;
+	const float maxArea = group.tightestArea / 0.75f;
+	std::vector<RectangleDetected> otherSizes;
+	for (const RectangleDetected &r : candidateUndoverlines) {
+		(r.area >= minArea && r.area <= maxArea ? group.candidates : otherSizes).push_back(r);
+	}
+	candidateUndoverlines.swap(otherSizes);
+
+	// Calculate the modal slope of the surviving undoverlines (mod 90) so that we can
+	// favor underlines with similar slopes
+	// (mod 90 because undoverlines may be at one of four 90-degree rotations,
+	//  and on a cicular line so that angles of 1 and 89 are distance 2, not distance 88)
+	group.targetAngleInDegrees = findPointOnCircularSignedNumberLineClosestToCenterOfMass(
+		vmap<RectangleDetected, float>(group.candidates,
+			[](const RectangleDetected *r) -> float { return r->angleInDegrees; }),
+		float(45));
+	return group;
+}
+
+static std::vector<RectangleDetected> removeOverlappingCandidates(const CandidateUndoverlinesOfOneSize &group) {
+	const float tightestArea = group.tightestArea;
+	const float targetAngleInDegrees = group.targetAngleInDegrees;
+	return removeOverlappingRectangles(group.candidates, [tightestArea, targetAngleInDegrees](RectangleDetected r) -> float {
+		float deviationFromSideRatio = (r.shorterSideLength / r.longerSideLength) / undoverlineWidthAsFractionOfLength;
+		if (deviationFromSideRatio < 1 && deviationFromSideRatio > 0) {
+			deviationFromSideRatio = 1 / deviationFromSideRatio;
+		}
+		deviationFromSideRatio -= 1;
+		float devationFromSideLengthRatioPenalty = 2.0f * deviationFromSideRatio;
+		float deviationFromTargetArea = r.area < tightestArea ?
+			// Deviation penalty for falling short of target
+			((tightestArea / r.area) - 1) :
+			// The consequences of capturing extra area are smaller,
+			// so cut the penalty in half for those.
+			(((r.area / tightestArea) - 1) / 2);
+		// The penalty from deviating from the target angle
+		const float angleDiff = distanceInModCircularRangeFromNegativeNToN(r.angleInDegrees, targetAngleInDegrees, float(90));
+		float deviationFromTargetAngle = 2.0f * angleDiff;
+
+		return devationFromSideLengthRatioPenalty + deviationFromTargetArea + deviationFromTargetAngle;
+	});
+}
+
 // returns sequence of squares detected on the image.
-std::vector<RectangleDetected> findCandidateUndoverlines(const cv::Mat& grayscaleImage, int N = 13)
+std::vector<RectangleDetected> findCandidateUndoverlines(const cv::Mat& grayscaleImage, int N, bool multipleDiceKeys)
 {
-	std::vector<RectangleDetected> candidateUndoverlines = vfilter<RectangleDetected>(
-		findRectangles(grayscaleImage, N), isRectangleShapedLikeUndoverline);
-
-	if (candidateUndoverlines.size() > 25) {
-		float tightestArea = findTighestModalAreaOfRects(candidateUndoverlines);
-		float minArea = 0.75f * tightestArea;
-		float maxArea = tightestArea / 0.75f;
-		candidateUndoverlines = vfilter<RectangleDetected>(candidateUndoverlines, [minArea, maxArea](const RectangleDetected *r) {
-			return  (r->area >= minArea && r->area <= maxArea);
-			});
-
-		// Calculate the modal slope of the surviving undoverlines (mod 90) so that we can
-		// favor underlines with similar slopes
-		// (mod 90 because undoverlines may be at one of four 90-degree rotations,
-		//  and on a cicular line so that angles of 1 and 89 are distance 2, not distance 88)
-		float targetAngleInDegrees = findPointOnCircularSignedNumberLineClosestToCenterOfMass(
-			vmap<RectangleDetected, float>(candidateUndoverlines,
-				[](const RectangleDetected *r) -> float { return r->angleInDegrees; }),
-			float(45));
-
-		candidateUndoverlines = removeOverlappingRectangles(candidateUndoverlines, [tightestArea, targetAngleInDegrees](RectangleDetected r) -> float {
-			float deviationFromSideRatio = (r.shorterSideLength / r.longerSideLength) / undoverlineWidthAsFractionOfLength;
-			if (deviationFromSideRatio < 1 && deviationFromSideRatio > 0) {
-				deviationFromSideRatio = 1 / deviationFromSideRatio;
-			}
-			deviationFromSideRatio -= 1;
-			float devationFromSideLengthRatioPenalty = 2.0f * deviationFromSideRatio;
-			float deviationFromTargetArea = r.area < tightestArea ?
-				// Deviation penalty for falling short of target
-				((tightestArea / r.area) - 1) :
-				// The consequences of capturing extra area are smaller,
-				// so cut the penalty in half for those.
-				(((r.area / tightestArea) - 1) / 2);
-			// The penalty from deviating from the target angle
-			const float angleDiff = distanceInModCircularRangeFromNegativeNToN(r.angleInDegrees, targetAngleInDegrees, float(90));
-			float deviationFromTargetAngle = 2.0f * angleDiff;
-
-			return devationFromSideLengthRatioPenalty + deviationFromTargetArea + deviationFromTargetAngle;
-			});
-
-			// Uncomment for debugging
-			//cv::Mat colorImage;
-			//cv::cvtColor(grayscaleImage, colorImage, cv::COLOR_GRAY2BGR);
-			//for (auto const r : candidateUndoverlines) {
-			// 	drawRotatedRect(colorImage, r.rotatedRect, cv::Scalar(255, 0, 255), 3);
-			// }
-			//cv::imwrite("candidate-undoverlines.png", colorImage);
+	const std::vector<RectangleDetected> rectangles = findRectangles(grayscaleImage, N);
+
+	std::vector<RectangleDetected> candidateUndoverlines;
+	std::vector<CandidateUndoverlinesOfOneSize> candidatesOfEachSize;
+	{
+		FRAME_STATS_TIME_STAGE(candidateFilteringMicroseconds);
+		candidateUndoverlines = vfilter<RectangleDetected>(rectangles, isRectangleShapedLikeUndoverline);
+
+		if (candidateUndoverlines.size() > 25) {
+			// Keep only the candidates near the modal area.  DiceKeys of different sizes
+			// have undoverlines of different areas, so when reading multiple DiceKeys the
+			// candidates near the modal area of those that remain are kept as another
+			// group, for as long as there are enough to be another DiceKey.
+			do {
+				CandidateUndoverlinesOfOneSize group = takeCandidatesOfModalSize(candidateUndoverlines);
+				if (group.candidates.empty() || (
+					!candidatesOfEachSize.empty() && group.candidates.size() < minCandidatesOfOneSizeForAnotherDiceKey
+				)) {
+					break;
+				}
+				candidatesOfEachSize.push_back(std::move(group));
+			} while (multipleDiceKeys && candidateUndoverlines.size() >= minCandidatesOfOneSizeForAnotherDiceKey);
+			candidateUndoverlines.clear();
+		}
+	}
+
+	if (!candidatesOfEachSize.empty()) {
+		FRAME_STATS_TIME_STAGE(overlapRemovalMicroseconds);
+		for (const CandidateUndoverlinesOfOneSize &group : candidatesOfEachSize) {
+			const std::vector<RectangleDetected> nonOverlapping = removeOverlappingCandidates(group);
+			candidateUndoverlines.insert(candidateUndoverlines.end(), nonOverlapping.begin(), nonOverlapping.end());
+		}
+
+		// Uncomment for debugging
+		//cv::Mat colorImage;
+		//cv::cvtColor(grayscaleImage, colorImage, cv::COLOR_GRAY2BGR);
+		//for (auto const r : candidateUndoverlines) {
+		// 	drawRotatedRect(colorImage, r.rotatedRect, cv::Scalar(255, 0, 255), 3);
+		// }
+		//cv::imwrite("candidate-undoverlines.png", colorImage);
 	}
 
+	FRAME_STATS_COUNT(candidateUndoverlines, unsigned(candidateUndoverlines.size()));
 	return candidateUndoverlines;
 }
 
@@ -206,7 +267,7 @@ Undoverline readUndoverline(
 
 	const std::vector<uchar> medianPixelValues = samplePointsAlongLine(
 		grayscaleImage, undoverlineStartingAtImageLeft.start, undoverlineStartingAtImageLeft.end,
-		FaceDimensionsFractional::dotCentersAsFractionOfUndoverline
+		FaceDimensionsFractional::dotCentersAsFractionOfUndoverline, NumberOfDotsInUndoverline
 	);
 
 	// In finding a white/black threshold, the sampling should ensure
@@ -218,14 +279,17 @@ Undoverline readUndoverline(
 }
 
 UnderlinesAndOverlines findReadableUndoverlines(
-	const cv::Mat &grayscaleImage
+	const cv::Mat &grayscaleImage,
+	bool multipleDiceKeys
 ) {
+	TRACE_SCOPE("findReadableUndoverlines");
 	const std::vector<RectangleDetected> candidateUndoverlineRects =
-		findCandidateUndoverlines(grayscaleImage);
+		findCandidateUndoverlines(grayscaleImage, 13, multipleDiceKeys);
 
 	std::vector<Undoverline> underlines;
 	std::vector<Undoverline> overlines;
 
+	FRAME_STATS_TIME_STAGE(undoverlineReadingMicroseconds);
 	for (const RectangleDetected &rectEncompassingLine: candidateUndoverlineRects) {
 		const Undoverline undoverline = readUndoverline(grayscaleImage, rectEncompassingLine.rotatedRect);
 
@@ -239,6 +303,8 @@ UnderlinesAndOverlines findReadableUndoverlines(
 	}
 
 	// Sort underlines and overlines on y axis
+	FRAME_STATS_COUNT(undoverlines, unsigned(underlines.size() + overlines.size()));
+
 	std::sort( underlines.begin(), underlines.end(), [](Undoverline a, Undoverline b) {return a.inferredCenterOfFace.y < b.inferredCenterOfFace.y; } );
 	std::sort( overlines.begin(), overlines.end(), [](Undoverline a, Undoverline b) {return a.inferredCenterOfFace.y < b.inferredCenterOfFace.y; } );
 
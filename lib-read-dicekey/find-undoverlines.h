@@ -4,6 +4,7 @@
 
 #include <float.h>
 #include "graphics/cv.h"
+#include "graphics/rectangle.h"
 #include "undoverline.h"
 
 struct UnderlinesAndOverlines {
@@ -11,8 +12,21 @@ struct UnderlinesAndOverlines {
 	std::vector<Undoverline> overlines;
 };
 
+/**
+ * Find the rectangles in the image shaped like undoverlines, before any are read.
+ * Only those near the modal area are kept, unless multipleDiceKeys is set, in which
+ * case those near the modal area of each group of similar area large enough to be
+ * another DiceKey (e.g., of DiceKeys further from the camera) are kept.
+ **/
+std::vector<RectangleDetected> findCandidateUndoverlines(
+	const cv::Mat &grayscaleImage,
+	int N = 13,
+	bool multipleDiceKeys = false
+);
+
 UnderlinesAndOverlines findReadableUndoverlines(
-	const cv::Mat &grayscaleImage
+	const cv::Mat &grayscaleImage,
+	bool multipleDiceKeys = false
 );
 
 Undoverline readUndoverline(
@@ -3,4 +3,4 @@
 #include "externally-generated/ocr-font.h"
 #include "externally-generated/inconsolata-700.h"
 
-inline OcrFont* getFont() { return &Inconsolata700; }
\ No newline at end of file
+inline const OcrFont* getFont() { return &Inconsolata700; }
\ No newline at end of file
@@ -0,0 +1,81 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include "frame-stats.h"
+#include "json.h"
+
+const unsigned FrameStats::MaxThresholdLevels;
+
+thread_local FrameStats *frameStatsBeingCollectedOnThisThread = nullptr;
+
+FrameStatsCollection::FrameStatsCollection(FrameStats *_stats) : stats(nullptr) {
+	if (_stats != nullptr && frameStatsBeingCollectedOnThisThread == nullptr) {
+		stats = _stats;
+		stats->reset();
+		frameStatsBeingCollectedOnThisThread = stats;
+		start = std::chrono::steady_clock::now();
+	}
+}
+
+FrameStatsCollection::~FrameStatsCollection() {
+	if (stats != nullptr) {
+		stats->totalMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		frameStatsBeingCollectedOnThisThread = nullptr;
+	}
+}
+
+static void appendMicroseconds(std::string &json, const char *key, double microseconds) {
+	jsonAppendKey(json, key);
+	jsonAppendFloat(json, float(microseconds));
+	json += ", ";
+}
+
+static void appendCount(std::string &json, const char *key, unsigned count) {
+	jsonAppendKey(json, key);
+	jsonAppendUnsigned(json, count);
+}
+
+std::string FrameStats::toJson() const {
+	std::string json;
+	appendJson(json);
+	return json;
+}
+
+void FrameStats::appendJson(std::string &json) const {
+	json += '{';
+	appendMicroseconds(json, JsonKeys::FrameStats::totalMicroseconds, totalMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::grayscaleConversionMicroseconds, grayscaleConversionMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::blurMicroseconds, blurMicroseconds);
+	jsonAppendKey(json, JsonKeys::FrameStats::thresholdLevelMicroseconds);
+	json += '[';
+	for (unsigned level = 0; level < thresholdLevels && level < MaxThresholdLevels; level++) {
+		if (level != 0) {
+			json += ',';
+		}
+		jsonAppendFloat(json, float(thresholdLevelMicroseconds[level]));
+	}
+	json += "], ";
+	appendMicroseconds(json, JsonKeys::FrameStats::contourFindingMicroseconds, contourFindingMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::candidateFilteringMicroseconds, candidateFilteringMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::overlapRemovalMicroseconds, overlapRemovalMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::undoverlineReadingMicroseconds, undoverlineReadingMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::pairingMicroseconds, pairingMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::gridFittingMicroseconds, gridFittingMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::ocrMicroseconds, ocrMicroseconds);
+	appendMicroseconds(json, JsonKeys::FrameStats::mergeMicroseconds, mergeMicroseconds);
+	appendCount(json, JsonKeys::FrameStats::contours, contours);
+	json += ", ";
+	appendCount(json, JsonKeys::FrameStats::candidateUndoverlines, candidateUndoverlines);
+	json += ", ";
+	appendCount(json, JsonKeys::FrameStats::undoverlines, undoverlines);
+	json += ", ";
+	appendCount(json, JsonKeys::FrameStats::facesFound, facesFound);
+	json += ", ";
+	appendCount(json, JsonKeys::FrameStats::strayUndoverlines, strayUndoverlines);
+	json += ", ";
+	appendCount(json, JsonKeys::FrameStats::ocrCalls, ocrCalls);
+	json += ", ";
+	appendCount(json, JsonKeys::FrameStats::ocrCacheHits, ocrCacheHits);
+	json += ", ";
+	appendCount(json, JsonKeys::FrameStats::ocrCacheMisses, ocrCacheMisses);
+	json += '}';
+}
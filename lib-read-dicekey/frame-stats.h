@@ -0,0 +1,164 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace JsonKeys {
+	namespace FrameStats {
+		const char totalMicroseconds[] = "totalMicroseconds";
+		const char grayscaleConversionMicroseconds[] = "grayscaleConversionMicroseconds";
+		const char blurMicroseconds[] = "blurMicroseconds";
+		const char thresholdLevelMicroseconds[] = "thresholdLevelMicroseconds";
+		const char contourFindingMicroseconds[] = "contourFindingMicroseconds";
+		const char candidateFilteringMicroseconds[] = "candidateFilteringMicroseconds";
+		const char overlapRemovalMicroseconds[] = "overlapRemovalMicroseconds";
+		const char undoverlineReadingMicroseconds[] = "undoverlineReadingMicroseconds";
+		const char pairingMicroseconds[] = "pairingMicroseconds";
+		const char gridFittingMicroseconds[] = "gridFittingMicroseconds";
+		const char ocrMicroseconds[] = "ocrMicroseconds";
+		const char mergeMicroseconds[] = "mergeMicroseconds";
+		const char contours[] = "contours";
+		const char candidateUndoverlines[] = "candidateUndoverlines";
+		const char undoverlines[] = "undoverlines";
+		const char facesFound[] = "facesFound";
+		const char strayUndoverlines[] = "strayUndoverlines";
+		const char ocrCalls[] = "ocrCalls";
+		const char ocrCacheHits[] = "ocrCacheHits";
+		const char ocrCacheMisses[] = "ocrCacheMisses";
+	};
+};
+
+/**
+ * Where the time went while reading one frame, and how much was found at each
+ * stage, for finding out why a frame was slow.
+ *
+ * Times are wall-clock microseconds spent in each stage on the thread reading
+ * the frame (stages that run in parallel are timed as a whole).
+ *
+ * Stats are collected only while a FrameStatsCollection is in scope, and only
+ * on its thread.  Building with DICEKEY_NO_FRAME_STATS defined removes the
+ * collection points from the library altogether.
+ **/
+struct FrameStats {
+	static const unsigned MaxThresholdLevels = 16;
+
+	double totalMicroseconds = 0;
+	double grayscaleConversionMicroseconds = 0;
+	double blurMicroseconds = 0;
+	// The time to binarize the image at each threshold level of findRectangles
+	// (level 0 is Canny edge detection), for the first thresholdLevels levels
+	double thresholdLevelMicroseconds[MaxThresholdLevels] = {};
+	unsigned thresholdLevels = 0;
+	double contourFindingMicroseconds = 0;
+	double candidateFilteringMicroseconds = 0;
+	double overlapRemovalMicroseconds = 0;
+	double undoverlineReadingMicroseconds = 0;
+	double pairingMicroseconds = 0;
+	double gridFittingMicroseconds = 0;
+	double ocrMicroseconds = 0;
+	double mergeMicroseconds = 0;
+
+	unsigned contours = 0;
+	unsigned candidateUndoverlines = 0;
+	unsigned undoverlines = 0;
+	unsigned facesFound = 0;
+	unsigned strayUndoverlines = 0;
+	unsigned ocrCalls = 0;
+	// Lookups of OCR resampling maps that were found in the cache, and that
+	// had to be computed (see getOcrResamplingMap)
+	unsigned ocrCacheHits = 0;
+	unsigned ocrCacheMisses = 0;
+
+	void reset() { *this = FrameStats(); }
+
+	/**
+	 * {"totalMicroseconds": T, ..., "thresholdLevelMicroseconds": [T, ...], ..., "contours": N, ...}
+	 * with a key for each field
+	 **/
+	std::string toJson() const;
+	void appendJson(std::string &json) const;
+};
+
+/**
+ * The stats being collected on this thread, or nullptr if none are.
+ * Inline, so that a collection point not collecting costs only a
+ * thread-local load and a branch.
+ **/
+extern thread_local FrameStats *frameStatsBeingCollectedOnThisThread;
+inline FrameStats* frameStatsBeingCollected() {
+	return frameStatsBeingCollectedOnThisThread;
+}
+
+/**
+ * Collect stats for the frame read on this thread while in scope, resetting
+ * them first and setting their totalMicroseconds when the scope ends.
+ * Passing nullptr collects nothing.  Collections nest: within one that is
+ * already collecting, another has no effect, so the outermost caller (e.g.
+ * processRGBAImage rather than the processImage it calls) owns the frame.
+ **/
+class FrameStatsCollection {
+	FrameStats *stats;
+	std::chrono::steady_clock::time_point start;
+public:
+	explicit FrameStatsCollection(FrameStats *stats);
+	~FrameStatsCollection();
+	FrameStatsCollection(const FrameStatsCollection&) = delete;
+	FrameStatsCollection& operator=(const FrameStatsCollection&) = delete;
+};
+
+/**
+ * Add the time from construction to destruction to a stage's time, if given one.
+ **/
+class FrameStatsStageTimer {
+	double *microseconds;
+	std::chrono::steady_clock::time_point start;
+public:
+	explicit FrameStatsStageTimer(double *microseconds) : microseconds(microseconds) {
+		if (microseconds != nullptr) {
+			start = std::chrono::steady_clock::now();
+		}
+	}
+	~FrameStatsStageTimer() {
+		if (microseconds != nullptr) {
+			*microseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+	FrameStatsStageTimer(const FrameStatsStageTimer&) = delete;
+	FrameStatsStageTimer& operator=(const FrameStatsStageTimer&) = delete;
+};
+
+/**
+ * Collection points, for use within the library.
+ *
+ * FRAME_STATS_TIME_STAGE(field) times the rest of the enclosing scope into the
+ * given field (which may be an array element) of the stats being collected.
+ * FRAME_STATS_COUNT(field, n) adds n to a count, and FRAME_STATS_SET(field, value)
+ * sets a field.  Each reads the stats being collected once; when there are
+ * none, each costs a thread-local load and a branch; when built with
+ * DICEKEY_NO_FRAME_STATS, nothing.
+ **/
+#ifdef DICEKEY_NO_FRAME_STATS
+#define FRAME_STATS_TIME_STAGE(field)
+#define FRAME_STATS_COUNT(field, n)
+#define FRAME_STATS_SET(field, value)
+#else
+#define FRAME_STATS_CONCATENATE_(a, b) a##b
+#define FRAME_STATS_CONCATENATE(a, b) FRAME_STATS_CONCATENATE_(a, b)
+#define FRAME_STATS_TIME_STAGE(field) \
+	FrameStats *FRAME_STATS_CONCATENATE(frameStatsToTime, __LINE__) = frameStatsBeingCollected(); \
+	FrameStatsStageTimer FRAME_STATS_CONCATENATE(frameStatsStageTimer, __LINE__)( \
+		FRAME_STATS_CONCATENATE(frameStatsToTime, __LINE__) != nullptr ? \
+			&(FRAME_STATS_CONCATENATE(frameStatsToTime, __LINE__)->field) : nullptr)
+#define FRAME_STATS_COUNT(field, n) \
+	do { \
+		FrameStats *frameStatsToCount = frameStatsBeingCollected(); \
+		if (frameStatsToCount != nullptr) { frameStatsToCount->field += (n); } \
+	} while (0)
+#define FRAME_STATS_SET(field, value) \
+	do { \
+		FrameStats *frameStatsToSet = frameStatsBeingCollected(); \
+		if (frameStatsToSet != nullptr) { frameStatsToSet->field = (value); } \
+	} while (0)
+#endif
@@ -6,6 +6,8 @@
 #include "cv.h"
 #include "rectangle.h"
 #include "find-rectangles.h"
+#include "../frame-stats.h"
+#include "../trace.h"
 
 std::vector<RectangleDetected> removeOverlappingRectangles(
 	std::vector<RectangleDetected> rectangles,
@@ -50,46 +52,57 @@ std::vector<RectangleDetected> findRectangles(
 	unsigned int N,
 	double minPerimeter
 ) {
+	TRACE_SCOPE("findRectangles");
 	std::vector<RectangleDetected> rectanglesFound;
 
 	 //cv::Mat pyr, timg, gray0(image.size(), CV_8U), gray;
 	 cv::Mat grayBlur, edges;
 
-	//cv::blur(gray, grayBlur, gray.size().width > 2048 ? cv::Size(5, 5) : cv::Size(3,3)); // was 3
-	cv::medianBlur(gray, grayBlur, 3); // was 3
+	{
+		FRAME_STATS_TIME_STAGE(blurMicroseconds);
+		//cv::blur(gray, grayBlur, gray.size().width > 2048 ? cv::Size(5, 5) : cv::Size(3,3)); // was 3
+		cv::medianBlur(gray, grayBlur, 3); // was 3
+	}
+	FRAME_STATS_SET(thresholdLevels, N < FrameStats::MaxThresholdLevels ? N : FrameStats::MaxThresholdLevels);
 
 	// try several threshold levels
 	for (unsigned int l = 0; l < N; l++)
 	{
-		// hack: use Canny instead of zero threshold level.
-		// Canny helps to catch squares with gradient shading
-		if (l == 0)
 		{
-			//float otsu_threshold = cv::threshold(
-			//	gray0, gray, 0, 4096, CV_THRESH_BINARY | CV_THRESH_OTSU
-			//);
-			//const float lower_threshold_fraction = 0.5;
+			// (Levels beyond those the stats have room for are added to the last)
+			FRAME_STATS_TIME_STAGE(thresholdLevelMicroseconds[l < FrameStats::MaxThresholdLevels ? l : FrameStats::MaxThresholdLevels - 1]);
+			// hack: use Canny instead of zero threshold level.
+			// Canny helps to catch squares with gradient shading
+			if (l == 0)
+			{
+				//float otsu_threshold = cv::threshold(
+				//	gray0, gray, 0, 4096, CV_THRESH_BINARY | CV_THRESH_OTSU
+				//);
+				//const float lower_threshold_fraction = 0.5;
 
-			// apply Canny. Take the upper threshold from slider
-			// and set the lower to 0 (which forces edges merging)
-			// Canny(gray0, gray, otsu_threshold * lower_threshold_fraction, otsu_threshold, 5);  // was 0, 50, 5 -- best so far is 250, 1000
-			Canny(grayBlur, edges, 253, 255, 5);  // was 0, 50, 5 -- best so far is 253, 255, 5
+				// apply Canny. Take the upper threshold from slider
+				// and set the lower to 0 (which forces edges merging)
+				// Canny(gray0, gray, otsu_threshold * lower_threshold_fraction, otsu_threshold, 5);  // was 0, 50, 5 -- best so far is 250, 1000
+				Canny(grayBlur, edges, 253, 255, 5);  // was 0, 50, 5 -- best so far is 253, 255, 5
 
-			// dilate canny output to remove potential
-			// holes between edge segments
-			dilate(edges, edges, cv::Mat(), cv::Point(-1, -1));
-			// cv::imwrite(path + "contours/" + filename + "-canny" + ".png", gray);
-		}
-		else
-		{
-			// apply threshold if l!=0:
-			//     tgray(x,y) = gray(x,y) < (l+1)*255/N ? 255 : 0
-			edges = gray >= (l + 1) * 255 / N;
+				// dilate canny output to remove potential
+				// holes between edge segments
+				dilate(edges, edges, cv::Mat(), cv::Point(-1, -1));
+				// cv::imwrite(path + "contours/" + filename + "-canny" + ".png", gray);
+			}
+			else
+			{
+				// apply threshold if l!=0:
+				//     tgray(x,y) = gray(x,y) < (l+1)*255/N ? 255 : 0
+				edges = gray >= (l + 1) * 255 / N;
+			}
 		}
 
+		FRAME_STATS_TIME_STAGE(contourFindingMicroseconds);
 		// find contours and store them all as a list
 		std::vector<std::vector<cv::Point>> contours;
 		cv::findContours(edges, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+		FRAME_STATS_COUNT(contours, unsigned(contours.size()));
 
 		contours = vfilter<std::vector<cv::Point>>(contours, [minPerimeter](const std::vector<cv::Point> *contour) -> bool {
 			return cv::arcLength(*contour, false) >= minPerimeter;
@@ -115,30 +115,42 @@ std::vector<uchar> samplePointsAlongLine(
 	const cv::Mat &grayscaleImage,
 	const cv::Point2f start,
 	const cv::Point2f end,
-	const std::vector<float> pointsAsFractionsOfDistanceFromStartToEnd,
+	const float *pointsAsFractionsOfDistanceFromStartToEnd,
+	size_t numberOfPoints,
 	size_t samplesPerPoint = 0) {
 	if (samplesPerPoint <= 0) {
-		samplesPerPoint = getNumberOfPixelsToSample(distance2f(start, end) / pointsAsFractionsOfDistanceFromStartToEnd.size());
+		samplesPerPoint = getNumberOfPixelsToSample(distance2f(start, end) / numberOfPoints);
 	}
 	const float deltaX = end.x - start.x;
 	const float deltaY = end.y - start.y;
 	const bool isMoreHorizontalThanVertical = abs(deltaY) < abs(deltaX);
 	const bool ifSamplingThreePointsUseThoseAboveAndBelowRatherThanThoseOnSides = isMoreHorizontalThanVertical;
-	return vmap<float, uchar>(
-		pointsAsFractionsOfDistanceFromStartToEnd,
-		[grayscaleImage, start, deltaX, deltaY, samplesPerPoint,
-		 ifSamplingThreePointsUseThoseAboveAndBelowRatherThanThoseOnSides
-		](const float* dotFraction) {
-			return samplePoint(
-				grayscaleImage,
-				cv::Point2i(
-					int(round(start.x + ((*dotFraction) * deltaX))),
-					int(round(start.y + ((*dotFraction) * deltaY)))
-				),
-				samplesPerPoint,
-				ifSamplingThreePointsUseThoseAboveAndBelowRatherThanThoseOnSides
-			);
-		}
+	std::vector<uchar> samples(numberOfPoints);
+	for (size_t i = 0; i < numberOfPoints; i++) {
+		const float dotFraction = pointsAsFractionsOfDistanceFromStartToEnd[i];
+		samples[i] = samplePoint(
+			grayscaleImage,
+			cv::Point2i(
+				int(round(start.x + (dotFraction * deltaX))),
+				int(round(start.y + (dotFraction * deltaY)))
+			),
+			samplesPerPoint,
+			ifSamplingThreePointsUseThoseAboveAndBelowRatherThanThoseOnSides
+		);
+	}
+	return samples;
+}
+
+std::vector<uchar> samplePointsAlongLine(
+	const cv::Mat &grayscaleImage,
+	const cv::Point2f start,
+	const cv::Point2f end,
+	const std::vector<float> &pointsAsFractionsOfDistanceFromStartToEnd,
+	size_t samplesPerPoint = 0) {
+	return samplePointsAlongLine(
+		grayscaleImage, start, end,
+		pointsAsFractionsOfDistanceFromStartToEnd.data(), pointsAsFractionsOfDistanceFromStartToEnd.size(),
+		samplesPerPoint
 	);
 }
 
@@ -1,20 +1,93 @@
+#include <stdio.h>
+#include <math.h>
 #include <iostream>
 #include "json.h"
 
+// Digits of a number of up to 20 digits, without the sign
+static void appendUnsigned64(std::string &json, uint64_t value) {
+	char digits[20];
+	int count = 0;
+	do {
+		digits[count++] = char('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	while (count > 0) {
+		json += digits[--count];
+	}
+}
+
+void jsonAppendFloat(std::string &json, float value) {
+	const double magnitude = fabs(double(value));
+	// For magnitudes below 10^6, scaling by 10^6 errs by less than 10^-4, so it rounds
+	// the sixth decimal place correctly unless the value is within 10^-3 of a tie.
+	// Near-ties, and larger (or non-finite) values, are rare and left to snprintf.
+	if (magnitude < 1e6) {
+		const double scaled = magnitude * 1e6;
+		const double rounded = floor(scaled + 0.5);
+		const double distanceFromTie = fabs(scaled - floor(scaled) - 0.5);
+		if (distanceFromTie > 1e-3) {
+			const uint64_t millionths = uint64_t(rounded);
+			if (signbit(value)) {
+				json += '-';
+			}
+			appendUnsigned64(json, millionths / 1000000);
+			json += '.';
+			const uint64_t fraction = millionths % 1000000;
+			for (uint64_t divisor = 100000; divisor > 0; divisor /= 10) {
+				json += char('0' + (fraction / divisor) % 10);
+			}
+			return;
+		}
+	}
+	char formatted[64];
+	const int length = snprintf(formatted, sizeof(formatted), "%f", double(value));
+	json.append(formatted, size_t(length < 0 ? 0 : length < int(sizeof(formatted)) ? length : int(sizeof(formatted)) - 1));
+}
+
+void jsonAppendUnsigned(std::string &json, unsigned int value) {
+	appendUnsigned64(json, value);
+}
+
+void jsonAppendKey(std::string &json, const char *key) {
+	json += '"';
+	json += key;
+	json += "\": ";
+}
+
+void jsonAppendQuoted(std::string &json, const char *chars, size_t length) {
+	json += '"';
+	json.append(chars, length);
+	json += '"';
+}
+
+void jsonAppendPoint(std::string &json, const cv::Point2f point) {
+	json += '{';
+	jsonAppendKey(json, JsonKeys::Point::x);
+	jsonAppendFloat(json, point.x);
+	json += ", ";
+	jsonAppendKey(json, JsonKeys::Point::y);
+	jsonAppendFloat(json, point.y);
+	json += '}';
+}
+
+void jsonAppendLine(std::string &json, const Line line) {
+	json += '{';
+	jsonAppendKey(json, JsonKeys::Line::start);
+	jsonAppendPoint(json, line.start);
+	json += ", ";
+	jsonAppendKey(json, JsonKeys::Line::end);
+	jsonAppendPoint(json, line.end);
+	json += '}';
+}
+
 std::string pointToJson(const cv::Point2f point) {
-	std::ostringstream jsonStream;
-	jsonStream << "{" <<
-		"\"" << JsonKeys::Point::x + "\": " << std::to_string(point.x) << ", " <<
-		"\"" << JsonKeys::Point::y + "\": " << std::to_string(point.y) <<
-		"}";
-	return jsonStream.str();
+	std::string json;
+	jsonAppendPoint(json, point);
+	return json;
 };
 
 std::string lineToJson(const Line line) {
-	std::ostringstream jsonStream;
-	jsonStream << "{" <<
-		"\"" << JsonKeys::Line::start + "\": " << pointToJson(line.start) << ", " <<
-		"\"" << JsonKeys::Line::end + "\": " << pointToJson(line.end) <<
-	"}";
-	return jsonStream.str();
+	std::string json;
+	jsonAppendLine(json, line);
+	return json;
 }
@@ -1,4 +1,7 @@
+#pragma once
+
 #include <iostream>
+#include <string>
 #include "graphics/cv.h"
 #include "graphics/geometry.h"
 #include "../lib-dicekey/externally-generated/dicekey-face-specification.h"
@@ -6,3 +9,18 @@
 
 std::string pointToJson(const cv::Point2f point);
 std::string lineToJson(const Line line);
+
+/*
+Functions for writing JSON by appending to a buffer, which the caller can
+reuse across calls (e.g., once per frame) so that its storage is allocated once.
+*/
+
+// Append a float exactly as std::to_string (printf's "%f") would format it
+void jsonAppendFloat(std::string &json, float value);
+void jsonAppendUnsigned(std::string &json, unsigned int value);
+// Append "\"key\": "
+void jsonAppendKey(std::string &json, const char *key);
+// Append a string in quotes (the string is not escaped)
+void jsonAppendQuoted(std::string &json, const char *chars, size_t length);
+void jsonAppendPoint(std::string &json, const cv::Point2f point);
+void jsonAppendLine(std::string &json, const Line line);
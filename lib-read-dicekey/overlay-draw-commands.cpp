@@ -0,0 +1,164 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <math.h>
+#include "graphics/geometry.h"
+#include "graphics/draw-rotated-rect.h"
+#include "json.h"
+#include "visualize-read-results.h"
+#include "write-face-characters.h"
+#include "overlay-draw-commands.h"
+
+void OverlayDrawCommands::clear() {
+	rectangles.clear();
+	glyphs.clear();
+}
+
+void OverlayDrawCommands::addFaceReadResult(
+	const FaceRead &face,
+	const UndoverlineTable &undoverlines,
+	float angleInRadiansNonCanonicalForm,
+	float pixelsPerFaceEdgeWidth
+) {
+  const float faceSizeInPixels = FaceDimensionsFractional::size * pixelsPerFaceEdgeWidth;
+  const int thinLineThickness = 1 + int(faceSizeInPixels / 70);
+  const int thickLineThickness = 2 * thinLineThickness;
+
+  const auto error = face.error();
+  const Undoverline &underline = face.underline(undoverlines);
+  const Undoverline &overline = face.overline(undoverlines);
+  const cv::Point2f center = face.center(undoverlines);
+
+  // A rectangle around the face if an error has been found
+  if (error.magnitude > 0) {
+    const OverlayRectangle faceRectangle = {
+      cv::RotatedRect(center, cv::Size2d(faceSizeInPixels, faceSizeInPixels), radiansToDegrees(angleInRadiansNonCanonicalForm)),
+      errorMagnitudeToColor(error.magnitude),
+      thickLineThickness
+    };
+    rectangles.push_back(faceRectangle);
+  }
+  // A rectangle around the underline
+  if (underline.found) {
+    const bool underlineError = (error.location & FaceErrors::Location::Underline);
+    const OverlayRectangle underlineRectangle = {
+      underline.fromRotatedRect,
+      errorMagnitudeToColor( underlineError ? error.magnitude : 0 ),
+      underlineError ? thickLineThickness : thinLineThickness
+    };
+    rectangles.push_back(underlineRectangle);
+  }
+  // A rectangle around the overline
+  if (overline.found) {
+    const bool overlineError = (error.location & FaceErrors::Location::Overline);
+    const OverlayRectangle overlineRectangle = {
+      overline.fromRotatedRect,
+      errorMagnitudeToColor( overlineError ? error.magnitude : 0 ),
+      overlineError ? thickLineThickness : thinLineThickness
+    };
+    rectangles.push_back(overlineRectangle);
+  }
+  // The characters read
+  const float angleInRadians = face.inferredAngleInRadians(undoverlines);
+  const FaceCharacterPlacement placement = placeFaceCharacters(center, angleInRadians, pixelsPerFaceEdgeWidth);
+  const OverlayGlyph letterGlyph = {
+    face.letter(), placement.letterCenter, angleInRadians, placement.charWidth, placement.charHeight,
+    errorMagnitudeToColor( (error.location & FaceErrors::Location::OcrLetter) ? error.magnitude : 0 )
+  };
+  const OverlayGlyph digitGlyph = {
+    face.digit(), placement.digitCenter, angleInRadians, placement.charWidth, placement.charHeight,
+    errorMagnitudeToColor( (error.location & FaceErrors::Location::OcrDigit) ? error.magnitude : 0 )
+  };
+  glyphs.push_back(letterGlyph);
+  glyphs.push_back(digitGlyph);
+}
+
+void OverlayDrawCommands::addReadResults(
+	const std::vector<FaceRead> &faces,
+	const UndoverlineTable &undoverlines,
+	float angleInRadiansNonCanonicalForm,
+	float pixelsPerFaceEdgeWidth
+) {
+	for (const FaceRead &face: faces) {
+		addFaceReadResult(face, undoverlines, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
+	}
+}
+
+void OverlayDrawCommands::addReadResults(
+	const DiceKey<FaceRead> &diceKey,
+	const UndoverlineTable &undoverlines,
+	float angleInRadiansNonCanonicalForm,
+	float pixelsPerFaceEdgeWidth
+) {
+	for (const FaceRead &face: diceKey.faces) {
+		addFaceReadResult(face, undoverlines, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
+	}
+}
+
+void OverlayDrawCommands::render(cv::Mat &overlayImage) const {
+	for (const OverlayRectangle &rectangle: rectangles) {
+		drawRotatedRect(overlayImage, rectangle.rect, rectangle.color.scalarRGBA, rectangle.thickness);
+	}
+	for (const OverlayGlyph &glyph: glyphs) {
+		writeCharacter(overlayImage, glyph.character, glyph.center, glyph.angleInRadians, glyph.width, glyph.height, glyph.color);
+	}
+}
+
+static void appendColorJson(std::string &json, const Color &color) {
+	json += '[';
+	jsonAppendUnsigned(json, color.r);
+	json += ", ";
+	jsonAppendUnsigned(json, color.g);
+	json += ", ";
+	jsonAppendUnsigned(json, color.b);
+	json += ']';
+}
+
+std::string OverlayDrawCommands::toJson() const {
+	std::string json;
+	appendJson(json);
+	return json;
+}
+
+void OverlayDrawCommands::appendJson(std::string &json) const {
+	json += "{\"rectangles\": [";
+	for (size_t i = 0; i < rectangles.size(); i++) {
+		const OverlayRectangle &rectangle = rectangles[i];
+		if (i != 0) {
+			json += ',';
+		}
+		json += "{\"center\": ";
+		jsonAppendPoint(json, rectangle.rect.center);
+		json += ", \"width\": ";
+		jsonAppendFloat(json, rectangle.rect.size.width);
+		json += ", \"height\": ";
+		jsonAppendFloat(json, rectangle.rect.size.height);
+		json += ", \"angleInDegrees\": ";
+		jsonAppendFloat(json, rectangle.rect.angle);
+		json += ", \"color\": ";
+		appendColorJson(json, rectangle.color);
+		json += ", \"thickness\": ";
+		jsonAppendUnsigned(json, (unsigned int) rectangle.thickness);
+		json += '}';
+	}
+	json += "], \"glyphs\": [";
+	for (size_t i = 0; i < glyphs.size(); i++) {
+		const OverlayGlyph &glyph = glyphs[i];
+		if (i != 0) {
+			json += ',';
+		}
+		json += "{\"character\": ";
+		jsonAppendQuoted(json, &glyph.character, 1);
+		json += ", \"center\": ";
+		jsonAppendPoint(json, glyph.center);
+		json += ", \"angleInRadians\": ";
+		jsonAppendFloat(json, glyph.angleInRadians);
+		json += ", \"width\": ";
+		jsonAppendFloat(json, glyph.width);
+		json += ", \"height\": ";
+		jsonAppendFloat(json, glyph.height);
+		json += ", \"color\": ";
+		appendColorJson(json, glyph.color);
+		json += '}';
+	}
+	json += "]}";
+}
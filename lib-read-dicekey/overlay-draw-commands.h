@@ -0,0 +1,85 @@
+#pragma once
+
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <string>
+#include <vector>
+#include "graphics/cv.h"
+#include "graphics/color.h"
+#include "read-faces.h"
+
+/**
+ * The outline of a rotated rectangle, drawn with lines of the given thickness
+ * (in pixels) centered on the rectangle's edges.
+ */
+struct OverlayRectangle {
+	cv::RotatedRect rect;
+	Color color;
+	int thickness;
+};
+
+/**
+ * A character of the font (a letter or digit) drawn to fill a box of the given
+ * width and height, centered at center and rotated clockwise by angleInRadians.
+ */
+struct OverlayGlyph {
+	char character;
+	cv::Point2f center;
+	float angleInRadians;
+	float width;
+	float height;
+	Color color;
+};
+
+/**
+ * The overlay that visualizeReadResults rasterizes, as a list of primitives
+ * that a client can draw itself (e.g., at the resolution of its display).
+ * Positions and sizes are in the pixels of the image the DiceKey was read from.
+ * Rectangles are drawn before glyphs.
+ */
+class OverlayDrawCommands {
+public:
+	std::vector<OverlayRectangle> rectangles;
+	std::vector<OverlayGlyph> glyphs;
+
+	// Remove all commands (keeping the storage, so it can be reused for the next frame)
+	void clear();
+
+	/**
+	 * Add the commands that draw the results of reading faces, whose
+	 * undoverlines are in the given table.
+	 */
+	void addReadResults(
+		const std::vector<FaceRead> &faces,
+		const UndoverlineTable &undoverlines,
+		float angleInRadiansNonCanonicalForm,
+		float pixelsPerFaceEdgeWidth
+	);
+	void addReadResults(
+		const DiceKey<FaceRead> &diceKey,
+		const UndoverlineTable &undoverlines,
+		float angleInRadiansNonCanonicalForm,
+		float pixelsPerFaceEdgeWidth
+	);
+
+	/**
+	 * Rasterize the commands onto a CV_8UC4 RGBA image.
+	 */
+	void render(cv::Mat &overlayImage) const;
+
+	/**
+	 * {"rectangles": [{"center": P, "width": W, "height": H, "angleInDegrees": A, "color": [R, G, B], "thickness": T}, ...],
+	 *  "glyphs": [{"character": "C", "center": P, "angleInRadians": A, "width": W, "height": H, "color": [R, G, B]}, ...]}
+	 * where each P is in the format of pointToJson.
+	 */
+	std::string toJson() const;
+	void appendJson(std::string &json) const;
+
+private:
+	void addFaceReadResult(
+		const FaceRead &face,
+		const UndoverlineTable &undoverlines,
+		float angleInRadiansNonCanonicalForm,
+		float pixelsPerFaceEdgeWidth
+	);
+};
@@ -1,17 +1,23 @@
 //  © 2019 Stuart Edward Schechter (Github: @uppajung)
 
 #include <float.h>
+#include <string.h>
 #include <chrono>
 #include <iostream>
 #include <math.h>
+#include <memory>
+#include <utility>
 
 #include "utilities/bit-operations.h"
 #include "graphics/cv.h"
 #include "graphics/rotate.h"
 #include "assemble-dicekey.hpp"
 #include "read-faces.h"
+#include "rectify-dicekey.h"
 #include "read-dicekey.hpp"
+#include "dicekey-read-binary.h"
 #include "visualize-read-results.h"
+#include "trace.h"
 #include <opencv2/imgproc/imgproc.hpp>
 
 const unsigned int maxCorrectableError = 2;
@@ -48,11 +54,24 @@ bool DiceKeyImageProcessor::processImage(
 		size_t bytesPerRow,
 		void* pointerToGrayscaleChannelByteArray
 ) {
+	TRACE_SCOPE("DiceKeyImageProcessor::processImage");
+	FrameStatsCollection frameStatsCollection(collectFrameStats ? &frameStats : nullptr);
   const cv::Mat grayscaleImage(cv::Size(width, height), CV_8UC1, pointerToGrayscaleChannelByteArray, bytesPerRow);
 
-	const ReadFaceResult facesRead = readFaces(grayscaleImage, false);
+	// Images of faces not asked for by now will never be asked for, so release
+	// the regions of earlier frames retained to capture them
+	for (auto &faceImage : faceImages) {
+		faceImage.discardPendingCapture();
+	}
+	for (auto &faceImage : previousFaceImages) {
+		faceImage.discardPendingCapture();
+	}
 
-	whenLastRead = std::chrono::system_clock::now();
+	ReadFaceResult facesRead = rectifyPerspective ?
+		readFacesWithPerspectiveRectification(grayscaleImage, false) :
+		readFaces(grayscaleImage, false);
+
+	whenLastRead = clock();
 	if (!initialized) {
 		whenFirstRead = whenLastRead;
 		whenLastImproved = whenLastRead;
@@ -66,26 +85,38 @@ bool DiceKeyImageProcessor::processImage(
 		pixelsPerFaceEdgeWidth = facesRead.pixelsPerFaceEdgeWidth;
 
 		if (diceKey.isInitialized()) {
-			// 
-			this->previousDiceKey = diceKey;
+			// The key read from the last frame becomes the previous key.
+			// Swapping the two buffers moves faces rather than copying them
+			// (the stale previous key is overwritten below).
+			std::swap(diceKey, previousDiceKey);
+			std::swap(undoverlines, previousUndoverlines);
+			std::swap(faceImages, previousFaceImages);
 		}
 
+		// Move the faces just read, and their undoverlines, into the current key
+		diceKey = DiceKey<FaceRead>(std::move(facesRead.faces));
+		undoverlines = std::move(facesRead.undoverlines);
+		faceImages = std::array<SharedImageData, NumberOfFaces>();
 		if (this->previousDiceKey.isInitialized()) {
 			// There may be useful data from the previous read to carry in,
 			// as it could have read something this read missed.
 			// Merge the old into the new
-			diceKey = DiceKey<FaceRead>(facesRead.faces).mergePrevious(this->previousDiceKey);
+			{
+				FRAME_STATS_TIME_STAGE(mergeMicroseconds);
+				mergePreviousDiceKey();
+			}
 			if (diceKey.totalError() > this->previousDiceKey.totalError()) {
 				//The new read reduces the magnitude of the read errors to resolve
 				whenLastImproved = whenLastRead;
 			}
 		} else {
 			// This is the first time that a set of faces has been read
-			diceKey = DiceKey<FaceRead>(facesRead.faces);
 			whenLastImproved = whenLastRead;
 		}
 	} else {
 		diceKey = DiceKey<FaceRead>();
+		undoverlines.clear();
+		faceImages = std::array<SharedImageData, NumberOfFaces>();
 	}
 
 	// The process of repeatedly processing camera images should stop when either
@@ -107,33 +138,124 @@ bool DiceKeyImageProcessor::processImage(
 	return terminate;
 }
 
+void DiceKeyImageProcessor::mergePreviousDiceKey() {
+	// Copy the undoverlines of the previous faces to the end of this frame's table,
+	// so that any face merged in refers to an entry past those read this frame
+	const size_t undoverlinesReadThisFrame = undoverlines.size();
+	DiceKey<FaceRead> previous = previousDiceKey;
+	for (auto &face : previous.faces) {
+		face = face.withUndoverlinesCopiedTo(undoverlines, previousUndoverlines);
+	}
+	diceKey.mergePreviousInPlace(previous);
+
+	// Carry in the image of each face taken from the previous key
+	const auto isFromPreviousKey = [undoverlinesReadThisFrame](unsigned char index) {
+		return index != UndoverlineTable::NoIndex && index >= undoverlinesReadThisFrame;
+	};
+	for (size_t i = 0; i < NumberOfFaces; i++) {
+		const FaceRead &face = diceKey.faces[i];
+		if (!isFromPreviousKey(face.underlineIndex()) && !isFromPreviousKey(face.overlineIndex())) {
+			continue;
+		}
+		for (size_t j = 0; j < NumberOfFaces; j++) {
+			if (
+				previous.faces[j].underlineIndex() == face.underlineIndex() &&
+				previous.faces[j].overlineIndex() == face.overlineIndex()
+			) {
+				faceImages[i] = previousFaceImages[j];
+				break;
+			}
+		}
+	}
+}
+
 bool DiceKeyImageProcessor::processRGBAImage (
 		int width,
 		int height,
 		const uint32_t* pointerToRGBAByteArray
 ) {
+	TRACE_SCOPE("DiceKeyImageProcessor::processRGBAImage");
+	// Stats are collected here, rather than by processImage, so that they include
+	// the conversion to grayscale
+	FrameStatsCollection frameStatsCollection(collectFrameStats ? &frameStats : nullptr);
 	// Create an OpenCV Matrix (Mat) representation of the RGBA data input
 	const cv::Mat colorImage(cv::Size(width, height), CV_8UC4, (void*) pointerToRGBAByteArray, 4 * size_t(width));
 	// Create a grayscale matrix for the analysis
 	cv::Mat grayscale(width, height, CV_8UC1);
-	// Convert the RGBA image into a grayscale image
-	cv::cvtColor(colorImage, grayscale, cv::COLOR_RGBA2GRAY);
+	{
+		FRAME_STATS_TIME_STAGE(grayscaleConversionMicroseconds);
+		// Convert the RGBA image into a grayscale image
+		cv::cvtColor(colorImage, grayscale, cv::COLOR_RGBA2GRAY);
+	}
 	// Process the grayscale image.
 	bool processImageResult = processImage(width, height, grayscale.step, grayscale.data);
 
-	for (auto &face : this->diceKey.faces) {
-		if (face.errorSize() > 0 && face.imageData.size() == 0) {
-			// We need to capture an error image
-			const int faceSize = size_t(face.inferredSizeInPixels());
-			if (faceSize > 0) {
-				face.imageData.resize(faceSize * faceSize * 4);
-				const cv::Mat faceImage(cv::Size(faceSize, faceSize), CV_8UC4, (void*) face.imageData.data());
-				copyRotatedRectangle(faceImage, colorImage, face.center(), face.inferredAngleInRadians() * float(180.0F) / float(M_PI) );
-			}
+	retainImagesOfFacesWithErrors(colorImage);
+
+	return processImageResult;
+}
+
+/**
+ * A copy of the part of a frame that holds the faces that need images,
+ * scaled by the given factor, which faces capture their images from if asked.
+ **/
+struct RetainedFrameRegion {
+	cv::Mat image;
+	// The position of the region within the frame
+	cv::Point2f origin;
+	float scale;
+};
+
+void DiceKeyImageProcessor::retainImagesOfFacesWithErrors(const cv::Mat &colorImage) {
+	// Find the region of the frame covering each face with an error and no image
+	// (allowing for the face to be rotated, and for interpolation at its edges)
+	cv::Rect regionNeeded;
+	float largestFaceSize = 0;
+	for (size_t i = 0; i < NumberOfFaces; i++) {
+		const FaceRead &face = this->diceKey.faces[i];
+		const float faceSize = float(int(face.inferredSizeInPixels(undoverlines)));
+		if (face.errorSize() > 0 && !faceImages[i].hasImage() && faceSize > 0) {
+			const float halfExtent = faceSize * float(M_SQRT1_2) + 2;
+			const cv::Point2f center = face.center(undoverlines);
+			const cv::Rect faceRegion(
+				cv::Point(int(floor(center.x - halfExtent)), int(floor(center.y - halfExtent))),
+				cv::Point(int(ceil(center.x + halfExtent)), int(ceil(center.y + halfExtent)))
+			);
+			regionNeeded = regionNeeded.area() == 0 ? faceRegion : (regionNeeded | faceRegion);
+			largestFaceSize = MAX(largestFaceSize, faceSize);
 		}
 	}
+	regionNeeded &= cv::Rect(0, 0, colorImage.cols, colorImage.rows);
+	if (regionNeeded.area() == 0) {
+		return;
+	}
 
-	return processImageResult;
+	// Copy that region (the caller's buffer won't outlive this call), downscaling it
+	// if needed so that no face's image will exceed the maximum size.
+	std::shared_ptr<RetainedFrameRegion> region = std::make_shared<RetainedFrameRegion>();
+	region->origin = cv::Point2f(float(regionNeeded.x), float(regionNeeded.y));
+	region->scale = (maxFaceImageSizeInPixels > 0 && largestFaceSize > float(maxFaceImageSizeInPixels)) ?
+		float(maxFaceImageSizeInPixels) / largestFaceSize : 1.0f;
+	if (region->scale < 1.0f) {
+		cv::resize(colorImage(regionNeeded), region->image, cv::Size(), region->scale, region->scale, cv::INTER_AREA);
+	} else {
+		colorImage(regionNeeded).copyTo(region->image);
+	}
+
+	for (size_t i = 0; i < NumberOfFaces; i++) {
+		const FaceRead &face = this->diceKey.faces[i];
+		const float faceSize = float(int(face.inferredSizeInPixels(undoverlines)));
+		if (face.errorSize() > 0 && !faceImages[i].hasImage() && faceSize > 0) {
+			const int imageSize = MAX(1, int(faceSize * region->scale));
+			const cv::Point2f centerInRegion = (face.center(undoverlines) - region->origin) * region->scale;
+			const float angleInDegrees = face.inferredAngleInRadians(undoverlines) * float(180.0F) / float(M_PI);
+			faceImages[i].captureLater([region, imageSize, centerInRegion, angleInDegrees](std::vector<unsigned char> &imageData) {
+				imageData.resize(size_t(imageSize) * size_t(imageSize) * 4);
+				const cv::Mat faceImage(cv::Size(imageSize, imageSize), CV_8UC4, (void*) imageData.data());
+				copyRotatedRectangle(faceImage, region->image, centerInRegion, angleInDegrees);
+			});
+		}
+	}
 }
 
 static std::vector<unsigned char> nullVector;
@@ -141,10 +263,10 @@ static std::vector<unsigned char> nullVector;
 const std::vector<unsigned char>& DiceKeyImageProcessor::getImageOfFace(
 	size_t faceIndex
 ) const {	
-	if (faceIndex < 0 || faceIndex > diceKey.faces.size()) {
+	if (faceIndex >= faceImages.size()) {
 		return nullVector;
 	} else {
-		return this->diceKey.faces[faceIndex].imageData;
+		return this->faceImages[faceIndex].get();
 	}
 }
 
@@ -165,16 +287,35 @@ void DiceKeyImageProcessor::renderAugmentationOverlay(
 		const int width,
 		const int height,
 		uint32_t* rgbaArrayPtr
-) const {
-	// Make all pixels transparent
-	uint32_t* pixelPtr = rgbaArrayPtr; 
-	uint32_t* end = pixelPtr + ((size_t) width) * ((size_t) height);
-	while (pixelPtr < end) {
-		// 100% transparent (black with opacity 0)
-		(*pixelPtr++) = 0;
+) {
+	TRACE_SCOPE("DiceKeyImageProcessor::renderAugmentationOverlay");
+	const cv::Rect overlayRect(0, 0, width, height);
+	overlayCommands.clear();
+	if (diceKey.isInitialized()) {
+		overlayCommands.addReadResults(diceKey, undoverlines, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
+	}
+	const cv::Rect drawnRect = boundsOfOverlayDrawCommands(overlayCommands) & overlayRect;
+	// Unless this is the buffer we last drew into, with nothing drawn since but what
+	// we drew, the entire buffer must be cleared
+	const bool sameBuffer = rgbaArrayPtr == overlayBuffer && width == overlayWidth && height == overlayHeight;
+	const cv::Rect rectToClear = sameBuffer ? overlayDrawnRect : overlayRect;
+	overlayDirtyRect = rectToClear.area() == 0 ? drawnRect :
+		drawnRect.area() == 0 ? rectToClear :
+		(rectToClear | drawnRect);
+
+	// Make the pixels of the dirty region transparent (black with opacity 0)
+	for (int y = overlayDirtyRect.y; y < overlayDirtyRect.y + overlayDirtyRect.height; y++) {
+		uint32_t* rowPtr = rgbaArrayPtr + ((size_t) y) * ((size_t) width) + overlayDirtyRect.x;
+		memset(rowPtr, 0, ((size_t) overlayDirtyRect.width) * sizeof(uint32_t));
 	}
-	// Then augment the transparent image with the rendering of DiceKeys
-	augmentRGBAImage(width, height, rgbaArrayPtr);
+	// Then draw the DiceKey onto the transparent image
+	cv::Mat overlayImage_RGBA_CV(cv::Size(width, height), CV_8UC4, rgbaArrayPtr);
+	overlayCommands.render(overlayImage_RGBA_CV);
+
+	overlayBuffer = rgbaArrayPtr;
+	overlayWidth = width;
+	overlayHeight = height;
+	overlayDrawnRect = drawnRect;
 }
 
 void DiceKeyImageProcessor::augmentRGBAImage(	
@@ -182,12 +323,14 @@ void DiceKeyImageProcessor::augmentRGBAImage(
 		const int height,
 		uint32_t* rgbaArrayPtr
 ) const {
+	TRACE_SCOPE("DiceKeyImageProcessor::augmentRGBAImage");
 	// Make all pixels transparent
-	if (diceKey.isInitialized() && diceKey.faces.size() == NumberOfFaces) {
+	if (diceKey.isInitialized()) {
 		cv::Mat overlayImage_RGBA_CV(cv::Size(width, height), CV_8UC4, rgbaArrayPtr);
 		visualizeReadResults(
 			overlayImage_RGBA_CV,
-			diceKey.faces,
+			diceKey,
+			undoverlines,
 			angleInRadiansNonCanonicalForm,
 			pixelsPerFaceEdgeWidth
 		);
@@ -196,9 +339,69 @@ void DiceKeyImageProcessor::augmentRGBAImage(
 
 
 std::string DiceKeyImageProcessor::jsonDiceKeyRead() const {
-	return diceKey.toJson();
+	std::string json;
+	writeJsonDiceKeyRead(json);
+	return json;
+}
+
+void DiceKeyImageProcessor::writeJsonDiceKeyRead(std::string &json) const {
+	// Keep the buffer's storage (if reused), and reserve enough for a typical key
+	// so that appending rarely needs to reallocate.
+	json.clear();
+	json.reserve(NumberOfFaces * 512);
+	appendJsonDiceKeyRead(json, diceKey, undoverlines);
 }
 
 bool DiceKeyImageProcessor::isFinished() const {
 	return terminate;
-}
\ No newline at end of file
+}
+
+void DiceKeyImageProcessor::writeOverlayDrawCommands(OverlayDrawCommands &commands) const {
+	commands.clear();
+	if (diceKey.isInitialized()) {
+		commands.addReadResults(diceKey, undoverlines, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
+	}
+}
+
+std::string DiceKeyImageProcessor::jsonOverlayDrawCommands() const {
+	OverlayDrawCommands commands;
+	writeOverlayDrawCommands(commands);
+	return commands.toJson();
+}
+
+void DiceKeyImageProcessor::writeBinaryDiceKeyRead(std::vector<unsigned char> &binary) const {
+	::writeBinaryDiceKeyRead(diceKey, undoverlines, binary);
+}
+
+const DiceKeyReadDelta& DiceKeyImageProcessor::diceKeyReadDelta() {
+	deltaTracker.delta(diceKey, undoverlines, delta);
+	return delta;
+}
+
+std::string DiceKeyImageProcessor::jsonDiceKeyReadDelta() {
+	return diceKeyReadDelta().toJson();
+}
+
+std::vector<DiceKeyReadFromImage> readDiceKeys(
+	const cv::Mat &grayscaleImage,
+	bool outputOcrErrors,
+	FrameStats *frameStats
+) {
+	TRACE_SCOPE("readDiceKeys");
+	FrameStatsCollection frameStatsCollection(frameStats);
+	const auto orderedFacesOfEachDiceKey = orderFacesOfEachDiceKeyAndInferMissingUndoverlines(
+		grayscaleImage, findFacesAndStrayUndoverlinesOfEachDiceKey(grayscaleImage)
+	);
+	std::vector<DiceKeyReadFromImage> diceKeysRead;
+	for (const auto &orderedFaces : orderedFacesOfEachDiceKey) {
+		ReadFaceResult facesRead = readOrderedFaces(grayscaleImage, orderedFaces, outputOcrErrors);
+		diceKeysRead.push_back({
+			DiceKey<FaceRead>(std::move(facesRead.faces)),
+			std::move(facesRead.undoverlines),
+			orderedFaces.bounds,
+			facesRead.angleInRadiansNonCanonicalForm,
+			facesRead.pixelsPerFaceEdgeWidth
+		});
+	}
+	return diceKeysRead;
+}
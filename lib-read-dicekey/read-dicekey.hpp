@@ -2,13 +2,19 @@
 
 //  © 2019 Stuart Edward Schechter (Github: @uppajung)
 
+#include <array>
 #include <string>
 #include <vector>
 #include <limits>
 #include <chrono>
+#include <functional>
 
 #include "assemble-dicekey.hpp"
 #include "read-faces.h"
+#include "dicekey-read-delta.h"
+#include "overlay-draw-commands.h"
+#include "frame-stats.h"
+#include "utilities/shared-image-data.h"
 
 // std::string readDiceKeyJson(
 // 	const cv::Mat &grayscaleImage
@@ -24,6 +30,12 @@
 static const std::chrono::time_point<std::chrono::system_clock> minTimePoint =
 	std::chrono::time_point<std::chrono::system_clock>::min();
 
+/**
+ * A source of the current time, which decides when DiceKeyImageProcessor
+ * stops trying to remove correctable errors.
+ **/
+typedef std::function<std::chrono::time_point<std::chrono::system_clock>()> DiceKeyImageProcessorClock;
+
 /**
  * This structure is used as the second parameter to scanAndAugmentDiceKeyImage,
  * and is used both to input the result of the prior call and to return results
@@ -45,16 +57,93 @@ private:
 	std::chrono::time_point<std::chrono::system_clock> whenLastImproved = minTimePoint;
 	// The value is set every time scanAndAugmentDiceKeyImage is called.
 	std::chrono::time_point<std::chrono::system_clock> whenLastRead = minTimePoint;
+	// The clock that gives the time at which each image is read
+	DiceKeyImageProcessorClock clock = std::chrono::system_clock::now;
 	// The DiceKey that has been read is stored in this field, which also
 	// keeps track of any errors that you have to be resolved during reading.
 	DiceKey<FaceRead> diceKey = DiceKey<FaceRead>();
+	// The undoverlines of the faces of diceKey
+	UndoverlineTable undoverlines;
+	// An RGBA image of each face of diceKey, captured only for faces read with errors.
+	// The image of a face carried in from the previous key is shared, not copied.
+	std::array<SharedImageData, NumberOfFaces> faceImages;
+	// The DiceKey read from the prior frame, with its undoverlines and face images.
+	// They are swapped, not copied, with those of diceKey between frames.
 	DiceKey<FaceRead> previousDiceKey = DiceKey<FaceRead>();
+	UndoverlineTable previousUndoverlines;
+	std::array<SharedImageData, NumberOfFaces> previousFaceImages;
 	// This field is set to true if we've reached the termination condition
 	// for the scanning loop.  This is the same value returned as the
 	// result of the scanAndAugmentDiceKeyImage function.
 	bool terminate = false;
+	// When true, each frame's DiceKey is warped into a fronto-parallel image
+	// before its faces are read (see readFacesWithPerspectiveRectification)
+	bool rectifyPerspective = false;
+	// The maximum width (and height) of the image of a face, or 0 for no limit
+	int maxFaceImageSizeInPixels = 0;
+	// The faces last reported by diceKeyReadDelta, and that delta's storage
+	DiceKeyReadDeltaTracker deltaTracker;
+	DiceKeyReadDelta delta;
+	// The overlay buffer last rendered by renderAugmentationOverlay, the region
+	// drawn into it, and the region of it changed by that call
+	const uint32_t* overlayBuffer = nullptr;
+	int overlayWidth = 0;
+	int overlayHeight = 0;
+	cv::Rect overlayDrawnRect;
+	cv::Rect overlayDirtyRect;
+	// The storage for the commands that draw the overlay, reused between frames
+	OverlayDrawCommands overlayCommands;
+	// The time spent in, and counts from, each stage of reading the last image,
+	// if collecting them
+	bool collectFrameStats = false;
+	FrameStats frameStats;
+
+	// Retain the part of the frame needed to capture images of faces read with
+	// errors, deferring the capture of each image until it is asked for.
+	void retainImagesOfFacesWithErrors(const cv::Mat &colorImage);
+
+	// Merge the previous key into the key just read (see DiceKey::mergePreviousInPlace),
+	// carrying in the undoverlines and images of the faces taken from it.
+	void mergePreviousDiceKey();
 
 public:
+	/**
+	 * @brief Enable or disable correcting perspective tilt by warping
+	 * the DiceKey into a canonical, fronto-parallel image before reading
+	 * the faces.  Disabled by default.
+	 */
+	void setPerspectiveRectification(bool enabled) { rectifyPerspective = enabled; }
+
+	/**
+	 * @brief Limit the width (and height) of the images of faces returned
+	 * by getImageOfFace, bounding the memory used to keep them.  Faces larger
+	 * than the limit are scaled down.  A limit of 0 (the default) means no limit.
+	 */
+	void setMaxFaceImageSize(int maxPixels) { maxFaceImageSizeInPixels = maxPixels; }
+
+	/**
+	 * @brief Replace the clock that gives the time at which each image is read
+	 * (std::chrono::system_clock::now by default), e.g., with a simulated clock
+	 * that advances one frame period per image, so that replaying recorded frames
+	 * terminates after the same frames however long each takes to process.
+	 */
+	void setClock(DiceKeyImageProcessorClock _clock) { clock = _clock; }
+
+	/**
+	 * @brief Enable or disable collecting the time spent in, and counts from,
+	 * each stage of reading each image (see FrameStats).  Disabled by default,
+	 * in which case collection costs a thread-local load and a branch per
+	 * stage, and nothing at all if the library is built with
+	 * DICEKEY_NO_FRAME_STATS.
+	 */
+	void setFrameStatsCollection(bool enabled) { collectFrameStats = enabled; }
+
+	/**
+	 * @brief The stats collected while processing the last image, if collection
+	 * is enabled.  The reference remains valid until the next image is processed.
+	 */
+	const FrameStats& frameStatsOfLastImage() const { return frameStats; }
+
 	/**
 	 * @brief Search for DiceKeys in an RGBA image
 	 * 
@@ -71,6 +160,17 @@ public:
 	);
 
 
+	/**
+	 * @brief Return the square RGBA image of a face read with errors
+	 * (by processRGBAImage), or an empty vector if there is none.  The image
+	 * is captured from the frame the first time it is asked for.
+	 * The reference remains valid until the next image is processed.
+	 *
+	 * Only images asked for before the next image is processed are kept:
+	 * processing an image releases the regions of earlier frames retained to
+	 * capture the rest.  An image once captured stays with its face as the
+	 * face is carried into later keys.
+	 */
 	const std::vector<unsigned char>& getImageOfFace(
 		size_t faceIndex
 	) const;
@@ -84,17 +184,37 @@ public:
 
 	/**
 	 * @brief Render a translucent overlay to display what the algorithm
-	 * has been able to read.  (the entire buffer is overwritten)
+	 * has been able to read.
+	 * 
+	 * When given the same buffer (and dimensions) as the previous call, only the
+	 * region drawn by the previous call is cleared, as the rest of the buffer is
+	 * assumed to be transparent still; the region changed is reported by
+	 * getOverlayDirtyRect.  Otherwise, the entire buffer is overwritten.
+	 * Call invalidateOverlay if the buffer was modified between calls.
 	 * 
 	 * @param width the width of the overlay to create
 	 * @param height the height of the overlay to create
-	 * @param rgbaArrayPtr an RGBA data buffer to entirely overwrite
+	 * @param rgbaArrayPtr an RGBA data buffer to overwrite
 	 */
 	void renderAugmentationOverlay(	
 		int width,
 		int height,
 		uint32_t* rgbaArrayPtr
-	) const ;
+	);
+
+	/**
+	 * @brief The region of the overlay buffer changed by the last call to
+	 * renderAugmentationOverlay (the union of the regions drawn by that call
+	 * and the call before), so that only that region need be uploaded or
+	 * composited.  Empty if nothing changed.
+	 */
+	const cv::Rect& getOverlayDirtyRect() const { return overlayDirtyRect; }
+
+	/**
+	 * @brief Make the next call to renderAugmentationOverlay overwrite its
+	 * entire buffer.
+	 */
+	void invalidateOverlay() { overlayBuffer = nullptr; }
 
 	/**
 	 * @brief Render a representation of what the algorithm
@@ -111,11 +231,34 @@ public:
 	) const; 
 
 	/**
-	 * @brief Return a 
+	 * @brief Write the overlay (see renderAugmentationOverlay) as a list of
+	 * primitives, rotated rectangles and glyphs, for a client to draw itself
+	 * at the resolution of its display.  Replaces the contents of commands,
+	 * which callers can reuse between frames.
+	 */
+	void writeOverlayDrawCommands(OverlayDrawCommands &commands) const;
+
+	/**
+	 * @brief Return the JSON representation of the overlay's draw commands
+	 * (see OverlayDrawCommands::toJson).
+	 */
+	std::string jsonOverlayDrawCommands() const;
+
+	/**
+	 * @brief Return the DiceKey read so far, without copying it.
+	 * The reference remains valid until the next image is processed;
+	 * copy it to keep it longer.
 	 * 
-	 * @return DiceKey<FaceRead> 
+	 * @return const DiceKey<FaceRead>& 
 	 */
-	DiceKey<FaceRead> diceKeyRead() const { return diceKey; }
+	const DiceKey<FaceRead>& diceKeyRead() const { return diceKey; }
+
+	/**
+	 * @brief Return the table of the undoverlines of the faces of diceKeyRead(),
+	 * which is needed for their geometry (e.g., FaceRead::center).
+	 * The reference remains valid until the next image is processed.
+	 */
+	const UndoverlineTable& undoverlinesRead() const { return undoverlines; }
 
 	/**
 	 * @brief Return a JSON representation of the DiceKey read.
@@ -124,10 +267,81 @@ public:
 	 **/
 	std::string jsonDiceKeyRead() const;
 
+	/**
+	 * @brief Write the JSON representation of the DiceKey read (see jsonDiceKeyRead)
+	 * into a buffer, replacing its contents.  Callers that serialize every frame
+	 * can pass the same buffer each time so that its storage is reused.
+	 **/
+	void writeJsonDiceKeyRead(std::string &json) const;
+
+	/**
+	 * @brief Write the DiceKey read in its binary form (see dicekey-read-binary.h)
+	 * into a buffer, replacing its contents.  The binary form is cheaper to
+	 * write and read than JSON, for consumers in the same process or reading
+	 * through shared memory.
+	 **/
+	void writeBinaryDiceKeyRead(std::vector<unsigned char> &binary) const;
+
+	/**
+	 * @brief Return only the faces that have changed (in letter, digit,
+	 * orientation, or error, or whose centers have moved beyond a threshold)
+	 * since the last call, along with a sequence number (see DiceKeyReadDelta).
+	 * The first call, and the first after a key is lost or the delta is reset,
+	 * returns every face.
+	 * The reference remains valid until the next call.
+	 **/
+	const DiceKeyReadDelta& diceKeyReadDelta();
+
+	/**
+	 * @brief Return the JSON representation of diceKeyReadDelta()
+	 **/
+	std::string jsonDiceKeyReadDelta();
+
+	/**
+	 * @brief Make the next delta contain every face, as when a consumer
+	 * has missed a delta or is just starting.
+	 **/
+	void resetDiceKeyReadDelta() { deltaTracker.reset(); }
+
+	/**
+	 * @brief Set how many pixels a face's center must move before the face
+	 * is included in a delta.  Defaults to 1.
+	 **/
+	void setDeltaPositionThreshold(float pixels) { deltaTracker.setPositionThreshold(pixels); }
+
 	bool isFinished() const;
 
 };
 
+/**
+ * One of the DiceKeys read from an image that may contain several, with the
+ * box bounding its 5x5 grid of faces within the image (from which the
+ * DiceKey's box can be cropped with bounds.boundingRect()).
+ **/
+struct DiceKeyReadFromImage {
+	DiceKey<FaceRead> diceKey;
+	// The undoverlines of the faces of diceKey
+	UndoverlineTable undoverlines;
+	cv::RotatedRect bounds;
+	float angleInRadiansNonCanonicalForm;
+	float pixelsPerFaceEdgeWidth;
+};
+
+/**
+ * Read every DiceKey in a grayscale image, as when several boxes are in view
+ * of the camera at once.  A single pass finds the undoverlines of all the keys,
+ * which are then grouped into keys by their size, angle, and proximity, and
+ * each key is fit to its own grid and read.  Keys are read from the image as
+ * is (without perspective rectification) and from one image only, so nothing
+ * is merged from previous images as DiceKeyImageProcessor does.
+ * If given frameStats, fill them as readFaces does, summed over all the keys.
+ **/
+std::vector<DiceKeyReadFromImage> readDiceKeys(
+	const cv::Mat &grayscaleImage,
+	bool outputOcrErrors = false,
+	FrameStats *frameStats = nullptr
+);
+
 
 
 // https://developer.android.com/reference/android/graphics/ImageFormat.html#YUV_420_888
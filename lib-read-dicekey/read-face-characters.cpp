@@ -9,36 +9,25 @@
 #include "simple-ocr.h"
 #include "read-face-characters.h"
 
-CharactersReadFromFaces readCharactersOnFace(
-	const cv::Mat& grayscaleImage,
-	cv::Point2f faceCenter,
-	float angleRadians,
-	float pixelsPerFaceEdgeWidth,
-	unsigned char whiteBlackThreshold,
-	std::string writeErrorUnlessThisLetterIsRead,
-	std::string writeErrorUnlessThisDigitIsRead
-) {
-	// Rotate to remove the angle of the face
-	const float degreesToRotateToRemoveAngleOfFace = radiansToDegrees(angleRadians);
+const uchar valueRepresentingBlack = 255;
+
+cv::Size textRegionSizeForFace(float pixelsPerFaceEdgeWidth) {
 	const int textHeightPixels = int(ceil(FaceDimensionsFractional::textRegionHeight * pixelsPerFaceEdgeWidth));
 	int textWidthPixels = int(ceil(FaceDimensionsFractional::textRegionWidth * pixelsPerFaceEdgeWidth));
 	// Use an even text region width so we can even split it in two at the center;
 	if ((textWidthPixels % 2) == 1) {
 		textWidthPixels += 1;
 	}
-	cv::Size textRegionSize = cv::Size(textWidthPixels, textHeightPixels);
-	cv::Mat textEdges;
-	const uchar valueRepresentingBlack = 255;
-
-	const auto textImage = copyRotatedRectangle(grayscaleImage, faceCenter, degreesToRotateToRemoveAngleOfFace, textRegionSize);
-	// Previously, we blurred image before thresholding.  It may make sense to do that
-	// again when we get back images from real faces, so leaving this code here.
-	// cv::Mat textBlurred
-	// cv::medianBlur(textImage, textBlurred, 3);
-	// cv::threshold(textBlurred, textEdges, whiteBlackThreshold, valueRepresentingBlack, cv::THRESH_BINARY);
-	// at which point we'd remove the line below
-	cv::threshold(textImage, textEdges, whiteBlackThreshold, valueRepresentingBlack, cv::THRESH_BINARY);
+	return cv::Size(textWidthPixels, textHeightPixels);
+}
 
+CharactersReadFromFaces readCharactersFromTextRegion(
+	const cv::Mat& textEdges,
+	float pixelsPerFaceEdgeWidth,
+	std::string writeErrorUnlessThisLetterIsRead,
+	std::string writeErrorUnlessThisDigitIsRead
+) {
+	const cv::Size textRegionSize = textEdges.size();
 	// Setup a rectangle to define your region of interest
 	int charWidth = int((textRegionSize.width - round(FaceDimensionsFractional::spaceBetweenLetterAndDigit * pixelsPerFaceEdgeWidth)) / 2);
 	const cv::Rect letterRect(0, 0, charWidth, textRegionSize.height);
@@ -79,3 +68,92 @@ CharactersReadFromFaces readCharactersOnFace(
 
 	return { lettersMostLikelyFirst, digitsMostLikelyFirst };
 }
+
+CharactersReadFromFaces readCharactersOnFace(
+	const cv::Mat& grayscaleImage,
+	cv::Point2f faceCenter,
+	float angleRadians,
+	float pixelsPerFaceEdgeWidth,
+	unsigned char whiteBlackThreshold,
+	std::string writeErrorUnlessThisLetterIsRead,
+	std::string writeErrorUnlessThisDigitIsRead
+) {
+	// Rotate to remove the angle of the face
+	const float degreesToRotateToRemoveAngleOfFace = radiansToDegrees(angleRadians);
+	const cv::Size textRegionSize = textRegionSizeForFace(pixelsPerFaceEdgeWidth);
+	cv::Mat textEdges;
+
+	const auto textImage = copyRotatedRectangle(grayscaleImage, faceCenter, degreesToRotateToRemoveAngleOfFace, textRegionSize);
+	// Previously, we blurred image before thresholding.  It may make sense to do that
+	// again when we get back images from real faces, so leaving this code here.
+	// cv::Mat textBlurred
+	// cv::medianBlur(textImage, textBlurred, 3);
+	// cv::threshold(textBlurred, textEdges, whiteBlackThreshold, valueRepresentingBlack, cv::THRESH_BINARY);
+	// at which point we'd remove the line below
+	cv::threshold(textImage, textEdges, whiteBlackThreshold, valueRepresentingBlack, cv::THRESH_BINARY);
+
+	return readCharactersFromTextRegion(textEdges, pixelsPerFaceEdgeWidth,
+		writeErrorUnlessThisLetterIsRead, writeErrorUnlessThisDigitIsRead);
+}
+
+
+void TextRegionAtlas::prepare(float pixelsPerFaceEdgeWidth) {
+	const cv::Size newTextRegionSize = textRegionSizeForFace(pixelsPerFaceEdgeWidth);
+	if (newTextRegionSize != textRegionSize || atlas.empty()) {
+		textRegionSize = newTextRegionSize;
+		const cv::Size atlasSize(textRegionSize.width, textRegionSize.height * numberOfSlots);
+		// Buffers are only reallocated when the size of faces changes,
+		// which is rare from one frame to the next.
+		mapX.create(atlasSize, CV_32FC1);
+		mapY.create(atlasSize, CV_32FC1);
+		atlas.create(atlasSize, CV_8UC1);
+	}
+	for (int slot = 0; slot < numberOfSlots; slot++) {
+		clearSlot(slot);
+	}
+}
+
+void TextRegionAtlas::setSlot(int slotIndex, cv::Point2f faceCenter, float angleRadians) {
+	// Map each pixel of the slot back to the image the same way copyRotatedRectangle
+	// does, such that the slot's center maps to the face's center and the slot is
+	// rotated to remove the angle of the face.
+	const float cosAngle = cos(angleRadians);
+	const float sinAngle = sin(angleRadians);
+	const float halfWidth = textRegionSize.width / 2.0f;
+	const float halfHeight = textRegionSize.height / 2.0f;
+	const int firstRow = slotIndex * textRegionSize.height;
+	for (int y = 0; y < textRegionSize.height; y++) {
+		float* mapXRow = mapX.ptr<float>(firstRow + y);
+		float* mapYRow = mapY.ptr<float>(firstRow + y);
+		const float dy = y - halfHeight;
+		for (int x = 0; x < textRegionSize.width; x++) {
+			const float dx = x - halfWidth;
+			mapXRow[x] = faceCenter.x + cosAngle * dx - sinAngle * dy;
+			mapYRow[x] = faceCenter.y + sinAngle * dx + cosAngle * dy;
+		}
+	}
+}
+
+void TextRegionAtlas::clearSlot(int slotIndex) {
+	// Coordinates outside the image are filled with the border value
+	const cv::Rect slotRect = slotRectangle(slotIndex);
+	mapX(slotRect).setTo(cv::Scalar(-1));
+	mapY(slotRect).setTo(cv::Scalar(-1));
+}
+
+void TextRegionAtlas::extract(const cv::Mat &grayscaleImage) {
+	cv::remap(grayscaleImage, atlas, mapX, mapY, cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar());
+}
+
+void TextRegionAtlas::binarize(int slotIndex, unsigned char whiteBlackThreshold) {
+	cv::Mat slotImage = atlas(slotRectangle(slotIndex));
+	cv::threshold(slotImage, slotImage, whiteBlackThreshold, valueRepresentingBlack, cv::THRESH_BINARY);
+}
+
+cv::Rect TextRegionAtlas::slotRectangle(int slotIndex) const {
+	return cv::Rect(0, slotIndex * textRegionSize.height, textRegionSize.width, textRegionSize.height);
+}
+
+cv::Mat TextRegionAtlas::slot(int slotIndex) const {
+	return atlas(slotRectangle(slotIndex));
+}
@@ -11,6 +11,12 @@ struct CharactersReadFromFaces {
 	const OcrResult digitsMostLikelyFirst;
 };
 
+/**
+ * The size of the region containing a face's letter and digit, with an
+ * even width so that it can be split evenly at the center.
+ **/
+cv::Size textRegionSizeForFace(float pixelsPerFaceEdgeWidth);
+
 CharactersReadFromFaces readCharactersOnFace(
 	const cv::Mat& grayscaleImage,
 	cv::Point2f faceCenter,
@@ -20,3 +26,75 @@ CharactersReadFromFaces readCharactersOnFace(
 	std::string writeErrorUnlessThisLetterIsRead = "",
 	std::string writeErrorUnlessThisDigitIsRead = ""
 );
+
+/**
+ * Read the letter and digit from a text region that has already been
+ * de-rotated and binarized (black pixels having value 0).
+ **/
+CharactersReadFromFaces readCharactersFromTextRegion(
+	const cv::Mat& textEdges,
+	float pixelsPerFaceEdgeWidth,
+	std::string writeErrorUnlessThisLetterIsRead = "",
+	std::string writeErrorUnlessThisDigitIsRead = ""
+);
+
+/**
+ * A reusable image holding the text regions of all 25 faces, one slot per face,
+ * stacked vertically so that each slot occupies a contiguous block of rows.
+ *
+ * Rather than copying each face's text region with its own warpAffine
+ * (allocating a new image for each face and another when thresholding),
+ * the atlas builds maps for every slot and extracts them all with a
+ * single call to cv::remap, then binarizes each slot in place.
+ *
+ * Usage, per frame:
+ *   atlas.prepare(pixelsPerFaceEdgeWidth);
+ *   atlas.setSlot(i, faceCenter, angleRadians);   // for each face to read
+ *   atlas.extract(grayscaleImage);
+ *   atlas.binarize(i, whiteBlackThreshold);       // for each face to read
+ *   readCharactersFromTextRegion(atlas.slot(i), pixelsPerFaceEdgeWidth);
+ **/
+class TextRegionAtlas {
+public:
+	static const int numberOfSlots = 25;
+
+	cv::Size textRegionSize = cv::Size(0, 0);
+	// The image coordinates from which each pixel of the atlas is sampled
+	cv::Mat mapX;
+	cv::Mat mapY;
+	// The text regions extracted from the image
+	cv::Mat atlas;
+
+	/**
+	 * Size the atlas for faces of the given size, reusing the existing
+	 * buffers when the size has not changed, and clear all slots.
+	 **/
+	void prepare(float pixelsPerFaceEdgeWidth);
+
+	/**
+	 * Configure a slot to sample the text region of a face.
+	 **/
+	void setSlot(int slotIndex, cv::Point2f faceCenter, float angleRadians);
+
+	/**
+	 * Configure a slot not to sample from the image (it will be black).
+	 **/
+	void clearSlot(int slotIndex);
+
+	/**
+	 * Extract the text regions of all slots from the image in one pass.
+	 **/
+	void extract(const cv::Mat &grayscaleImage);
+
+	/**
+	 * Threshold a single slot, in place, to black and white.
+	 **/
+	void binarize(int slotIndex, unsigned char whiteBlackThreshold);
+
+	cv::Rect slotRectangle(int slotIndex) const;
+
+	/**
+	 * The image within a slot (sharing memory with the atlas).
+	 **/
+	cv::Mat slot(int slotIndex) const;
+};
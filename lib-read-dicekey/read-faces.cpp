@@ -4,10 +4,12 @@
 #include <chrono>
 #include <iostream>
 #include <math.h>
+#include <utility>
 
 #include "utilities/vfunctional.h"
 #include "utilities/statistics.h"
 #include "utilities/bit-operations.h"
+#include "../lib-dicekey/thread-pool.hpp"
 #include "graphics/cv.h"
 #include "graphics/geometry.h"
 #include "simple-ocr.h"
@@ -18,19 +20,68 @@
 #include "read-face-characters.h"
 #include "visualize-read-results.h"
 #include "json.h"
+#include "frame-stats.h"
+#include "trace.h"
 
-ReadFaceResult readFaces(
+// The indexes at which readOrderedFaces adds the underline and overline of each face to its table
+static unsigned char underlineIndexOfFace(size_t faceIndex) { return (unsigned char)(2 * faceIndex); }
+static unsigned char overlineIndexOfFace(size_t faceIndex) { return (unsigned char)(2 * faceIndex + 1); }
+
+ReadFaceResult readOrderedFaces(
 	const cv::Mat &grayscaleImage,
+	const FacesOrderedWithMissingFacesInferredFromUnderlines &orderedFacesResult,
 	bool outputOcrErrors
 ) {
-	FaceAndStrayUndoverlinesFound faceAndStrayUndoverlinesFound = findFacesAndStrayUndoverlines(grayscaleImage);
-	const auto orderedFacesResult = orderFacesAndInferMissingUndoverlines(grayscaleImage, faceAndStrayUndoverlinesFound);
-	std::vector<FaceRead> orderedFaces;
+	TRACE_SCOPE("readOrderedFaces");
+	// The text regions of all faces are extracted into an atlas that is reused
+	// from one frame to the next (by each thread that reads faces).
+	static thread_local TextRegionAtlas textRegionAtlas;
+	FRAME_STATS_TIME_STAGE(ocrMicroseconds);
+
 	const float angleOfDiceKeyInRadiansNonCanonicalForm = orderedFacesResult.angleInRadiansNonCanonicalForm;
+	const float pixelsPerFaceEdgeWidth = orderedFacesResult.pixelsPerFaceEdgeWidth;
 
-	for (auto &face : orderedFacesResult.orderedFaces) {
+	// Determine the location and angle of each face's text region, then extract
+	// all of the regions in a single pass over the image.
+	unsigned numberOfFacesToRead = 0;
+	if (orderedFacesResult.valid) {
+		textRegionAtlas.prepare(pixelsPerFaceEdgeWidth);
+		for (size_t faceIndex = 0; faceIndex < orderedFacesResult.orderedFaces.size(); faceIndex++) {
+			const auto &face = orderedFacesResult.orderedFaces[faceIndex];
+			if (face.underline.determinedIfUnderlineOrOverline || face.overline.determinedIfUnderlineOrOverline) {
+				textRegionAtlas.setSlot(int(faceIndex), face.center(), face.inferredAngleInRadians());
+				numberOfFacesToRead++;
+			}
+		}
+		textRegionAtlas.extract(grayscaleImage);
+	}
+	// One call to read the letter, and one the digit, of each face
+	FRAME_STATS_COUNT(ocrCalls, 2 * numberOfFacesToRead);
+
+	// Each face is read independently, and in parallel, into its own slot of the
+	// result so that the order of faces does not depend on the order reads complete.
+	// (The atlas is referenced explicitly, since within other threads the name
+	// textRegionAtlas refers to their own thread_local instance.)
+	TextRegionAtlas &atlas = textRegionAtlas;
+	const std::vector<FaceUndoverlines> &facesToRead = orderedFacesResult.orderedFaces;
+	std::vector<FaceRead> orderedFaces(facesToRead.size());
+	// The undoverlines of each face are added to the table before the faces are read,
+	// so that the threads reading faces need only read from it.
+	UndoverlineTable undoverlines;
+	for (const FaceUndoverlines &face : facesToRead) {
+		undoverlines.add(face.underline);
+		undoverlines.add(face.overline);
+	}
+	// Lookups of OCR resampling maps are made by the threads reading faces,
+	// so are counted into counts they share, and added to this frame's stats after.
+	OcrResamplingCacheCounts ocrCacheCounts;
+	OcrResamplingCacheCounts *ocrCacheCountsIfCollecting = frameStatsBeingCollected() != nullptr ? &ocrCacheCounts : nullptr;
+	parallelFor(facesToRead.size(), [&](size_t faceIndex) {
+		TRACE_SCOPE("readFace");
+		OcrResamplingCacheCounting ocrCacheCounting(ocrCacheCountsIfCollecting);
+		const auto &face = facesToRead[faceIndex];
 		if (!(face.underline.determinedIfUnderlineOrOverline || face.overline.determinedIfUnderlineOrOverline)) {
-			orderedFaces.push_back(FaceRead(face, '?', "", ""));
+			orderedFaces[faceIndex] = FaceRead(undoverlines, underlineIndexOfFace(faceIndex), overlineIndexOfFace(faceIndex), '?', noOcrCandidates(), noOcrCandidates());
 			// Without an overline or underline to orient the face, we can't read it.
 		} else {
 			// The threshold between black pixels and white pixels is calculated as the average (mean)
@@ -44,30 +95,45 @@ ReadFaceResult readFaces(
 				face.overline.whiteBlackThreshold;
 			const FaceSpecification& underlineInferred = *face.underline.faceInferred;
 			const FaceSpecification& overlineInferred = *face.overline.faceInferred;
-			const CharactersReadFromFaces charsRead = readCharactersOnFace(grayscaleImage, face.center(), face.inferredAngleInRadians(),
-				faceAndStrayUndoverlinesFound.pixelsPerFaceEdgeWidth, whiteBlackThreshold,
+			atlas.binarize(int(faceIndex), whiteBlackThreshold);
+			const CharactersReadFromFaces charsRead = readCharactersFromTextRegion(
+				atlas.slot(int(faceIndex)), pixelsPerFaceEdgeWidth,
 				outputOcrErrors ? ("" + std::string(1, dashIfNull(underlineInferred.letter)) + std::string(1, dashIfNull(overlineInferred.letter))) : "",
 				outputOcrErrors ? ("" + std::string(1, dashIfNull(underlineInferred.digit)) + std::string(1, dashIfNull(overlineInferred.digit))) : ""
 			);
 
-
 			const float orientationInRadians = face.inferredAngleInRadians() - angleOfDiceKeyInRadiansNonCanonicalForm;
 			const float orientationInClockwiseRotationsFloat = orientationInRadians * float(4.0 / (2.0 * M_PI));
 			const uchar orientationInClockwiseRotationsFromUpright = uchar(round(orientationInClockwiseRotationsFloat) + 4) % 4;
-			orderedFaces.push_back(FaceRead(
-				face,
+			orderedFaces[faceIndex] = FaceRead(
+				undoverlines, underlineIndexOfFace(faceIndex), overlineIndexOfFace(faceIndex),
 				orientationInClockwiseRotationsFromUpright,
-				std::string(1, charsRead.lettersMostLikelyFirst[0].character) + std::string(1, charsRead.lettersMostLikelyFirst[1].character),
-				std::string(1, charsRead.digitsMostLikelyFirst[0].character) + std::string(1, charsRead.digitsMostLikelyFirst[1].character)
-			));
+				ocrCandidatesFromOcrResult(charsRead.lettersMostLikelyFirst),
+				ocrCandidatesFromOcrResult(charsRead.digitsMostLikelyFirst)
+			);
 		}
-	}
+	});
+	FRAME_STATS_COUNT(ocrCacheHits, ocrCacheCounts.hits.load());
+	FRAME_STATS_COUNT(ocrCacheMisses, ocrCacheCounts.misses.load());
 
 	return {
 		orderedFacesResult.valid,
-		orderedFaces,
+		std::move(orderedFaces),
+		std::move(undoverlines),
 		orderedFacesResult.angleInRadiansNonCanonicalForm,
 		orderedFacesResult.pixelsPerFaceEdgeWidth //,
 //		{}
 	};
 }
+
+ReadFaceResult readFaces(
+	const cv::Mat &grayscaleImage,
+	bool outputOcrErrors,
+	FrameStats *frameStats
+) {
+	TRACE_SCOPE("readFaces");
+	FrameStatsCollection frameStatsCollection(frameStats);
+	FaceAndStrayUndoverlinesFound faceAndStrayUndoverlinesFound = findFacesAndStrayUndoverlines(grayscaleImage);
+	const auto orderedFacesResult = orderFacesAndInferMissingUndoverlines(grayscaleImage, faceAndStrayUndoverlinesFound);
+	return readOrderedFaces(grayscaleImage, orderedFacesResult, outputOcrErrors);
+}
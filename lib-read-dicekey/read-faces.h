@@ -10,18 +10,39 @@
 #include "undoverline.h"
 #include "face-read.h"
 #include "simple-ocr.h"
+#include "frame-stats.h"
+
+class FacesOrderedWithMissingFacesInferredFromUnderlines;
 
 struct ReadFaceResult {
 //	public:
 	bool success;
 	std::vector<FaceRead> faces;
+	// The undoverlines of the faces, which refer to them by index
+	UndoverlineTable undoverlines;
 	float angleInRadiansNonCanonicalForm;
 	float pixelsPerFaceEdgeWidth;
 	std::vector<FaceRead> strayFaces;
 //	std::vector<Undoverline> strayUndoverlines;
 };
 
+/**
+ * Find and read the faces of a DiceKey in an image.  If given frameStats,
+ * fill them with the time spent in, and the counts from, each stage
+ * (unless they are being collected by a caller already; see FrameStatsCollection).
+ **/
 ReadFaceResult readFaces(
 	const cv::Mat &grayscaleImage,
+	bool outputOcrErrors = false,
+	FrameStats *frameStats = nullptr
+);
+
+/**
+ * Read the letters and digits of faces that have already been found and
+ * placed into their positions within the 5x5 grid.
+ **/
+ReadFaceResult readOrderedFaces(
+	const cv::Mat &grayscaleImage,
+	const FacesOrderedWithMissingFacesInferredFromUnderlines &orderedFacesResult,
 	bool outputOcrErrors = false
 );
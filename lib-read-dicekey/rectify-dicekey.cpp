@@ -0,0 +1,368 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <float.h>
+#include <math.h>
+#include "utilities/statistics.h"
+#include "graphics/cv.h"
+#include "graphics/geometry.h"
+#include "../lib-dicekey/externally-generated/dicekey-face-specification.h"
+#include "find-faces.h"
+#include "assemble-dicekey.hpp"
+#include "read-faces.h"
+#include "rectify-dicekey.h"
+
+// Correspondences that the fitted homography maps further than this fraction
+// of a face's width from where they belong are discarded, and the homography refit.
+const float maxFractionOfFaceFromFittedPosition = 0.1f;
+// Each undoverline contributes two correspondences, and we require at least
+// four undoverlines so that no small cluster of faces determines the fit.
+const size_t minCorrespondencesToRectify = 8;
+
+static void multiply3x3(const double a[3][3], const double b[3][3], double result[3][3]) {
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			result[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c];
+		}
+	}
+}
+
+cv::Point2f Homography::apply(const cv::Point2f &point) const {
+	const double w = h[2][0] * point.x + h[2][1] * point.y + h[2][2];
+	return cv::Point2f(
+		float((h[0][0] * point.x + h[0][1] * point.y + h[0][2]) / w),
+		float((h[1][0] * point.x + h[1][1] * point.y + h[1][2]) / w)
+	);
+}
+
+Line Homography::apply(const Line &line) const {
+	return { apply(line.start), apply(line.end) };
+}
+
+cv::RotatedRect Homography::apply(const cv::RotatedRect &rect) const {
+	// The projection of a rectangle is a quadrilateral, which we approximate
+	// with the rectangle having the same center and mean edge lengths.
+	// Corners are in the order bottomLeft, topLeft, topRight, bottomRight.
+	cv::Point2f corners[4];
+	rect.points(corners);
+	for (int i = 0; i < 4; i++) {
+		corners[i] = apply(corners[i]);
+	}
+	const float width = (distance2f(corners[1], corners[2]) + distance2f(corners[0], corners[3])) / 2;
+	const float height = (distance2f(corners[0], corners[1]) + distance2f(corners[3], corners[2])) / 2;
+	const float angleInDegrees = angleOfLineInSignedDegrees2f(
+		midpoint2f(corners[0], corners[1]), midpoint2f(corners[3], corners[2])
+	);
+	return cv::RotatedRect(apply(rect.center), cv::Size2f(width, height), angleInDegrees);
+}
+
+Homography Homography::inverse() const {
+	// The inverse is the adjugate divided by the determinant
+	Homography result;
+	const double determinant =
+		h[0][0] * (h[1][1] * h[2][2] - h[1][2] * h[2][1]) -
+		h[0][1] * (h[1][0] * h[2][2] - h[1][2] * h[2][0]) +
+		h[0][2] * (h[1][0] * h[2][1] - h[1][1] * h[2][0]);
+	result.h[0][0] = (h[1][1] * h[2][2] - h[1][2] * h[2][1]) / determinant;
+	result.h[0][1] = (h[0][2] * h[2][1] - h[0][1] * h[2][2]) / determinant;
+	result.h[0][2] = (h[0][1] * h[1][2] - h[0][2] * h[1][1]) / determinant;
+	result.h[1][0] = (h[1][2] * h[2][0] - h[1][0] * h[2][2]) / determinant;
+	result.h[1][1] = (h[0][0] * h[2][2] - h[0][2] * h[2][0]) / determinant;
+	result.h[1][2] = (h[0][2] * h[1][0] - h[0][0] * h[1][2]) / determinant;
+	result.h[2][0] = (h[1][0] * h[2][1] - h[1][1] * h[2][0]) / determinant;
+	result.h[2][1] = (h[0][1] * h[2][0] - h[0][0] * h[2][1]) / determinant;
+	result.h[2][2] = (h[0][0] * h[1][1] - h[0][1] * h[1][0]) / determinant;
+	return result;
+}
+
+cv::Mat Homography::toMat() const {
+	cv::Mat result(3, 3, CV_64FC1);
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			result.at<double>(r, c) = h[r][c];
+		}
+	}
+	return result;
+}
+
+/*
+Calculate the similarity transform that moves the centroid of the points to the origin
+and scales them to have a mean distance of sqrt(2) from it, which keeps the least-squares
+system used to fit the homography well conditioned.
+*/
+static Homography normalizingTransform(const std::vector<cv::Point2f> &points) {
+	double meanX = 0, meanY = 0;
+	for (const auto &p : points) {
+		meanX += p.x;
+		meanY += p.y;
+	}
+	meanX /= points.size();
+	meanY /= points.size();
+	double meanDistance = 0;
+	for (const auto &p : points) {
+		meanDistance += sqrt((p.x - meanX) * (p.x - meanX) + (p.y - meanY) * (p.y - meanY));
+	}
+	meanDistance /= points.size();
+	const double scale = meanDistance > 0 ? sqrt(2.0) / meanDistance : 1;
+	Homography result;
+	result.h[0][0] = scale;
+	result.h[0][2] = -scale * meanX;
+	result.h[1][1] = scale;
+	result.h[1][2] = -scale * meanY;
+	return result;
+}
+
+Homography Homography::fit(
+	const std::vector<cv::Point2f> &sourcePoints,
+	const std::vector<cv::Point2f> &destinationPoints
+) {
+	const Homography normalizeSource = normalizingTransform(sourcePoints);
+	const Homography normalizeDestination = normalizingTransform(destinationPoints);
+	const int n = int(sourcePoints.size());
+
+	// With h[2][2] fixed at 1, each correspondence (x, y) -> (u, v) yields two
+	// equations linear in the remaining eight elements of the homography:
+	//   h00 x + h01 y + h02 - h20 x u - h21 y u = u
+	//   h10 x + h11 y + h12 - h20 x v - h21 y v = v
+	cv::Mat a(2 * n, 8, CV_64FC1, cv::Scalar(0));
+	cv::Mat b(2 * n, 1, CV_64FC1);
+	for (int i = 0; i < n; i++) {
+		const cv::Point2f source = normalizeSource.apply(sourcePoints[i]);
+		const cv::Point2f destination = normalizeDestination.apply(destinationPoints[i]);
+		const double x = source.x, y = source.y, u = destination.x, v = destination.y;
+		double* uRow = a.ptr<double>(2 * i);
+		double* vRow = a.ptr<double>(2 * i + 1);
+		uRow[0] = x; uRow[1] = y; uRow[2] = 1; uRow[6] = -x * u; uRow[7] = -y * u;
+		vRow[3] = x; vRow[4] = y; vRow[5] = 1; vRow[6] = -x * v; vRow[7] = -y * v;
+		b.at<double>(2 * i) = u;
+		b.at<double>(2 * i + 1) = v;
+	}
+	cv::Mat solution;
+	cv::solve(a, b, solution, cv::DECOMP_SVD);
+
+	Homography normalized;
+	for (int i = 0; i < 8; i++) {
+		normalized.h[i / 3][i % 3] = solution.at<double>(i);
+	}
+	normalized.h[2][2] = 1;
+
+	// Undo the normalization: H = inverse(normalizeDestination) * normalized * normalizeSource
+	double partial[3][3];
+	Homography result;
+	multiply3x3(normalized.h, normalizeSource.h, partial);
+	multiply3x3(normalizeDestination.inverse().h, partial, result.h);
+	return result;
+}
+
+/*
+Estimate the width of a face, in pixels, from the lengths of its undoverlines,
+or return 0 if neither undoverline was read.
+*/
+static float faceEdgeLengthInPixels(const FaceUndoverlines &face) {
+	float totalLength = 0;
+	int numberOfLines = 0;
+	for (const Undoverline* undoverline : { &face.underline, &face.overline }) {
+		if (undoverline->found && undoverline->determinedIfUnderlineOrOverline) {
+			totalLength += lineLength(undoverline->line);
+			numberOfLines++;
+		}
+	}
+	return numberOfLines == 0 ? 0 : (totalLength / numberOfLines) / FaceDimensionsFractional::undoverlineLength;
+}
+
+PerspectiveRectification estimatePerspectiveRectification(
+	const FacesOrderedWithMissingFacesInferredFromUnderlines &orderedFacesResult,
+	float rectifiedPixelsPerFaceEdgeWidth
+) {
+	PerspectiveRectification result;
+	const std::vector<FaceUndoverlines> &faces = orderedFacesResult.orderedFaces;
+	if (!orderedFacesResult.valid || faces.size() != NumberOfFaces) {
+		return result;
+	}
+
+	// Measure the distance between the centers of adjacent faces as a multiple
+	// of the width of a face, comparing each face only to its neighbors so that
+	// perspective (which changes both distances and widths) cancels out.
+	std::vector<float> faceSpacingsInFaceWidths;
+	for (int faceIndex = 0; faceIndex < NumberOfFaces; faceIndex++) {
+		const int column = faceIndex % 5;
+		const int row = faceIndex / 5;
+		const float width = faceEdgeLengthInPixels(faces[faceIndex]);
+		if (width <= 0) {
+			continue;
+		}
+		for (int neighborIndex : { column < 4 ? faceIndex + 1 : -1, row < 4 ? faceIndex + 5 : -1 }) {
+			if (neighborIndex < 0) {
+				continue;
+			}
+			const float neighborWidth = faceEdgeLengthInPixels(faces[neighborIndex]);
+			if (neighborWidth > 0) {
+				faceSpacingsInFaceWidths.push_back(
+					distance2f(faces[faceIndex].center(), faces[neighborIndex].center()) / ((width + neighborWidth) / 2)
+				);
+			}
+		}
+	}
+	if (faceSpacingsInFaceWidths.size() == 0) {
+		return result;
+	}
+	const float pixelsBetweenFaceCenters = medianInPlace(faceSpacingsInFaceWidths) * rectifiedPixelsPerFaceEdgeWidth;
+	// Leave a border of one face spacing around the centers of the outer faces so that
+	// the outer faces, and the space around them, are within the rectified image.
+	const float firstFaceCenterOffset = pixelsBetweenFaceCenters;
+	const int rectifiedEdgeLength = int(ceil(6 * pixelsBetweenFaceCenters));
+
+	// Find where the endpoints of each undoverline belong in the rectified image
+	const float halfUndoverlineLength = rectifiedPixelsPerFaceEdgeWidth * FaceDimensionsFractional::undoverlineLength / 2;
+	const float undoverlineDistanceFromCenter = rectifiedPixelsPerFaceEdgeWidth * FaceDimensionsFractional::centerOfUndoverlineToCenterOfFace;
+	std::vector<cv::Point2f> imagePoints, rectifiedPoints;
+	for (int faceIndex = 0; faceIndex < NumberOfFaces; faceIndex++) {
+		const FaceUndoverlines &face = faces[faceIndex];
+		const cv::Point2f rectifiedCenter(
+			firstFaceCenterOffset + (faceIndex % 5) * pixelsBetweenFaceCenters,
+			firstFaceCenterOffset + (faceIndex / 5) * pixelsBetweenFaceCenters
+		);
+		// In the rectified image, a face is rotated by the same number of clockwise
+		// quarter turns that it is rotated relative to the DiceKey in the image.
+		const float orientationInRadians = face.inferredAngleInRadians() - orderedFacesResult.angleInRadiansNonCanonicalForm;
+		const int clockwiseQuarterTurns = int(round(orientationInRadians * float(4.0 / (2.0 * M_PI))) + 4) % 4;
+		const float cosAngle = cos(float(clockwiseQuarterTurns * NinetyDegreesAsRadians));
+		const float sinAngle = sin(float(clockwiseQuarterTurns * NinetyDegreesAsRadians));
+		for (const Undoverline* undoverline : { &face.underline, &face.overline }) {
+			if (!undoverline->found || !undoverline->determinedIfUnderlineOrOverline) {
+				continue;
+			}
+			// Undoverline lines run from the letter (left) side of the face to the digit (right) side.
+			// Relative to the center of an upright face, the underline is below and the overline above.
+			const float offsetY = undoverline->isOverline ? -undoverlineDistanceFromCenter : undoverlineDistanceFromCenter;
+			for (const float offsetX : { -halfUndoverlineLength, halfUndoverlineLength }) {
+				rectifiedPoints.push_back(cv::Point2f(
+					rectifiedCenter.x + offsetX * cosAngle - offsetY * sinAngle,
+					rectifiedCenter.y + offsetX * sinAngle + offsetY * cosAngle
+				));
+			}
+			imagePoints.push_back(undoverline->line.start);
+			imagePoints.push_back(undoverline->line.end);
+		}
+	}
+	if (imagePoints.size() < minCorrespondencesToRectify) {
+		return result;
+	}
+
+	Homography imageToRectified = Homography::fit(imagePoints, rectifiedPoints);
+	// Discard any undoverlines that don't fit (e.g., were mis-assigned to a grid position)
+	// and refit to those that remain.
+	const float maxPixelsFromFittedPosition = maxFractionOfFaceFromFittedPosition * rectifiedPixelsPerFaceEdgeWidth;
+	std::vector<cv::Point2f> imagePointsThatFit, rectifiedPointsThatFit;
+	for (size_t i = 0; i + 1 < imagePoints.size(); i += 2) {
+		if (
+			distance2f(imageToRectified.apply(imagePoints[i]), rectifiedPoints[i]) <= maxPixelsFromFittedPosition &&
+			distance2f(imageToRectified.apply(imagePoints[i + 1]), rectifiedPoints[i + 1]) <= maxPixelsFromFittedPosition
+		) {
+			imagePointsThatFit.push_back(imagePoints[i]);
+			imagePointsThatFit.push_back(imagePoints[i + 1]);
+			rectifiedPointsThatFit.push_back(rectifiedPoints[i]);
+			rectifiedPointsThatFit.push_back(rectifiedPoints[i + 1]);
+		}
+	}
+	if (imagePointsThatFit.size() < minCorrespondencesToRectify) {
+		return result;
+	}
+	if (imagePointsThatFit.size() < imagePoints.size()) {
+		imageToRectified = Homography::fit(imagePointsThatFit, rectifiedPointsThatFit);
+	}
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			if (!std::isfinite(imageToRectified.h[r][c])) {
+				return result;
+			}
+		}
+	}
+
+	result.valid = true;
+	result.imageToRectified = imageToRectified;
+	result.rectifiedToImage = imageToRectified.inverse();
+	result.rectifiedImageSize = cv::Size(rectifiedEdgeLength, rectifiedEdgeLength);
+	return result;
+}
+
+static Undoverline mapUndoverline(const Undoverline &undoverline, const Homography &homography) {
+	if (!undoverline.found) {
+		return undoverline;
+	}
+	Undoverline result(undoverline);
+	result.fromRotatedRect = homography.apply(undoverline.fromRotatedRect);
+	result.line = homography.apply(undoverline.line);
+	result.center = homography.apply(undoverline.center);
+	result.inferredCenterOfFace = homography.apply(undoverline.inferredCenterOfFace);
+	result.inferredOpposingUndoverlineCenter = homography.apply(undoverline.inferredOpposingUndoverlineCenter);
+	result.inferredOpposingUndoverlineRotatedRect = homography.apply(undoverline.inferredOpposingUndoverlineRotatedRect);
+	return result;
+}
+
+/*
+Read an undoverline again from the rectified image, at the position to which the
+homography maps it.  If it can't be read there as the same kind of line, the
+undoverline read from the original image is used (with its geometry mapped).
+*/
+static Undoverline rereadUndoverline(
+	const cv::Mat &rectifiedImage,
+	const Undoverline &undoverline,
+	const Homography &imageToRectified
+) {
+	const Undoverline mappedUndoverline = mapUndoverline(undoverline, imageToRectified);
+	if (!undoverline.found) {
+		return mappedUndoverline;
+	}
+	const Undoverline reread = readUndoverline(rectifiedImage, mappedUndoverline.fromRotatedRect);
+	return (reread.found && reread.determinedIfUnderlineOrOverline &&
+		(!undoverline.determinedIfUnderlineOrOverline || reread.isOverline == undoverline.isOverline)) ?
+		reread : mappedUndoverline;
+}
+
+ReadFaceResult readFacesWithPerspectiveRectification(
+	const cv::Mat &grayscaleImage,
+	bool outputOcrErrors,
+	float rectifiedPixelsPerFaceEdgeWidth
+) {
+	// The rectified image is reused from one frame to the next (by each thread that reads faces).
+	static thread_local cv::Mat rectifiedImage;
+
+	// Find the faces and the grid in the original image, which provides the
+	// undoverlines from which to estimate the perspective.
+	FaceAndStrayUndoverlinesFound faceAndStrayUndoverlinesFound = findFacesAndStrayUndoverlines(grayscaleImage);
+	const auto orderedFacesResult = orderFacesAndInferMissingUndoverlines(grayscaleImage, faceAndStrayUndoverlinesFound);
+	const PerspectiveRectification rectification =
+		estimatePerspectiveRectification(orderedFacesResult, rectifiedPixelsPerFaceEdgeWidth);
+	if (!rectification.valid) {
+		return readOrderedFaces(grayscaleImage, orderedFacesResult, outputOcrErrors);
+	}
+
+	cv::warpPerspective(grayscaleImage, rectifiedImage, rectification.imageToRectified.toMat(),
+		rectification.rectifiedImageSize, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+
+	// The faces are already ordered, so rather than search the rectified image for them,
+	// read each face's undoverlines where the homography places them.  The grid is
+	// upright in the rectified image, and each face has the width it was rectified to.
+	std::vector<FaceUndoverlines> rectifiedFaces;
+	for (const FaceUndoverlines &face : orderedFacesResult.orderedFaces) {
+		rectifiedFaces.push_back(FaceUndoverlines(
+			rereadUndoverline(rectifiedImage, face.underline, rectification.imageToRectified),
+			rereadUndoverline(rectifiedImage, face.overline, rectification.imageToRectified)
+		));
+	}
+	const FacesOrderedWithMissingFacesInferredFromUnderlines rectifiedOrderedFaces(
+		rectifiedFaces,
+		0,
+		rectifiedPixelsPerFaceEdgeWidth,
+		rectification.imageToRectified.apply(orderedFacesResult.bounds)
+	);
+	ReadFaceResult facesRead = readOrderedFaces(rectifiedImage, rectifiedOrderedFaces, outputOcrErrors);
+
+	// Map the geometry of the faces back into the coordinates of the original image
+	for (Undoverline &undoverline : facesRead.undoverlines) {
+		undoverline = mapUndoverline(undoverline, rectification.rectifiedToImage);
+	}
+	facesRead.angleInRadiansNonCanonicalForm = orderedFacesResult.angleInRadiansNonCanonicalForm;
+	facesRead.pixelsPerFaceEdgeWidth = orderedFacesResult.pixelsPerFaceEdgeWidth;
+	return facesRead;
+}
@@ -0,0 +1,80 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <vector>
+#include "graphics/cv.h"
+#include "assemble-dicekey.hpp"
+#include "read-faces.h"
+
+/**
+ * The size, in pixels, of each face edge within the rectified image of a DiceKey.
+ * Large enough for the undoverline dots and OCR, small enough that reading the
+ * rectified image costs the same regardless of the resolution of the camera.
+ **/
+const float defaultRectifiedPixelsPerFaceEdgeWidth = 48.0f;
+
+/**
+ * A 3x3 projective transformation (homography) between two image planes.
+ **/
+class Homography {
+public:
+	double h[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+	cv::Point2f apply(const cv::Point2f &point) const;
+	Line apply(const Line &line) const;
+	cv::RotatedRect apply(const cv::RotatedRect &rect) const;
+
+	Homography inverse() const;
+
+	// A 3x3 CV_64FC1 matrix, as consumed by cv::warpPerspective
+	cv::Mat toMat() const;
+
+	/**
+	 * Estimate the homography mapping each source point to its destination point
+	 * by (normalized) linear least squares.  Requires at least four points.
+	 **/
+	static Homography fit(
+		const std::vector<cv::Point2f> &sourcePoints,
+		const std::vector<cv::Point2f> &destinationPoints
+	);
+};
+
+/**
+ * A mapping between the image a DiceKey was found in and a canonical image
+ * in which the DiceKey's grid of faces is upright, square, and fronto-parallel,
+ * with each face having the same size.
+ **/
+struct PerspectiveRectification {
+	bool valid = false;
+	Homography imageToRectified;
+	Homography rectifiedToImage;
+	cv::Size rectifiedImageSize = cv::Size(0, 0);
+};
+
+/**
+ * Estimate a homography from the endpoints of the undoverlines of faces that
+ * have been placed into the grid to their positions in the canonical image.
+ * (Each face's orientation determines where its underline and overline lie.)
+ **/
+PerspectiveRectification estimatePerspectiveRectification(
+	const FacesOrderedWithMissingFacesInferredFromUnderlines &orderedFacesResult,
+	float rectifiedPixelsPerFaceEdgeWidth = defaultRectifiedPixelsPerFaceEdgeWidth
+);
+
+/**
+ * Read faces as readFaces does, but rather than sample each face from the
+ * original image, warp the DiceKey once into a canonical fronto-parallel image
+ * and read the undoverlines (at the positions the faces found in the original
+ * image map to) and characters from that image.  This corrects for
+ * perspective tilt, which the affine grid model cannot represent.
+ *
+ * The geometry of the faces returned is mapped back into the coordinates of
+ * the original image.  If rectification is not possible, the faces are read
+ * from the original image.
+ **/
+ReadFaceResult readFacesWithPerspectiveRectification(
+	const cv::Mat &grayscaleImage,
+	bool outputOcrErrors = false,
+	float rectifiedPixelsPerFaceEdgeWidth = defaultRectifiedPixelsPerFaceEdgeWidth
+);
@@ -1,6 +1,8 @@
 //  © 2019 Stuart Edward Schechter (Github: @uppajung)
 
 #include <limits>
+#include <atomic>
+#include <cassert>
 
 #include "utilities/vfunctional.h"
 #include "graphics/cv.h"
@@ -78,6 +80,117 @@ cv::Mat ocrErrorHeatMap(
   return errorImage;
 }
 
+namespace {
+  // The number of resampling maps to retain.  Images of characters are nearly
+  // always the same size from face to face (and frame to frame), and there are
+  // only two alphabets (letters and digits), so a handful of entries suffices.
+  const size_t ocrResamplingCacheCapacity = 8;
+
+  // Each thread that reads faces has a cache of its own, so that the faces read
+  // in parallel don't contend for a lock on every OCR call
+  thread_local std::vector<std::shared_ptr<const OcrResamplingMap>> ocrResamplingCache;
+  thread_local size_t ocrResamplingCacheIndexToReplaceNext = 0;
+  std::atomic<unsigned long long> ocrResamplingCacheHits(0);
+  std::atomic<unsigned long long> ocrResamplingCacheMisses(0);
+  // The counts, if any, that this thread's lookups are also counted into
+  thread_local OcrResamplingCacheCounts *ocrResamplingCacheCountsOfThisThread = nullptr;
+}
+
+OcrResamplingCacheCounting::OcrResamplingCacheCounting(OcrResamplingCacheCounts *counts) :
+  previousCounts(ocrResamplingCacheCountsOfThisThread)
+{
+  ocrResamplingCacheCountsOfThisThread = counts;
+}
+
+OcrResamplingCacheCounting::~OcrResamplingCacheCounting() {
+  ocrResamplingCacheCountsOfThisThread = previousCounts;
+}
+
+OcrResamplingMap::OcrResamplingMap(
+  const OcrFont &font,
+  size_t _numberOfCharactersInAlphabet,
+  int _imageWidth,
+  int _imageHeight
+) :
+  ocrCharWidthInPixels(font.ocrCharWidthInPixels),
+  ocrCharHeightInPixels(font.ocrCharHeightInPixels),
+  numberOfCharactersInAlphabet(_numberOfCharactersInAlphabet),
+  imageWidth(_imageWidth),
+  imageHeight(_imageHeight),
+  penaltyOffsetForImageX(size_t(_imageWidth)),
+  penaltyOffsetForImageY(size_t(_imageHeight))
+{
+  const float charWidthOverImageWidth = float(font.ocrCharWidthInPixels) / float(imageWidth);
+  const float charHeightOverImageHeight = float(font.ocrCharHeightInPixels) / float(imageHeight);
+  const size_t penaltyStepX = numberOfCharactersInAlphabet;
+  const size_t penaltyStepY = (penaltyStepX * font.ocrCharWidthInPixels);
+  for (int imageY = 0; imageY < imageHeight; imageY++) {
+    const int modelY = int( (imageY + 0.5f) * charHeightOverImageHeight );
+    assert(modelY < font.ocrCharHeightInPixels);
+    penaltyOffsetForImageY[imageY] = modelY * penaltyStepY;
+  }
+  for (int imageX = 0; imageX < imageWidth; imageX++) {
+    const int modelX = int( (imageX + 0.5f) * charWidthOverImageWidth );
+    assert(modelX < font.ocrCharWidthInPixels);
+    penaltyOffsetForImageX[imageX] = modelX * penaltyStepX;
+  }
+}
+
+bool OcrResamplingMap::matches(
+  const OcrFont &font,
+  size_t _numberOfCharactersInAlphabet,
+  int _imageWidth,
+  int _imageHeight
+) const {
+  return
+    imageWidth == _imageWidth &&
+    imageHeight == _imageHeight &&
+    numberOfCharactersInAlphabet == _numberOfCharactersInAlphabet &&
+    ocrCharWidthInPixels == font.ocrCharWidthInPixels &&
+    ocrCharHeightInPixels == font.ocrCharHeightInPixels;
+}
+
+std::shared_ptr<const OcrResamplingMap> getOcrResamplingMap(
+  const OcrFont &font,
+  size_t numberOfCharactersInAlphabet,
+  int imageWidth,
+  int imageHeight
+) {
+  for (const auto &map : ocrResamplingCache) {
+    if (map->matches(font, numberOfCharactersInAlphabet, imageWidth, imageHeight)) {
+      ocrResamplingCacheHits++;
+      if (ocrResamplingCacheCountsOfThisThread != nullptr) {
+        ocrResamplingCacheCountsOfThisThread->hits++;
+      }
+      return map;
+    }
+  }
+  ocrResamplingCacheMisses++;
+  if (ocrResamplingCacheCountsOfThisThread != nullptr) {
+    ocrResamplingCacheCountsOfThisThread->misses++;
+  }
+  std::shared_ptr<const OcrResamplingMap> map =
+    std::make_shared<const OcrResamplingMap>(font, numberOfCharactersInAlphabet, imageWidth, imageHeight);
+  if (ocrResamplingCache.size() < ocrResamplingCacheCapacity) {
+    ocrResamplingCache.push_back(map);
+  } else {
+    // Replace entries round-robin.  Callers hold a shared pointer, so an entry
+    // evicted while the caller is still using it remains valid.
+    ocrResamplingCache[ocrResamplingCacheIndexToReplaceNext] = map;
+    ocrResamplingCacheIndexToReplaceNext = (ocrResamplingCacheIndexToReplaceNext + 1) % ocrResamplingCacheCapacity;
+  }
+  return map;
+}
+
+OcrResamplingCacheStatistics getOcrResamplingCacheStatistics() {
+  return { ocrResamplingCacheHits.load(), ocrResamplingCacheMisses.load() };
+}
+
+void resetOcrResamplingCacheStatistics() {
+  ocrResamplingCacheHits = 0;
+  ocrResamplingCacheMisses = 0;
+}
+
 const OcrResult findClosestMatchingCharacter(
   const OcrFont &font,
   const OcrAlphabet &alphabet,
@@ -87,37 +200,45 @@ const OcrResult findClosestMatchingCharacter(
   const int imageWidth = bwImageOfCharacter.cols;
   const int numberOfCharactersInAlphabet = (int) alphabet.characters.size();
   std::vector<OcrResultEntry> result(numberOfCharactersInAlphabet);
+  std::vector<int> errorScores(numberOfCharactersInAlphabet, 0);
 
   for (int i=0; i < numberOfCharactersInAlphabet; i++) {
     result[i].character = alphabet.characters[i].character;
-    result[i].errorScore = 0;
   }
 
-  const float charWidthOverImageWidth = float(font.ocrCharWidthInPixels) / float(imageWidth);
-  const float charHeightOverImageHeight = float(font.ocrCharHeightInPixels) / float(imageHeight);
-  const size_t penaltyStepX = numberOfCharactersInAlphabet;
-  const size_t penaltyStepY = (penaltyStepX * font.ocrCharWidthInPixels);
+  // The mapping from image coordinates to model coordinates depends only on the
+  // size of the image, so we fetch precomputed offsets into the penalty table
+  // rather than recalculating them for each pixel.
+  const std::shared_ptr<const OcrResamplingMap> resamplingMap =
+    getOcrResamplingMap(font, size_t(numberOfCharactersInAlphabet), imageWidth, imageHeight);
+  const size_t* penaltyOffsetForImageX = resamplingMap->penaltyOffsetForImageX.data();
+  const size_t* penaltyOffsetForImageY = resamplingMap->penaltyOffsetForImageY.data();
+  int* errorScoreForCharIndex = errorScores.data();
+
   for (int imageY = 0; imageY < imageHeight; imageY++) {
-    const int modelY = int( (imageY + 0.5f) * charHeightOverImageHeight ); //  font.ocrCharHeightInPixels) / float(imageHeight));
-    const unsigned char* penaltyPtrAtModelY = alphabet.penalties + (modelY * penaltyStepY);
-    assert(modelY < font.ocrCharHeightInPixels);
+    const unsigned char* penaltyPtrAtModelY = alphabet.penalties + penaltyOffsetForImageY[imageY];
+    const uchar* pixelsInRow = bwImageOfCharacter.ptr<uchar>(imageY);
     for (int imageX = 0; imageX < imageWidth; imageX++) {
-      const int modelX = int( (imageX + 0.5f) * charWidthOverImageWidth ); // * font.ocrCharWidthInPixels) / float(imageWidth));
-      const unsigned char* penaltyPtrAtModelYX = penaltyPtrAtModelY + (modelX * penaltyStepX);
-      assert(modelX < font.ocrCharWidthInPixels);
-      for (int charIndex = 0; charIndex < numberOfCharactersInAlphabet; charIndex++) {
-        const uchar pixel = bwImageOfCharacter.at<uchar>(imageY, imageX); // cv::Point2i(imageX, imageY));
-        unsigned char penaltyEntry = *(penaltyPtrAtModelYX + charIndex);
-        const bool isImagePixelBlack = pixel < 128;
-        // The high nibble has the penalty if the pixel is white,
-        // and the low nibble has the penalty if the pixel is black
-        unsigned char penalty = isImagePixelBlack ?
-          (penaltyEntry & 0xf) : (penaltyEntry >> 4);
-        result[charIndex].errorScore += penalty;
+      const unsigned char* penaltyPtrAtModelYX = penaltyPtrAtModelY + penaltyOffsetForImageX[imageX];
+      const bool isImagePixelBlack = pixelsInRow[imageX] < 128;
+      // The high nibble has the penalty if the pixel is white,
+      // and the low nibble has the penalty if the pixel is black
+      if (isImagePixelBlack) {
+        for (int charIndex = 0; charIndex < numberOfCharactersInAlphabet; charIndex++) {
+          errorScoreForCharIndex[charIndex] += penaltyPtrAtModelYX[charIndex] & 0xf;
+        }
+      } else {
+        for (int charIndex = 0; charIndex < numberOfCharactersInAlphabet; charIndex++) {
+          errorScoreForCharIndex[charIndex] += penaltyPtrAtModelYX[charIndex] >> 4;
+        }
       }
     }
   }
 
+  for (int i=0; i < numberOfCharactersInAlphabet; i++) {
+    result[i].errorScore = errorScores[i];
+  }
+
   std::sort(result.begin(), result.end(), [](OcrResultEntry a, OcrResultEntry b) {return a.errorScore < b.errorScore;} );
 
   return result;
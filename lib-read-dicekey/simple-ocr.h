@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include "graphics/cv.h"
 #include "font.h"
 
@@ -18,6 +20,89 @@ cv::Mat ocrErrorHeatMap(
   const cv::Mat &bwImageOfCharacter
 );
 
+/**
+ * Precomputed offsets into an alphabet's penalty table for each column (x)
+ * and row (y) of an image of a character, so that the OCR inner loop need only
+ * add an x offset to a y offset rather than map each pixel into the coordinates
+ * of the OCR model.
+ **/
+class OcrResamplingMap {
+public:
+  const int ocrCharWidthInPixels;
+  const int ocrCharHeightInPixels;
+  const size_t numberOfCharactersInAlphabet;
+  const int imageWidth;
+  const int imageHeight;
+  // penaltyOffsetForImageX[imageX] = modelX * numberOfCharactersInAlphabet
+  std::vector<size_t> penaltyOffsetForImageX;
+  // penaltyOffsetForImageY[imageY] = modelY * ocrCharWidthInPixels * numberOfCharactersInAlphabet
+  std::vector<size_t> penaltyOffsetForImageY;
+
+  OcrResamplingMap(
+    const OcrFont &font,
+    size_t numberOfCharactersInAlphabet,
+    int imageWidth,
+    int imageHeight
+  );
+
+  bool matches(
+    const OcrFont &font,
+    size_t numberOfCharactersInAlphabet,
+    int imageWidth,
+    int imageHeight
+  ) const;
+};
+
+/**
+ * Get the resampling map for images of a given size, from a small cache shared
+ * across faces and frames.  Each thread has a cache of its own, so lookups take
+ * no lock (the pool threads reading faces each fill theirs on the first frame).
+ **/
+std::shared_ptr<const OcrResamplingMap> getOcrResamplingMap(
+  const OcrFont &font,
+  size_t numberOfCharactersInAlphabet,
+  int imageWidth,
+  int imageHeight
+);
+
+struct OcrResamplingCacheStatistics {
+  unsigned long long hits;
+  unsigned long long misses;
+
+  float hitRate() const {
+    return (hits + misses) == 0 ? 0.0f : float(hits) / float(hits + misses);
+  }
+};
+
+/**
+ * Get the number of times the resampling map cache was hit and missed
+ * since the library was loaded (or since the statistics were last reset).
+ **/
+OcrResamplingCacheStatistics getOcrResamplingCacheStatistics();
+void resetOcrResamplingCacheStatistics();
+
+struct OcrResamplingCacheCounts {
+  std::atomic<unsigned> hits;
+  std::atomic<unsigned> misses;
+
+  OcrResamplingCacheCounts() : hits(0), misses(0) {}
+};
+
+/**
+ * While in scope, also count the resampling map cache's hits and misses on this
+ * thread into the given counts, which several threads may share.  This lets a
+ * caller attribute the lookups made by the threads reading faces on its behalf
+ * to its own frame (see ocrCacheHits in FrameStats).  Passing nullptr counts nothing.
+ **/
+class OcrResamplingCacheCounting {
+  OcrResamplingCacheCounts *previousCounts;
+public:
+  explicit OcrResamplingCacheCounting(OcrResamplingCacheCounts *counts);
+  ~OcrResamplingCacheCounting();
+  OcrResamplingCacheCounting(const OcrResamplingCacheCounting&) = delete;
+  OcrResamplingCacheCounting& operator=(const OcrResamplingCacheCounting&) = delete;
+};
+
 const OcrResult findClosestMatchingCharacter(
   const OcrFont& font,
   const OcrAlphabet &alphabet,
@@ -0,0 +1,147 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "trace.h"
+#include "json.h"
+
+struct TraceSpan {
+	const char *name;
+	int64_t beginNanoseconds;
+	int64_t durationNanoseconds;
+};
+
+/**
+ * The spans recorded by one thread.  Only that thread writes spans, and it
+ * publishes each by advancing spansWritten; clearing the trace advances
+ * spansCleared rather than touching the spans.
+ **/
+struct ThreadTraceBuffer {
+	unsigned threadId;
+	std::atomic<uint64_t> spansWritten;
+	std::atomic<uint64_t> spansCleared;
+	TraceSpan spans[TraceBufferCapacity];
+
+	explicit ThreadTraceBuffer(unsigned _threadId) : threadId(_threadId), spansWritten(0), spansCleared(0) {}
+};
+
+static std::atomic<bool> tracingEnabled(false);
+
+// Every thread's buffer, kept after the thread exits so that its spans can still be read
+static std::mutex traceBuffersMutex;
+static std::vector<std::shared_ptr<ThreadTraceBuffer>> &traceBuffers() {
+	static std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+	return buffers;
+}
+
+// The time spans are measured from, set when tracing is first enabled
+static std::chrono::steady_clock::time_point &traceEpoch() {
+	static std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return epoch;
+}
+
+static ThreadTraceBuffer &bufferOfThisThread() {
+	static thread_local std::shared_ptr<ThreadTraceBuffer> buffer;
+	if (!buffer) {
+		std::lock_guard<std::mutex> lock(traceBuffersMutex);
+		buffer = std::make_shared<ThreadTraceBuffer>(unsigned(traceBuffers().size()) + 1);
+		traceBuffers().push_back(buffer);
+	}
+	return *buffer;
+}
+
+bool isTracingCompiledIn() {
+#ifdef DICEKEY_TRACE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void setTracingEnabled(bool enabled) {
+	traceEpoch();
+	tracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isTracingEnabled() {
+	return tracingEnabled.load(std::memory_order_relaxed);
+}
+
+void clearTrace() {
+	std::lock_guard<std::mutex> lock(traceBuffersMutex);
+	for (const std::shared_ptr<ThreadTraceBuffer> &buffer : traceBuffers()) {
+		buffer->spansCleared.store(buffer->spansWritten.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+TraceScope::TraceScope(const char *_name) : name(nullptr) {
+	if (tracingEnabled.load(std::memory_order_relaxed)) {
+		name = _name;
+		start = std::chrono::steady_clock::now();
+	}
+}
+
+TraceScope::~TraceScope() {
+	if (name == nullptr) {
+		return;
+	}
+	const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	ThreadTraceBuffer &buffer = bufferOfThisThread();
+	const uint64_t index = buffer.spansWritten.load(std::memory_order_relaxed);
+	TraceSpan &span = buffer.spans[index % TraceBufferCapacity];
+	span.name = name;
+	span.beginNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(start - traceEpoch()).count();
+	span.durationNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	buffer.spansWritten.store(index + 1, std::memory_order_release);
+}
+
+static void appendMicroseconds(std::string &json, int64_t nanoseconds) {
+	char formatted[32];
+	snprintf(formatted, sizeof(formatted), "%.3f", double(nanoseconds) / 1000.0);
+	json += formatted;
+}
+
+std::string traceToChromeJson() {
+	std::string json = "{\"traceEvents\":[";
+	bool first = true;
+	std::lock_guard<std::mutex> lock(traceBuffersMutex);
+	for (const std::shared_ptr<ThreadTraceBuffer> &buffer : traceBuffers()) {
+		const uint64_t written = buffer->spansWritten.load(std::memory_order_acquire);
+		const uint64_t cleared = buffer->spansCleared.load(std::memory_order_relaxed);
+		const uint64_t oldestKept = written > TraceBufferCapacity ? written - TraceBufferCapacity : 0;
+		for (uint64_t index = cleared > oldestKept ? cleared : oldestKept; index < written; index++) {
+			const TraceSpan &span = buffer->spans[index % TraceBufferCapacity];
+			if (!first) {
+				json += ',';
+			}
+			first = false;
+			// A complete ("X") event carries both the begin and end of a span
+			json += "{\"name\":";
+			jsonAppendQuoted(json, span.name, strlen(span.name));
+			json += ",\"ph\":\"X\",\"pid\":1,\"tid\":";
+			jsonAppendUnsigned(json, buffer->threadId);
+			json += ",\"ts\":";
+			appendMicroseconds(json, span.beginNanoseconds);
+			json += ",\"dur\":";
+			appendMicroseconds(json, span.durationNanoseconds);
+			json += '}';
+		}
+	}
+	json += "],\"displayTimeUnit\":\"ms\"}";
+	return json;
+}
+
+bool writeChromeTrace(const std::string &filePath) {
+	std::ofstream file(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+	const std::string json = traceToChromeJson();
+	file.write(json.data(), std::streamsize(json.size()));
+	return bool(file);
+}
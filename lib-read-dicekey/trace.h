@@ -0,0 +1,76 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+
+/**
+ * A lightweight trace of the spans of time spent in each stage of reading,
+ * on each thread, for seeing how stages overlap and where they stall.
+ *
+ * Each thread records its spans into its own ring buffer, which keeps the most
+ * recent TraceBufferCapacity spans, so recording needs no lock.  A span is
+ * recorded when its scope ends, with both its begin time and its duration.
+ *
+ * Spans are recorded only if the library is built with DICEKEY_TRACE defined
+ * (otherwise TRACE_SCOPE compiles to nothing) and tracing has been enabled
+ * with setTracingEnabled.
+ **/
+
+const size_t TraceBufferCapacity = 1 << 14;
+
+/**
+ * True if the library was built with DICEKEY_TRACE, and so can record spans.
+ **/
+bool isTracingCompiledIn();
+
+/**
+ * Start or stop recording spans (stopped by default).
+ **/
+void setTracingEnabled(bool enabled);
+bool isTracingEnabled();
+
+/**
+ * Discard the spans recorded so far.
+ **/
+void clearTrace();
+
+/**
+ * Return the spans recorded, on every thread, in the Chrome trace event format
+ * (viewable in chrome://tracing or Perfetto), with times in microseconds since
+ * tracing was first enabled.
+ *
+ * Call when no images are being processed, since spans recorded while the
+ * trace is being read may be torn.
+ **/
+std::string traceToChromeJson();
+
+/**
+ * Write traceToChromeJson() to a file, returning false if it could not be written.
+ **/
+bool writeChromeTrace(const std::string &filePath);
+
+/**
+ * Record the span of time from construction to destruction as a span with the
+ * given name, which must be a string literal (or otherwise outlive the trace).
+ **/
+class TraceScope {
+	const char *name;
+	std::chrono::steady_clock::time_point start;
+public:
+	explicit TraceScope(const char *name);
+	~TraceScope();
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#ifdef DICEKEY_TRACE
+#define TRACE_CONCATENATE_(a, b) a##b
+#define TRACE_CONCATENATE(a, b) TRACE_CONCATENATE_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCATENATE(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
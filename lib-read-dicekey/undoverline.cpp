@@ -91,25 +91,23 @@ Undoverline::Undoverline(
 }
 
 const std::string Undoverline::toJson() const {
+	std::string json;
+	appendJson(json);
+	return json;
+}
+
+void Undoverline::appendJson(std::string &json) const {
 	if (!found || !determinedIfUnderlineOrOverline) {
-		return "null";
+		json += "null";
+		return;
 	}
-	// const cv::Point2f center = midpointOfLine(line);
-	std::ostringstream jsonStream;
-	jsonStream <<
-	"{" <<
-		"\"" << JsonKeys::Undoverline::code << "\": " << std::to_string(letterDigitEncoding) << "," <<
-		"\"" << JsonKeys::Undoverline::line << "\": " << lineToJson(line) <<
-		// "center: {" <<
-		// 	"x: " << center.x << ", " <<
-		// 	"y: " << center.y << "" <<
-		// "}, " <<
-		// "angleInRadians: " << angleOfLineInSignedRadians2f(line) << "," <<
-		// "lengthInPixels: " << lineLength(line) << "," <<
-		// "letterDigitEncoding: " << letterDigitEncoding << "," <<
-		// "whiteBlackThreshold: " << whiteBlackThreshold << "" <<
-	"}";
-	return jsonStream.str();
+	json += '{';
+	jsonAppendKey(json, JsonKeys::Undoverline::code);
+	jsonAppendUnsigned(json, letterDigitEncoding);
+	json += ',';
+	jsonAppendKey(json, JsonKeys::Undoverline::line);
+	jsonAppendLine(json, line);
+	json += '}';
 }
 
 
@@ -29,6 +29,8 @@ public:
   }
 
   const std::string toJson() const;
+  // Append the undoverline, in the JSON format of toJson, to a buffer
+  void appendJson(std::string &json) const;
 
   Undoverline(
     cv::RotatedRect _fromRotatedRect,
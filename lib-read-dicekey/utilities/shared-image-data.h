@@ -0,0 +1,90 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+A handle to a buffer of image bytes that is shared, rather than copied, when the
+handle is copied.  Carrying the image of a face from one frame's DiceKey to the
+next copies only the handle.
+
+The bytes may be captured lazily: captureLater() stores a function that produces
+them, which runs (once, for all handles sharing it) the first time the bytes are
+needed.  Images that are never asked for are never captured.  Whatever the
+capture function holds (e.g., a region of the frame the image comes from) lives
+until the image is captured or discardPendingCapture() is called.
+
+The buffer is copied on write: getWritable() gives the handle its own copy of
+the bytes first if any other handle shares them.
+
+Handles are not safe to use from multiple threads at once, as reading the
+bytes of an image not yet captured captures it.
+*/
+class SharedImageData {
+private:
+	typedef std::function<void(std::vector<unsigned char> &bytes)> CaptureFunction;
+
+	struct State {
+		std::vector<unsigned char> bytes;
+		// If set, produces the bytes the first time they are needed
+		CaptureFunction capture;
+	};
+	std::shared_ptr<State> state;
+
+	void captureIfPending() const {
+		if (state && state->capture) {
+			CaptureFunction capture = std::move(state->capture);
+			state->capture = nullptr;
+			capture(state->bytes);
+		}
+	}
+
+public:
+	// True if there is an image, whether or not it has been captured yet
+	bool hasImage() const {
+		return state && (state->capture || !state->bytes.empty());
+	}
+
+	size_t size() const {
+		captureIfPending();
+		return state ? state->bytes.size() : 0;
+	}
+
+	// The image bytes, or an empty vector if there is no image
+	const std::vector<unsigned char> &get() const {
+		static const std::vector<unsigned char> noBytes;
+		captureIfPending();
+		return state ? state->bytes : noBytes;
+	}
+
+	// The image bytes, copied first if shared with any other handle
+	std::vector<unsigned char> &getWritable() {
+		captureIfPending();
+		if (!state) {
+			state = std::make_shared<State>();
+		} else if (state.use_count() > 1) {
+			std::shared_ptr<State> copy = std::make_shared<State>();
+			copy->bytes = state->bytes;
+			state = copy;
+		}
+		return state->bytes;
+	}
+
+	// Replace the image with one to be produced by capture() when first needed
+	void captureLater(CaptureFunction capture) {
+		state = std::make_shared<State>();
+		state->capture = std::move(capture);
+	}
+
+	// If the image has yet to be captured, discard it (and whatever the function
+	// that would capture it holds) for every handle sharing it
+	void discardPendingCapture() {
+		if (state && state->capture) {
+			state->capture = nullptr;
+		}
+	}
+};
@@ -9,7 +9,7 @@
 #include "assemble-dicekey.hpp"
 #include "read-faces.h"
 #include "visualize-read-results.h"
-#include "write-face-characters.h"
+#include "overlay-draw-commands.h"
 
 // Colors are in BGR format
 //const Color colorNoErrorGreen(0, 192, 0);
@@ -30,6 +30,7 @@ Color errorMagnitudeToColor(unsigned errorMagnitude) {
  * 
  * @param overlayImage Must be a CV_8UC4 RGBA image
  * @param faces An array of the 25 faces
+ * @param undoverlines The table of the faces' undoverlines
  * @param angleInRadiansNonCanonicalForm 
  * @param pixelsPerFaceEdgeWidth 
  * @return cv::Mat 
@@ -37,58 +38,48 @@ Color errorMagnitudeToColor(unsigned errorMagnitude) {
 cv::Mat visualizeReadResults(
 	cv::Mat &overlayImage,
 	const std::vector<FaceRead> &faces,
+	const UndoverlineTable &undoverlines,
 	float angleInRadiansNonCanonicalForm,
 	float pixelsPerFaceEdgeWidth
 ) {
-  // Derive the length of each side of the face in pixels by dividing the
-  // legnth off and 
-  const float faceSizeInPixels = FaceDimensionsFractional::size * pixelsPerFaceEdgeWidth;
-  const int thinLineThickness = 1 + int(faceSizeInPixels / 70);
-  const int thickLineThickness = 2 * thinLineThickness;
+  OverlayDrawCommands commands;
+  commands.addReadResults(faces, undoverlines, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
+  commands.render(overlayImage);
+	return overlayImage;
+}
 
-  for (const FaceRead &face: faces) {
-    const auto error = face.error();
+cv::Mat visualizeReadResults(
+	cv::Mat &overlayImage,
+	const DiceKey<FaceRead> &diceKey,
+	const UndoverlineTable &undoverlines,
+	float angleInRadiansNonCanonicalForm,
+	float pixelsPerFaceEdgeWidth
+) {
+  OverlayDrawCommands commands;
+  commands.addReadResults(diceKey, undoverlines, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
+  commands.render(overlayImage);
+	return overlayImage;
+}
+
+static cv::Rect inflateRect(const cv::Rect &rect, int margin) {
+  return cv::Rect(rect.x - margin, rect.y - margin, rect.width + 2 * margin, rect.height + 2 * margin);
+}
 
-    // Draw a rectangle around the face if an error has been found
-    if (error.magnitude > 0) {
-      drawRotatedRect(
-        overlayImage,
-        cv::RotatedRect(face.center(), cv::Size2d(faceSizeInPixels, faceSizeInPixels), radiansToDegrees(angleInRadiansNonCanonicalForm)),
-        errorMagnitudeToColor(error.magnitude).scalarRGBA,
-        error.magnitude == 0 ? thinLineThickness : thickLineThickness
-      );
-    }
-    // Draw a rectangle around the underline
-    if (face.underline.found) {
-      bool underlineError = (error.location & FaceErrors::Location::Underline);
-      drawRotatedRect(overlayImage, face.underline.fromRotatedRect,
-        errorMagnitudeToColor( underlineError ? error.magnitude : 0 ).scalarRGBA,
-        underlineError ? thickLineThickness : thinLineThickness );
-    }
-    // Draw a rectangle around the overline
-    if (face.overline.found) {
-      bool overlineError = (error.location & FaceErrors::Location::Overline);
-      drawRotatedRect(overlayImage, face.overline.fromRotatedRect,
-        errorMagnitudeToColor( overlineError ? error.magnitude : 0 ).scalarRGBA,
-        overlineError ? thickLineThickness : thinLineThickness );
-    }
-    // Draw the characters read
-    writeFaceCharacters(overlayImage, face.center(), face.inferredAngleInRadians(), pixelsPerFaceEdgeWidth, face.letter(), face.digit(),
-      errorMagnitudeToColor( (error.location & FaceErrors::Location::OcrLetter) ? error.magnitude : 0 ),
-      errorMagnitudeToColor( (error.location & FaceErrors::Location::OcrDigit) ? error.magnitude : 0 )
+cv::Rect boundsOfOverlayDrawCommands(const OverlayDrawCommands &commands) {
+  cv::Rect bounds;
+  for (const OverlayRectangle &rectangle: commands.rectangles) {
+    // Lines are drawn centered on the rectangle's edges
+    const cv::Rect rectangleBounds = inflateRect(rectangle.rect.boundingRect(), rectangle.thickness / 2 + 1);
+    bounds = bounds.area() == 0 ? rectangleBounds : (bounds | rectangleBounds);
+  }
+  for (const OverlayGlyph &glyph: commands.glyphs) {
+    // The glyph lies within the circle around its box, whatever its angle
+    const float halfExtent = 0.5f * sqrt(glyph.width * glyph.width + glyph.height * glyph.height) + 1;
+    const cv::Rect glyphBounds(
+      cv::Point(int(floor(glyph.center.x - halfExtent)), int(floor(glyph.center.y - halfExtent))),
+      cv::Point(int(ceil(glyph.center.x + halfExtent)), int(ceil(glyph.center.y + halfExtent)))
     );
+    bounds = bounds.area() == 0 ? glyphBounds : (bounds | glyphBounds);
   }
-  // for (Undoverline undoverline: facesRead.strayUndoverlines) {
-  //   drawRotatedRect(overlayImage, undoverline.fromRotatedRect, colorBigErrorRed.scalarRGBA, 1);
-  // }
-  // for (FaceRead face: facesRead.strayFaces) {
-  //     drawRotatedRect(
-  //       overlayImage,
-  //       cv::RotatedRect(face.center(), cv::Size2d(faceSizeInPixels, faceSizeInPixels), radiansToDegrees(facesRead.angleInRadiansNonCanonicalForm)),
-  //       colorBigErrorRed.scalarRGBA, 1
-  //     );
-  // }
-
-
-	return overlayImage;
+  return bounds;
 }
@@ -6,6 +6,7 @@
 #include "graphics/cv.h"
 #include "graphics/color.h"
 #include "read-faces.h"
+#include "overlay-draw-commands.h"
 
 // Colors are in BGR format
 const Color colorNoErrorGreen(0, 192, 0);
@@ -17,6 +18,22 @@ Color errorMagnitudeToColor(unsigned errorMagnitude);
 cv::Mat visualizeReadResults(
 	cv::Mat &overlayImage,
 	const std::vector<FaceRead> &faces,
+	const UndoverlineTable &undoverlines,
 	float angleInRadiansNonCanonicalForm,
 	float pixelsPerFaceEdgeWidth
-);
\ No newline at end of file
+);
+
+cv::Mat visualizeReadResults(
+	cv::Mat &overlayImage,
+	const DiceKey<FaceRead> &diceKey,
+	const UndoverlineTable &undoverlines,
+	float angleInRadiansNonCanonicalForm,
+	float pixelsPerFaceEdgeWidth
+);
+
+/**
+ * @brief The rectangle (which may extend beyond the image) containing every
+ * pixel that OverlayDrawCommands::render draws, or an empty rectangle if it
+ * draws nothing.
+ */
+cv::Rect boundsOfOverlayDrawCommands(const OverlayDrawCommands &commands);
@@ -1,6 +1,10 @@
 //  © 2019 Stuart Edward Schechter (Github: @uppajung)
 
 #include <float.h>
+#include <stdint.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 #include "utilities/statistics.h"
 #include "graphics/geometry.h"
 #include "graphics/cv.h"
@@ -10,76 +14,181 @@
 #include "font.h"
 #include "write-face-characters.h"
 
-void writeFaceCharacters(
-	cv::Mat& imageColor,
+FaceCharacterPlacement placeFaceCharacters(
 	cv::Point2f faceCenter,
 	float angleInRadians,
-	float pixelsPerFaceEdgeWidth,
-	char letter,
-	char digit,
-	Color letterColor,
-	Color digitColor
+	float pixelsPerFaceEdgeWidth
 ) {
-	const OcrFont &font = *getFont();
-	const float textHeightDestinationPixels = FaceDimensionsFractional::textRegionHeight * pixelsPerFaceEdgeWidth;
+	FaceCharacterPlacement placement;
+	placement.charHeight = FaceDimensionsFractional::textRegionHeight * pixelsPerFaceEdgeWidth;
 	const float textWidthDestinationPixels = FaceDimensionsFractional::textRegionWidth * pixelsPerFaceEdgeWidth;
 	const float destinationPixelsBetweenLetterAndDigit = FaceDimensionsFractional::spaceBetweenLetterAndDigit * pixelsPerFaceEdgeWidth;
-	float charWidthDestinationPixels = (textWidthDestinationPixels - destinationPixelsBetweenLetterAndDigit) / 2;
-
-	const float centerSpaceInOriginPixels = FaceDimensionsFractional::spaceBetweenLetterAndDigit * pixelsPerFaceEdgeWidth *
-		font.outlineCharWidthInPixels / charWidthDestinationPixels;
-	const float textTopInOriginPixels = -float(font.outlineCharHeightInPixels) / 2;
-	const float letterLeftInOriginPixels = -(font.outlineCharWidthInPixels + centerSpaceInOriginPixels/2);
-	const float digitLeftInOriginPixels = centerSpaceInOriginPixels / 2;
-	
-	const float deltaXFraction = charWidthDestinationPixels / float(font.outlineCharWidthInPixels);
-	const float deltaYFraction = textHeightDestinationPixels / float(font.outlineCharHeightInPixels);
-
-	const float deltaXFromSourceChangeInX = deltaXFraction * cos(-angleInRadians);
-	const float deltaXFromSourceChangeInY = deltaYFraction * sin(-angleInRadians);
-	const float deltaYFromSourceChangeInX = deltaXFraction * cos(float(-angleInRadians + M_PI / 2));
-	const float deltaYFromSourceChangeInY = deltaYFraction * sin(float(-angleInRadians + M_PI / 2));
-
-	const float letterTopLeftX = faceCenter.x +
-		letterLeftInOriginPixels * deltaXFromSourceChangeInX +
-		textTopInOriginPixels * deltaXFromSourceChangeInY;
-	const float letterTopLeftY = faceCenter.y +
-		letterLeftInOriginPixels * deltaYFromSourceChangeInX +
-		textTopInOriginPixels * deltaYFromSourceChangeInY;
-	const float digitTopLeftX = faceCenter.x +
-		digitLeftInOriginPixels * deltaXFromSourceChangeInX +
-		textTopInOriginPixels * deltaXFromSourceChangeInY;
-	const float digitTopLeftY = faceCenter.y +
-		digitLeftInOriginPixels * deltaYFromSourceChangeInX +
-		textTopInOriginPixels * deltaYFromSourceChangeInY;
-
-	const OcrChar* letterRecord = vreduce<OcrChar, const OcrChar*>( font.letters.characters,
-		[letter](const OcrChar* r, const OcrChar* c) -> const OcrChar* {return c->character == letter ? c : r; },
-		(const OcrChar*)(NULL)
-	);
-
-	const OcrChar* digitRecord = vreduce<OcrChar, const OcrChar*>(font.digits.characters,
-		[digit](const OcrChar* r, const OcrChar* c) -> const OcrChar * {return c->character == digit ? c : r; },
-		(const OcrChar*)(NULL)
-		);
+	placement.charWidth = (textWidthDestinationPixels - destinationPixelsBetweenLetterAndDigit) / 2;
+
+	// The letter and digit are centered on either side of the face's center, along
+	// the text's baseline, with the space between letter and digit between them
+	const float distanceFromFaceCenter = (placement.charWidth + destinationPixelsBetweenLetterAndDigit) / 2;
+	const float dx = distanceFromFaceCenter * cos(-angleInRadians);
+	const float dy = distanceFromFaceCenter * cos(float(-angleInRadians + M_PI / 2));
+	placement.letterCenter = cv::Point2f(faceCenter.x - dx, faceCenter.y - dy);
+	placement.digitCenter = cv::Point2f(faceCenter.x + dx, faceCenter.y + dy);
+	return placement;
+}
+
+/**
+ * The pixels of a glyph's outline drawn at one size and angle, as offsets from
+ * the pixel nearest the glyph's center.  The offsets are sorted by row and
+ * then column, without duplicates, so they are written in memory order.
+ */
+struct GlyphSprite {
+	std::vector<cv::Point> offsets;
+};
+
+/**
+ * Sprites for each (character, size, angle) drawn, so that each glyph's outline
+ * is transformed only when the size or angle of the faces changes meaningfully.
+ * Sizes are quantized to quarter pixels and angles to 1/1024 of a turn, which
+ * moves no point of a glyph the size of a face's characters by more than a
+ * fraction of a pixel.
+ */
+class GlyphSpriteCache {
+	static const int SizeStepsPerPixel = 4;
+	static const int AngleStepsPerTurn = 1024;
+	// Sizes and angles vary a little from face to face and frame to frame, so
+	// the cache is cleared, rather than allowed to grow, if it gets this large
+	static const size_t MaxSprites = 2048;
+
+	std::unordered_map<uint64_t, GlyphSprite> sprites;
+	// Each character of the font, indexed by the character
+	const OcrChar* characters[256];
 
-	if (letterRecord) {
-		for (auto p : letterRecord->outlinePoints) {
-			const int x = int(round(letterTopLeftX + deltaXFromSourceChangeInX * p.x + deltaXFromSourceChangeInY * p.y));
-			const int y = int(round(letterTopLeftY + deltaYFromSourceChangeInX * p.x + deltaYFromSourceChangeInY * p.y));
-			if (x >= 0 || y >= 0 || x < imageColor.cols || y < imageColor.rows) {
-				imageColor.at<cv::Vec4b>(y, x) = letterColor.scalarRGBA;
+	static const OcrChar* findCharacter(const OcrAlphabet &alphabet, char character) {
+		for (const OcrChar &c : alphabet.characters) {
+			if (c.character == character) {
+				return &c;
 			}
+		}
+		return NULL;
 	}
+
+	static GlyphSprite rasterize(const OcrChar &characterRecord, float charWidth, float charHeight, float angleInRadians) {
+		const OcrFont &font = *getFont();
+		const float deltaXFraction = charWidth / float(font.outlineCharWidthInPixels);
+		const float deltaYFraction = charHeight / float(font.outlineCharHeightInPixels);
+
+		const float deltaXFromSourceChangeInX = deltaXFraction * cos(-angleInRadians);
+		const float deltaXFromSourceChangeInY = deltaYFraction * sin(-angleInRadians);
+		const float deltaYFromSourceChangeInX = deltaXFraction * cos(float(-angleInRadians + M_PI / 2));
+		const float deltaYFromSourceChangeInY = deltaYFraction * sin(float(-angleInRadians + M_PI / 2));
+
+		const float halfWidthInOriginPixels = float(font.outlineCharWidthInPixels) / 2;
+		const float halfHeightInOriginPixels = float(font.outlineCharHeightInPixels) / 2;
+		const float topLeftX = -halfWidthInOriginPixels * deltaXFromSourceChangeInX -
+			halfHeightInOriginPixels * deltaXFromSourceChangeInY;
+		const float topLeftY = -halfWidthInOriginPixels * deltaYFromSourceChangeInX -
+			halfHeightInOriginPixels * deltaYFromSourceChangeInY;
+
+		GlyphSprite sprite;
+		sprite.offsets.reserve(characterRecord.outlinePoints.size());
+		for (auto p : characterRecord.outlinePoints) {
+			sprite.offsets.push_back(cv::Point(
+				int(round(topLeftX + deltaXFromSourceChangeInX * p.x + deltaXFromSourceChangeInY * p.y)),
+				int(round(topLeftY + deltaYFromSourceChangeInX * p.x + deltaYFromSourceChangeInY * p.y))
+			));
+		}
+		std::sort(sprite.offsets.begin(), sprite.offsets.end(), [](const cv::Point &a, const cv::Point &b) {
+			return a.y < b.y || (a.y == b.y && a.x < b.x);
+		});
+		sprite.offsets.erase(std::unique(sprite.offsets.begin(), sprite.offsets.end()), sprite.offsets.end());
+		return sprite;
 	}
 
-	if (digitRecord) {
-		for (auto p : digitRecord->outlinePoints) {
-			const int x = int(round(digitTopLeftX + deltaXFromSourceChangeInX * p.x + deltaXFromSourceChangeInY * p.y));
-			const int y = int(round(digitTopLeftY + deltaYFromSourceChangeInX * p.x + deltaYFromSourceChangeInY * p.y));
-			if (x >= 0 || y >= 0 || x < imageColor.cols || y < imageColor.rows) {
-				imageColor.at<cv::Vec4b>(y, x) = digitColor.scalarRGBA;
-			}
+public:
+	GlyphSpriteCache() {
+		const OcrFont &font = *getFont();
+		for (int c = 0; c < 256; c++) {
+			const char character = char(c);
+			const OcrChar* characterRecord = findCharacter(font.letters, character);
+			characters[c] = characterRecord ? characterRecord : findCharacter(font.digits, character);
 		}
 	}
-}
\ No newline at end of file
+
+	// The sprite for a character, or NULL if the character is not in the font
+	const GlyphSprite* get(char character, float charWidth, float charHeight, float angleInRadians) {
+		const OcrChar* characterRecord = characters[(unsigned char) character];
+		if (!characterRecord) {
+			return NULL;
+		}
+		const uint64_t widthSteps = uint64_t(MAX(0.0f, round(charWidth * SizeStepsPerPixel))) & 0xFFFFF;
+		const uint64_t heightSteps = uint64_t(MAX(0.0f, round(charHeight * SizeStepsPerPixel))) & 0xFFFFF;
+		const float turns = angleInRadians / float(2 * M_PI);
+		const uint64_t angleSteps = uint64_t(int64_t(round((turns - floor(turns)) * AngleStepsPerTurn)) % AngleStepsPerTurn);
+		const uint64_t key = uint64_t((unsigned char) character) | (widthSteps << 8) | (heightSteps << 28) | (angleSteps << 48);
+
+		auto found = sprites.find(key);
+		if (found != sprites.end()) {
+			return &found->second;
+		}
+		if (sprites.size() >= MaxSprites) {
+			sprites.clear();
+		}
+		// Rasterize at the quantized size and angle, so that every use of the
+		// sprite draws the same pixels
+		GlyphSprite &sprite = sprites[key] = rasterize(
+			*characterRecord,
+			float(widthSteps) / SizeStepsPerPixel,
+			float(heightSteps) / SizeStepsPerPixel,
+			float(angleSteps) * float(2 * M_PI) / AngleStepsPerTurn
+		);
+		return &sprite;
+	}
+};
+
+void writeCharacter(
+	cv::Mat& imageColor,
+	char character,
+	cv::Point2f center,
+	float angleInRadians,
+	float charWidth,
+	float charHeight,
+	Color color
+) {
+	// Overlays may be drawn by more than one thread at once
+	static thread_local GlyphSpriteCache glyphSpriteCache;
+	const GlyphSprite* sprite = glyphSpriteCache.get(character, charWidth, charHeight, angleInRadians);
+	if (!sprite) {
+		return;
+	}
+	const cv::Vec4b pixel = color.scalarRGBA;
+	const int centerX = int(round(center.x));
+	const int centerY = int(round(center.y));
+	int rowY = -1;
+	cv::Vec4b* row = NULL;
+	for (const cv::Point &offset : sprite->offsets) {
+		const int x = centerX + offset.x;
+		const int y = centerY + offset.y;
+		if (x < 0 || y < 0 || x >= imageColor.cols || y >= imageColor.rows) {
+			continue;
+		}
+		if (y != rowY) {
+			rowY = y;
+			row = imageColor.ptr<cv::Vec4b>(y);
+		}
+		row[x] = pixel;
+	}
+}
+
+void writeFaceCharacters(
+	cv::Mat& imageColor,
+	cv::Point2f faceCenter,
+	float angleInRadians,
+	float pixelsPerFaceEdgeWidth,
+	char letter,
+	char digit,
+	Color letterColor,
+	Color digitColor
+) {
+	const FaceCharacterPlacement placement = placeFaceCharacters(faceCenter, angleInRadians, pixelsPerFaceEdgeWidth);
+	writeCharacter(imageColor, letter, placement.letterCenter, angleInRadians, placement.charWidth, placement.charHeight, letterColor);
+	writeCharacter(imageColor, digit, placement.digitCenter, angleInRadians, placement.charWidth, placement.charHeight, digitColor);
+}
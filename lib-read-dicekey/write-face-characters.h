@@ -5,6 +5,38 @@
 #include "graphics/cv.h"
 #include "graphics/color.h"
 
+/**
+ * Where the letter and digit of a face are drawn: the center of each, and the
+ * width and height of the box (rotated with the face) that each fills.
+ */
+struct FaceCharacterPlacement {
+	cv::Point2f letterCenter;
+	cv::Point2f digitCenter;
+	float charWidth;
+	float charHeight;
+};
+
+FaceCharacterPlacement placeFaceCharacters(
+	cv::Point2f faceCenter,
+	float angleInRadians,
+	float pixelsPerFaceEdgeWidth
+);
+
+/**
+ * Draw the outline of a character of the font (a letter or digit) so that
+ * it fills a box of the given size centered at center and rotated by angleInRadians.
+ * Characters not in the font are not drawn.
+ */
+void writeCharacter(
+	cv::Mat& imageColor,
+	char character,
+	cv::Point2f center,
+	float angleInRadians,
+	float charWidth,
+	float charHeight,
+	Color color
+);
+
 void writeFaceCharacters(
 	cv::Mat& imageColor,
 	cv::Point2f faceCenter,
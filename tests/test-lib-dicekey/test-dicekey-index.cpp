@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+#include "gtest/gtest.h"
+#include "dicekey-from-human-readable-form.hpp"
+#include "dicekey-index.hpp"
+
+const std::string indexTestHrf =
+	"A1tB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t";
+const std::string indexTestOtherHrf =
+	"Z1tY2rX3bW4lV5tU6bT1tS1tR1tP1tO1tN1tM1tL1tK1tJ1tI1tH1tG1tF1tE1tD1tC1tB1tA1t";
+// indexTestHrf with the orientation of its first face changed
+const std::string indexTestNearDuplicateHrf =
+	"A1lB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t";
+
+TEST(DiceKeyIndex, FindsDuplicates) {
+	DiceKeyIndex index;
+	ASSERT_EQ(index.insert(PackedDiceKey(indexTestHrf), 7).match, DiceKeyIndexMatch::None);
+	ASSERT_EQ(index.insert(PackedDiceKey(indexTestOtherHrf), 8).match, DiceKeyIndexMatch::None);
+	const DiceKeyIndexResult result = index.insert(PackedDiceKey(indexTestHrf), 9);
+	ASSERT_EQ(result.match, DiceKeyIndexMatch::Duplicate);
+	ASSERT_EQ(result.existingRecordId, 7u);
+	ASSERT_EQ(index.size(), 2u);
+}
+
+TEST(DiceKeyIndex, FindsRotatedDuplicates) {
+	DiceKeyIndex index;
+	index.insert(PackedDiceKey(indexTestHrf), 1);
+	for (int clockwiseTurns = 0; clockwiseTurns < 4; clockwiseTurns++) {
+		const DiceKeyIndexResult result = index.find(PackedDiceKey(rotateHumanReadableForm(indexTestHrf, clockwiseTurns)));
+		ASSERT_EQ(result.match, DiceKeyIndexMatch::Duplicate);
+		ASSERT_EQ(result.existingRecordId, 1u);
+	}
+}
+
+TEST(DiceKeyIndex, FindsNearDuplicates) {
+	DiceKeyIndex index;
+	index.insert(PackedDiceKey(indexTestHrf), 1);
+	const DiceKeyIndexResult result = index.insert(PackedDiceKey(rotateHumanReadableForm(indexTestNearDuplicateHrf, 1)), 2);
+	ASSERT_EQ(result.match, DiceKeyIndexMatch::NearDuplicate);
+	ASSERT_EQ(result.existingRecordId, 1u);
+	// A near-duplicate is still a distinct key
+	ASSERT_EQ(index.size(), 2u);
+	ASSERT_EQ(index.find(PackedDiceKey(indexTestNearDuplicateHrf)).match, DiceKeyIndexMatch::Duplicate);
+}
+
+TEST(DiceKeyIndex, InsertBatchMatchesInsertingInTurn) {
+	std::vector<PackedDiceKey> keys;
+	for (int clockwiseTurns = 0; clockwiseTurns < 4; clockwiseTurns++) {
+		keys.push_back(PackedDiceKey(rotateHumanReadableForm(indexTestHrf, clockwiseTurns)));
+	}
+	keys.push_back(PackedDiceKey(indexTestOtherHrf));
+	keys.push_back(PackedDiceKey(indexTestNearDuplicateHrf));
+
+	DiceKeyIndex index;
+	const std::vector<DiceKeyIndexResult> results = index.insertBatch(keys, 100);
+	ASSERT_EQ(results[0].match, DiceKeyIndexMatch::None);
+	for (int i = 1; i < 4; i++) {
+		ASSERT_EQ(results[i].match, DiceKeyIndexMatch::Duplicate);
+		ASSERT_EQ(results[i].existingRecordId, 100u);
+	}
+	ASSERT_EQ(results[4].match, DiceKeyIndexMatch::None);
+	ASSERT_EQ(results[5].match, DiceKeyIndexMatch::NearDuplicate);
+	ASSERT_EQ(index.size(), 3u);
+}
+
+TEST(DiceKeyIndex, SaveAndLoad) {
+	const std::string path = "test-dicekey-index.dkindex";
+	{
+		DiceKeyIndex index;
+		index.insert(PackedDiceKey(indexTestHrf), 1);
+		index.insert(PackedDiceKey(indexTestOtherHrf), 2);
+		index.save(path);
+	}
+	DiceKeyIndex loaded = DiceKeyIndex::load(path);
+	ASSERT_EQ(loaded.size(), 2u);
+	ASSERT_EQ(loaded.find(PackedDiceKey(indexTestOtherHrf)).existingRecordId, 2u);
+	ASSERT_EQ(loaded.find(PackedDiceKey(indexTestNearDuplicateHrf)).match, DiceKeyIndexMatch::NearDuplicate);
+	// A loaded index can be added to, including beyond the capacity it was saved with
+	PackedDiceKey key(indexTestOtherHrf);
+	uint32_t recordId = 3;
+	for (char digit = '1'; digit <= '6'; digit++) {
+		for (char letter = 'A'; letter <= 'Z'; letter++) {
+			const PackedFace face = packFace(letter, digit, 0);
+			if (face != InvalidPackedFace && letter != 'Z') {
+				key.setFace(0, face);
+				ASSERT_EQ(loaded.insert(key, recordId++).match, DiceKeyIndexMatch::None);
+			}
+		}
+	}
+	ASSERT_EQ(loaded.size(), size_t(recordId - 1));
+	ASSERT_EQ(loaded.find(PackedDiceKey(indexTestHrf)).existingRecordId, 1u);
+	remove(path.c_str());
+}
+
+TEST(DiceKeyIndex, LoadRejectsOtherFiles) {
+	const std::string path = "test-dicekey-index-invalid.dkindex";
+	FILE *file = fopen(path.c_str(), "wb");
+	fputs("This is not an index, although it is long enough to hold an index file's header.", file);
+	fclose(file);
+	ASSERT_THROW(DiceKeyIndex::load(path), std::runtime_error);
+	remove(path.c_str());
+}
+
+// Overwrite length bytes at offset within the file at path
+static void overwriteIndexFile(const std::string &path, long offset, const void *bytes, size_t length) {
+	FILE *file = fopen(path.c_str(), "r+b");
+	ASSERT_TRUE(file != NULL);
+	fseek(file, offset, SEEK_SET);
+	fwrite(bytes, length, 1, file);
+	fclose(file);
+}
+
+TEST(DiceKeyIndex, LoadRejectsCapacitiesTooLargeForTheFile) {
+	const std::string path = "test-dicekey-index-capacity.dkindex";
+	DiceKeyIndex index;
+	index.insert(PackedDiceKey(indexTestHrf), 1);
+	index.save(path);
+	// With 40-byte slots, a key capacity of 2^63 wraps to zero when multiplied by the slot size,
+	// so these capacities would appear to match the length of the file were the product not bounded
+	const uint64_t keyCapacity = uint64_t(1) << 63;
+	const uint64_t nearDuplicateCapacity = 32;
+	overwriteIndexFile(path, 24, &keyCapacity, sizeof(keyCapacity));
+	overwriteIndexFile(path, 40, &nearDuplicateCapacity, sizeof(nearDuplicateCapacity));
+	ASSERT_THROW(DiceKeyIndex::load(path), std::runtime_error);
+	remove(path.c_str());
+}
+
+TEST(DiceKeyIndex, StopsProbingATableWithNoEmptySlots) {
+	const std::string path = "test-dicekey-index-full.dkindex";
+	size_t keyCapacity;
+	{
+		DiceKeyIndex index;
+		index.insert(PackedDiceKey(indexTestHrf), 1);
+		index.save(path);
+	}
+	{
+		FILE *file = fopen(path.c_str(), "rb");
+		ASSERT_TRUE(file != NULL);
+		uint64_t capacity;
+		fseek(file, 24, SEEK_SET);
+		ASSERT_EQ(fread(&capacity, sizeof(capacity), 1, file), 1u);
+		fclose(file);
+		keyCapacity = size_t(capacity);
+	}
+	// Mark every slot of the table of keys occupied by a key that is in neither test key
+	DiceKeyIndexSlot occupiedSlot;
+	memset(&occupiedSlot, 0xff, sizeof(occupiedSlot));
+	occupiedSlot.recordId = 0;
+	occupiedSlot.occupied = 1;
+	for (size_t i = 0; i < keyCapacity; i++) {
+		overwriteIndexFile(path, long(64 + i * sizeof(DiceKeyIndexSlot)), &occupiedSlot, sizeof(occupiedSlot));
+	}
+	{
+		DiceKeyIndex index = DiceKeyIndex::load(path);
+		ASSERT_EQ(index.find(PackedDiceKey(indexTestOtherHrf)).match, DiceKeyIndexMatch::None);
+		ASSERT_THROW(index.insert(PackedDiceKey(indexTestOtherHrf), 2), std::runtime_error);
+	}
+	remove(path.c_str());
+}
@@ -10,3 +10,49 @@ TEST(DiceKey, ToHumanReadableFormandBack) {
 	const std::string hrf = key.toHumanReadableForm(true);
 	ASSERT_STREQ(orderedDiceKeyHrf.c_str(), hrf.c_str());
 }
+
+TEST(DiceKey, RotateMatchesRotatedHumanReadableForm) {
+	const DiceKeyFromString key = DiceKeyFromString(orderedDiceKeyHrf);
+	for (int clockwiseTurns = 0; clockwiseTurns < 4; clockwiseTurns++) {
+		ASSERT_EQ(
+			key.rotate(clockwiseTurns).toHumanReadableForm(true),
+			rotateHumanReadableForm(orderedDiceKeyHrf, clockwiseTurns)
+		);
+	}
+}
+
+TEST(DiceKey, RotateInPlaceFourTimesIsIdentity) {
+	DiceKey<Face> key = DiceKeyFromString(orderedDiceKeyHrf);
+	for (int i = 0; i < 4; i++) {
+		key.rotateInPlace(1);
+	}
+	ASSERT_EQ(key.toHumanReadableForm(true), orderedDiceKeyHrf);
+}
+
+TEST(DiceKey, MergePreviousAcceptsRotatedPrevious) {
+	const DiceKeyFromString key = DiceKeyFromString(orderedDiceKeyHrf);
+	const DiceKey<Face> merged = key.mergePrevious(key.rotate(3));
+	ASSERT_TRUE(merged.isInitialized());
+	ASSERT_EQ(merged.toHumanReadableForm(true), orderedDiceKeyHrf);
+}
+
+TEST(DiceKey, MergePreviousInPlaceMatchesMergePrevious) {
+	const DiceKeyFromString key = DiceKeyFromString(orderedDiceKeyHrf);
+	DiceKey<Face> mergedInPlace = key;
+	mergedInPlace.mergePreviousInPlace(key.rotate(1));
+	ASSERT_EQ(mergedInPlace.toHumanReadableForm(true), key.mergePrevious(key.rotate(1)).toHumanReadableForm(true));
+}
+
+TEST(DiceKey, ConstructFromMovedVector) {
+	const DiceKeyFromString key = DiceKeyFromString(orderedDiceKeyHrf);
+	std::vector<Face> faces(key.faces.begin(), key.faces.end());
+	const DiceKey<Face> moved(std::move(faces));
+	ASSERT_EQ(moved.toHumanReadableForm(true), orderedDiceKeyHrf);
+	ASSERT_THROW(DiceKey<Face>(std::vector<Face>(3)), std::invalid_argument);
+}
+
+TEST(DiceKey, DefaultIsUninitialized) {
+	const DiceKey<Face> key;
+	ASSERT_FALSE(key.isInitialized());
+	ASSERT_EQ(key.toJson(), "null");
+}
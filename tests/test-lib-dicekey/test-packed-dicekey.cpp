@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "dicekey-from-human-readable-form.hpp"
+#include "packed-dicekey.hpp"
+
+const std::string packedTestHrf =
+	"A1tB2rC3bD4lE5tF6bG1tH1tI1tJ1tK1tL1tM1tN1tO1tP1tR1tS1tT1tU1tV1tW1tX1tY1tZ1t";
+
+TEST(PackedDiceKey, ToHumanReadableFormAndBack) {
+	const PackedDiceKey packed(packedTestHrf);
+	ASSERT_EQ(packed.toHumanReadableForm(true), packedTestHrf);
+}
+
+TEST(PackedDiceKey, RotateMatchesRotatedHumanReadableForm) {
+	const PackedDiceKey packed(packedTestHrf);
+	for (int clockwiseTurns = 0; clockwiseTurns < 4; clockwiseTurns++) {
+		ASSERT_EQ(packed.rotate(clockwiseTurns).toHumanReadableForm(true), rotateHumanReadableForm(packedTestHrf, clockwiseTurns));
+	}
+}
+
+TEST(PackedDiceKey, OrderMatchesHumanReadableFormOrder) {
+	for (int clockwiseTurns = 1; clockwiseTurns < 4; clockwiseTurns++) {
+		const std::string rotatedHrf = rotateHumanReadableForm(packedTestHrf, clockwiseTurns);
+		ASSERT_EQ(PackedDiceKey(packedTestHrf) < PackedDiceKey(rotatedHrf), packedTestHrf < rotatedHrf);
+		ASSERT_EQ(PackedDiceKey(rotatedHrf) < PackedDiceKey(packedTestHrf), rotatedHrf < packedTestHrf);
+	}
+}
+
+TEST(PackedDiceKey, CanonicalOrientationMatchesDiceKey) {
+	for (int clockwiseTurns = 0; clockwiseTurns < 4; clockwiseTurns++) {
+		const std::string rotatedHrf = rotateHumanReadableForm(packedTestHrf, clockwiseTurns);
+		const DiceKeyFromString key(rotatedHrf);
+		ASSERT_EQ(
+			PackedDiceKey(rotatedHrf).rotateToCanonicalOrientation().toHumanReadableForm(true),
+			key.rotate(rotationsToCanonicalForm(rotatedHrf)).toHumanReadableForm(true)
+		);
+	}
+}
+
+TEST(PackedDiceKey, ConvertsToAndFromDiceKey) {
+	const DiceKeyFromString key(packedTestHrf);
+	const PackedDiceKey packed = key.toPacked();
+	ASSERT_EQ(DiceKey<Face>(packed.toFaces()).toHumanReadableForm(true), packedTestHrf);
+}
+
+TEST(PackedDiceKey, RejectsUndefinedFaces) {
+	std::string undefinedHrf = packedTestHrf;
+	undefinedHrf[1] = '?';
+	PackedDiceKey packed;
+	ASSERT_FALSE(PackedDiceKey::tryParse(undefinedHrf, packed));
+	ASSERT_THROW(PackedDiceKey{undefinedHrf}, std::invalid_argument);
+}
+
+TEST(PackedDiceKey, CanonicalOrientationOfKeyThatCannotBePacked) {
+	// Faces read by OCR may have letters and digits that are not on any die
+	std::string outOfAlphabetHrf = rotateHumanReadableForm(packedTestHrf, 1);
+	outOfAlphabetHrf[0] = 'Q';
+	outOfAlphabetHrf[4] = '7';
+	const DiceKeyFromString key(outOfAlphabetHrf);
+	PackedDiceKey packed;
+	ASSERT_FALSE(PackedDiceKey::tryFromFaces(key.faces, packed));
+	ASSERT_THROW(key.toPacked(), std::invalid_argument);
+	ASSERT_EQ(
+		key.rotateToCanonicalOrientation().toHumanReadableForm(true),
+		key.rotate(rotationsToCanonicalForm(outOfAlphabetHrf)).toHumanReadableForm(true)
+	);
+}
@@ -1,10 +1,42 @@
 #include "gtest/gtest.h"
 #include "read-dicekey.hpp"
+#include "dicekey-from-human-readable-form.hpp"
+#include "dicekey-read-binary.h"
+#include "dicekey-read-delta.h"
+#include "json.h"
+#include "rectify-dicekey.h"
+#include "render-dicekey-image.h"
+#include "trace.h"
 #include "validate-faces-read.h"
 #include "visualize-read-results.h"
+#include "write-face-characters.h"
 // for imread in tests files, imwrite if needed
 #include <opencv2/imgcodecs.hpp>
 
+// An image of a DiceKey that is read with at most a few correctable errors
+static const std::string imageOfDiceKeyWithFewErrors = "D2tS2tP2lN2lO2bC2bA2lX1tG1lY2rH2lT2tR1lU2rM1tB2lV2lE2bZ1bF2tI1bJ2rL2lK2bW2t.jpg";
+
+// Read an image in the test image directory and convert it with the given
+// OpenCV color conversion, returning an empty image (and failing the test) if
+// the image can't be read.
+static cv::Mat loadTestImage(const std::string &filePath, int colorConversionCode) {
+  const cv::Mat colorImage = cv::imread("tests/test-lib-read-dicekey/img/" + filePath, cv::IMREAD_COLOR);
+  EXPECT_FALSE(colorImage.empty()) << "No such file at " << filePath;
+  cv::Mat convertedImage;
+  if (!colorImage.empty()) {
+    cv::cvtColor(colorImage, convertedImage, colorConversionCode);
+  }
+  return convertedImage;
+}
+
+static cv::Mat loadTestImageAsRGBA(const std::string &filePath) {
+  return loadTestImage(filePath, cv::COLOR_BGR2RGBA);
+}
+
+static cv::Mat loadTestImageAsGrayscale(const std::string &filePath) {
+  return loadTestImage(filePath, cv::COLOR_BGR2GRAY);
+}
+
 void testFileWithObj(
   std::string filePath = std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()) + ".jpg"
 ) {
@@ -72,7 +104,7 @@ void testFile(
     if (facesRead.faces.size() == 25) {
       const auto angleInRadiansNonCanonicalForm = facesRead.angleInRadiansNonCanonicalForm;
       const auto pixelsPerFaceEdgeWidth = facesRead.pixelsPerFaceEdgeWidth;
-      const cv::Mat faceReadOutput = visualizeReadResults(rgbaImage, facesRead.faces, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
+      const cv::Mat faceReadOutput = visualizeReadResults(rgbaImage, facesRead.faces, facesRead.undoverlines, angleInRadiansNonCanonicalForm, pixelsPerFaceEdgeWidth);
       cv::Mat faceReadOutputBGR;
       cv::cvtColor(faceReadOutput, faceReadOutputBGR, cv::COLOR_RGBA2BGR);
       cv::imwrite("out/" + filename.substr(0, filename.length() - 4) + "-results.png", faceReadOutputBGR);
@@ -99,6 +131,14 @@ void testFile(
 			const DiceKey<FaceRead> diceKeyNonCanonical = DiceKey<FaceRead>(facesRead.faces);
 			const DiceKey<FaceRead> diceKey = diceKeyNonCanonical.rotateToCanonicalOrientation();
 			totalError = diceKey.totalError();
+
+			// The key decoded from its binary form must read the same as the faces it was encoded from
+			UndoverlineTable decodedUndoverlines;
+			const DiceKey<FaceRead> decodedDiceKey = diceKeyReadFromBinary(
+				diceKeyReadToBinary(diceKeyNonCanonical, facesRead.undoverlines), decodedUndoverlines
+			);
+			ASSERT_EQ(diceKeyReadToJson(decodedDiceKey, decodedUndoverlines), diceKeyReadToJson(diceKeyNonCanonical, facesRead.undoverlines));
+			ASSERT_EQ(decodedDiceKey.totalError(), diceKeyNonCanonical.totalError());
 		}
   } catch (std::string errStr) {
     std::cerr << "Exception in " << filename << "\n  " << errStr << "\n";
@@ -161,6 +201,449 @@ TEST(DiceKeysTestInputs, S4tI3lZ2tR3lE2tW5bK3lD3rV3rF3tC6rG6rA3rU2tX4rO5tN6tL6lY
   testFile("S4tI3lZ2tR3lE2tW5bK3lD3rV3rF3tC6rG6rA3rU2tX4rO5tN6tL6lY4rJ4tM5lH6rP1tT2lB4t.jpg", true, false, 0);
 }
 
+void testFileWithPerspectiveRectification(
+  std::string filePath,
+  bool tiltImage,
+  int maxErrorAllowed = 0
+) {
+  cv::Mat colorImage = cv::imread("tests/test-lib-read-dicekey/img/" + filePath, cv::IMREAD_COLOR);
+  ASSERT_FALSE(colorImage.empty()) << "No such file at " << filePath;
+  cv::Mat grayscaleImage;
+  cv::cvtColor(colorImage, grayscaleImage, cv::COLOR_BGR2GRAY);
+  if (tiltImage) {
+    // Simulate a camera tilted away from the top of the DiceKey by narrowing the top of the image
+    const float w = float(grayscaleImage.cols), h = float(grayscaleImage.rows);
+    const cv::Point2f from[4] = { {0, 0}, {w, 0}, {w, h}, {0, h} };
+    const cv::Point2f to[4] = { {w * 0.12f, h * 0.08f}, {w * 0.88f, h * 0.08f}, {w, h}, {0, h} };
+    cv::Mat tiltedImage;
+    cv::warpPerspective(grayscaleImage, tiltedImage, cv::getPerspectiveTransform(from, to),
+      grayscaleImage.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    grayscaleImage = tiltedImage;
+  }
+
+  const std::string filename = filePath.substr(filePath.find_last_of("/") + 1);
+  int totalError = 0;
+  try {
+    const auto facesRead = readFacesWithPerspectiveRectification(grayscaleImage, true);
+    ASSERT_EQ(facesRead.faces.size(), NumberOfFaces);
+    validateFacesRead(facesRead.faces, filename.substr(0, 75), true);
+    totalError = DiceKey<FaceRead>(facesRead.faces).rotateToCanonicalOrientation().totalError();
+  } catch (std::string errStr) {
+    std::cerr << "Exception in " << filename << "\n  " << errStr << "\n";
+    ASSERT_TRUE(false) << filename << "\n  " << errStr;
+  }
+  ASSERT_LE(totalError, maxErrorAllowed);
+}
+
+TEST(DiceKeysPerspectiveRectification, H21Z40F20D13M20P20T50X33V11W51A43C51U31I12O63N42R33B12S51L42Y61G33J30E53K42angle) {
+  testFileWithPerspectiveRectification("H21Z40F20D13M20P20T50X33V11W51A43C51U31I12O63N42R33B12S51L42Y61G33J30E53K42-angle.jpg", false);
+}
+TEST(DiceKeysPerspectiveRectification, A1bA6bA5bA4bA3bA2bA1bA6bA5bA4bA3bA2bA1bA6bA5bA4bA3bA2bA1bA6bA5bA4bA3bA2bA1btilted) {
+  testFileWithPerspectiveRectification("A1bA6bA5bA4bA3bA2bA1bA6bA5bA4bA3bA2bA1bA6bA5bA4bA3bA2bA1bA6bA5bA4bA3bA2bA1b.png", true);
+}
+
+TEST(DiceKeyImageProcessor, ImagesOfFacesWithErrorsRespectSizeLimit) {
+  const int maxFaceImageSize = 16;
+  const cv::Mat rgbaImage = loadTestImageAsRGBA(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(rgbaImage.empty());
+
+  DiceKeyImageProcessor reader;
+  reader.setMaxFaceImageSize(maxFaceImageSize);
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  const DiceKey<FaceRead> &diceKey = reader.diceKeyRead();
+  ASSERT_TRUE(diceKey.isInitialized());
+  for (size_t faceIndex = 0; faceIndex < NumberOfFaces; faceIndex++) {
+    // Only faces read with errors have images, which must be within the limit
+    const std::vector<unsigned char> &image = reader.getImageOfFace(faceIndex);
+    if (diceKey.faces[faceIndex].errorSize() == 0) {
+      ASSERT_EQ(image.size(), 0u);
+    } else {
+      ASSERT_LE(image.size(), size_t(maxFaceImageSize * maxFaceImageSize * 4));
+    }
+  }
+  ASSERT_EQ(reader.getImageOfFace(NumberOfFaces).size(), 0u);
+}
+
+TEST(DiceKeyImageProcessor, CapturesImagesOfFacesWithErrorsFromTheLatestFrame) {
+  const cv::Mat rgbaImage = loadTestImageAsRGBA(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(rgbaImage.empty());
+
+  DiceKeyImageProcessor reader;
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  ASSERT_TRUE(reader.diceKeyRead().isInitialized());
+  std::vector<size_t> facesWithErrors;
+  for (size_t faceIndex = 0; faceIndex < NumberOfFaces; faceIndex++) {
+    if (reader.diceKeyRead().faces[faceIndex].errorSize() > 0) {
+      facesWithErrors.push_back(faceIndex);
+    }
+  }
+  ASSERT_FALSE(facesWithErrors.empty());
+  // Capture the image of only the first face with an error
+  const size_t imageSize = reader.getImageOfFace(facesWithErrors[0]).size();
+  ASSERT_GT(imageSize, 0u);
+
+  // Releasing the regions retained for the images never asked for must not stop
+  // the next frame from capturing an image of every face still read with errors
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  ASSERT_TRUE(reader.diceKeyRead().isInitialized());
+  for (size_t faceIndex = 0; faceIndex < NumberOfFaces; faceIndex++) {
+    const size_t size = reader.getImageOfFace(faceIndex).size();
+    if (reader.diceKeyRead().faces[faceIndex].errorSize() > 0) {
+      ASSERT_GT(size, 0u);
+    } else {
+      ASSERT_EQ(size, 0u);
+    }
+  }
+  ASSERT_EQ(reader.getImageOfFace(facesWithErrors[0]).size(), imageSize);
+}
+
+TEST(DiceKeyImageProcessor, OverlayRedrawsOnlyItsDirtyRect) {
+  const cv::Mat rgbaImage = loadTestImageAsRGBA(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(rgbaImage.empty());
+  const int width = rgbaImage.cols, height = rgbaImage.rows;
+
+  DiceKeyImageProcessor reader;
+  reader.processRGBAImage(width, height, (uint32_t*) rgbaImage.data);
+  ASSERT_TRUE(reader.diceKeyRead().isInitialized());
+
+  // The first render into a buffer overwrites all of it
+  std::vector<uint32_t> overlay(size_t(width) * size_t(height), 0xFFFFFFFF);
+  reader.renderAugmentationOverlay(width, height, overlay.data());
+  ASSERT_EQ(reader.getOverlayDirtyRect(), cv::Rect(0, 0, width, height));
+
+  // Later renders change only the region drawn, yet produce the same overlay
+  // as rendering into a fresh buffer
+  reader.processRGBAImage(width, height, (uint32_t*) rgbaImage.data);
+  reader.renderAugmentationOverlay(width, height, overlay.data());
+  const cv::Rect dirtyRect = reader.getOverlayDirtyRect();
+  ASSERT_GT(dirtyRect.area(), 0);
+  ASSERT_LT(dirtyRect.area(), width * height);
+  std::vector<uint32_t> freshOverlay(size_t(width) * size_t(height), 0xFFFFFFFF);
+  DiceKeyImageProcessor freshReader;
+  freshReader.processRGBAImage(width, height, (uint32_t*) rgbaImage.data);
+  freshReader.processRGBAImage(width, height, (uint32_t*) rgbaImage.data);
+  freshReader.renderAugmentationOverlay(width, height, freshOverlay.data());
+  ASSERT_TRUE(overlay == freshOverlay);
+}
+
+TEST(DiceKeyImageProcessor, OverlayDrawCommandsDrawTheFacesRead) {
+  const cv::Mat rgbaImage = loadTestImageAsRGBA(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(rgbaImage.empty());
+
+  DiceKeyImageProcessor reader;
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  const DiceKey<FaceRead> &diceKey = reader.diceKeyRead();
+  ASSERT_TRUE(diceKey.isInitialized());
+
+  OverlayDrawCommands commands;
+  reader.writeOverlayDrawCommands(commands);
+  // A letter and digit for each face, and a rectangle for each undoverline found
+  ASSERT_EQ(commands.glyphs.size(), size_t(2 * NumberOfFaces));
+  ASSERT_GE(commands.rectangles.size(), size_t(NumberOfFaces));
+  for (size_t i = 0; i < NumberOfFaces; i++) {
+    ASSERT_EQ(commands.glyphs[2 * i].character, diceKey.faces[i].letter());
+    ASSERT_EQ(commands.glyphs[2 * i + 1].character, diceKey.faces[i].digit());
+  }
+  ASSERT_EQ(reader.jsonOverlayDrawCommands().find("{\"rectangles\": [{\"center\": {\"x\": "), 0u);
+}
+
+static size_t countNonZeroBytes(const cv::Mat &image) {
+  const size_t length = image.total() * image.elemSize();
+  return length - size_t(std::count(image.data, image.data + length, 0));
+}
+
+TEST(WriteFaceCharacters, GlyphsAreClippedToTheImage) {
+  // Characters centered at the corner of a small image lie mostly outside it
+  cv::Mat image(cv::Size(12, 12), CV_8UC4, cv::Scalar(0, 0, 0, 0));
+  writeFaceCharacters(image, cv::Point2f(0, 0), 0.3f, 40.0f, 'A', '1', colorNoErrorGreen, colorNoErrorGreen);
+  writeFaceCharacters(image, cv::Point2f(12, 12), -2.0f, 40.0f, 'W', '6', colorNoErrorGreen, colorNoErrorGreen);
+  ASSERT_GT(countNonZeroBytes(image), 0u);
+
+  // Drawing the same glyph twice, from the cache the second time, draws the same pixels
+  cv::Mat first(cv::Size(64, 64), CV_8UC4, cv::Scalar(0, 0, 0, 0));
+  cv::Mat second(cv::Size(64, 64), CV_8UC4, cv::Scalar(0, 0, 0, 0));
+  writeCharacter(first, 'K', cv::Point2f(32, 32), 0.5f, 20, 30, colorNoErrorGreen);
+  writeCharacter(second, 'K', cv::Point2f(32, 32), 0.5f, 20, 30, colorNoErrorGreen);
+  ASSERT_GT(countNonZeroBytes(first), 0u);
+  ASSERT_TRUE(std::equal(first.data, first.data + first.total() * first.elemSize(), second.data));
+}
+
+TEST(Json, FloatsAreFormattedAsToStringFormatsThem) {
+  const float values[] = {0.0f, -0.0f, 1.0f, -1.5f, 0.0000005f, 0.0000015f, 2.5e-7f, 123.456789f,
+    -987.654321f, 1919.9999995f, 4096.125f, 1e6f, 3.4e38f, -1e-30f};
+  for (const float value : values) {
+    std::string json;
+    jsonAppendFloat(json, value);
+    ASSERT_EQ(json, std::to_string(value));
+  }
+}
+
+TEST(Json, PointMatchesJsonKeys) {
+  ASSERT_EQ(pointToJson(cv::Point2f(1.25f, -2.0f)), "{\"x\": 1.250000, \"y\": -2.000000}");
+}
+
+TEST(DiceKeyReadBinary, UninitializedKeyAndMalformedInput) {
+  UndoverlineTable undoverlines;
+  const std::vector<unsigned char> binary = diceKeyReadToBinary(DiceKey<FaceRead>(), undoverlines);
+  ASSERT_EQ(binary.size(), DiceKeyReadBinarySize);
+  ASSERT_FALSE(diceKeyReadFromBinary(binary, undoverlines).isInitialized());
+  ASSERT_EQ(undoverlines.size(), 0u);
+
+  std::vector<unsigned char> truncated(binary.begin(), binary.end() - 1);
+  ASSERT_THROW(diceKeyReadFromBinary(truncated, undoverlines), std::invalid_argument);
+  std::vector<unsigned char> wrongVersion = binary;
+  wrongVersion[offsetof(DiceKeyReadBinaryHeader, version)]++;
+  ASSERT_THROW(diceKeyReadFromBinary(wrongVersion, undoverlines), std::invalid_argument);
+}
+
+// A key in which each face has only an underline, offset from the others,
+// whose undoverlines are written into the given table
+static DiceKey<FaceRead> diceKeyOfUnderlines(float offsetOfFace0InPixels, char orientationOfFace1, UndoverlineTable &undoverlines) {
+  undoverlines.clear();
+  std::vector<FaceRead> faces;
+  for (int i = 0; i < NumberOfFaces; i++) {
+    Undoverline underline;
+    underline.found = true;
+    underline.determinedIfUnderlineOrOverline = true;
+    underline.letterDigitEncoding = (unsigned char) i;
+    underline.faceInferred = decodeUndoverlineByte(false, underline.letterDigitEncoding);
+    const float x = 50.0f * float(i) + (i == 0 ? offsetOfFace0InPixels : 0);
+    underline.line = { {x, 10.0f}, {x + 40.0f, 10.0f} };
+    underline.inferredCenterOfFace = cv::Point2f(x + 20.0f, 30.0f);
+    faces.push_back(FaceRead(undoverlines, FaceUndoverlines(underline, Undoverline()), i == 1 ? orientationOfFace1 : 0, "A", "1"));
+  }
+  return DiceKey<FaceRead>(faces);
+}
+
+TEST(DiceKeyReadDelta, ReportsOnlyFacesThatChanged) {
+  DiceKeyReadDeltaTracker tracker;
+  DiceKeyReadDelta delta;
+  UndoverlineTable undoverlines;
+  tracker.delta(diceKeyOfUnderlines(0, 0, undoverlines), undoverlines, delta);
+  ASSERT_EQ(delta.sequenceNumber, 1u);
+  ASSERT_EQ(delta.changedFaces.size(), size_t(NumberOfFaces));
+
+  // Movement within the threshold is not reported, but a different orientation is
+  tracker.delta(diceKeyOfUnderlines(0.5f, 1, undoverlines), undoverlines, delta);
+  ASSERT_EQ(delta.sequenceNumber, 2u);
+  ASSERT_EQ(delta.changedFaces.size(), 1u);
+  ASSERT_EQ(delta.changedFaces[0].faceIndex, 1u);
+
+  // Movement that accumulates beyond the threshold is
+  tracker.delta(diceKeyOfUnderlines(1.5f, 1, undoverlines), undoverlines, delta);
+  ASSERT_EQ(delta.changedFaces.size(), 1u);
+  ASSERT_EQ(delta.changedFaces[0].faceIndex, 0u);
+  ASSERT_EQ(delta.toJson().find("{\"sequenceNumber\": 3, \"isInitialized\": true, \"faces\": [{\"index\": 0, \"face\": {"), 0u);
+
+  tracker.delta(DiceKey<FaceRead>(), UndoverlineTable(), delta);
+  ASSERT_FALSE(delta.isInitialized);
+  ASSERT_EQ(delta.changedFaces.size(), 0u);
+  tracker.delta(diceKeyOfUnderlines(1.5f, 1, undoverlines), undoverlines, delta);
+  ASSERT_EQ(delta.changedFaces.size(), size_t(NumberOfFaces));
+
+  tracker.delta(diceKeyOfUnderlines(1.5f, 1, undoverlines), undoverlines, delta);
+  ASSERT_EQ(delta.changedFaces.size(), 0u);
+  tracker.reset();
+  tracker.delta(diceKeyOfUnderlines(1.5f, 1, undoverlines), undoverlines, delta);
+  ASSERT_EQ(delta.sequenceNumber, 7u);
+  ASSERT_EQ(delta.changedFaces.size(), size_t(NumberOfFaces));
+}
+
+TEST(DiceKeyImageProcessor, FrameStatsAccountForEachStage) {
+  const cv::Mat rgbaImage = loadTestImageAsRGBA(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(rgbaImage.empty());
+
+  // Nothing is collected unless asked for
+  DiceKeyImageProcessor reader;
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  ASSERT_EQ(reader.frameStatsOfLastImage().totalMicroseconds, 0);
+
+  reader.setFrameStatsCollection(true);
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  ASSERT_TRUE(reader.diceKeyRead().isInitialized());
+  const FrameStats &stats = reader.frameStatsOfLastImage();
+  ASSERT_GT(stats.totalMicroseconds, 0);
+  ASSERT_GT(stats.thresholdLevels, 0u);
+  ASSERT_GT(stats.contours, stats.candidateUndoverlines);
+  ASSERT_GE(stats.candidateUndoverlines, stats.undoverlines);
+  ASSERT_GE(stats.undoverlines, 2 * stats.facesFound);
+  ASSERT_EQ(stats.ocrCalls, 2u * NumberOfFaces);
+  // Each OCR call looks up one resampling map, and those for the letters and digits
+  // of this image's faces were cached by each thread that read faces from the first frame
+  ASSERT_EQ(stats.ocrCacheHits + stats.ocrCacheMisses, stats.ocrCalls);
+  ASSERT_GT(stats.ocrCacheHits, 0u);
+  ASSERT_GT(stats.mergeMicroseconds, 0);
+  // The stages are timed separately, so their times sum to no more than the total
+  double sumOfStages = stats.grayscaleConversionMicroseconds + stats.blurMicroseconds +
+    stats.contourFindingMicroseconds + stats.candidateFilteringMicroseconds + stats.overlapRemovalMicroseconds +
+    stats.undoverlineReadingMicroseconds + stats.pairingMicroseconds + stats.gridFittingMicroseconds +
+    stats.ocrMicroseconds + stats.mergeMicroseconds;
+  for (unsigned level = 0; level < stats.thresholdLevels; level++) {
+    sumOfStages += stats.thresholdLevelMicroseconds[level];
+  }
+  ASSERT_LE(sumOfStages, stats.totalMicroseconds);
+
+  // readFaces fills stats when called directly
+  const cv::Mat grayscaleImage = loadTestImageAsGrayscale(imageOfDiceKeyWithFewErrors);
+  FrameStats readFacesStats;
+  readFaces(grayscaleImage, false, &readFacesStats);
+  ASSERT_EQ(readFacesStats.facesFound, stats.facesFound);
+  ASSERT_EQ(readFacesStats.grayscaleConversionMicroseconds, 0);
+
+  // With perspective rectification the faces are found once, in the frame,
+  // and then read from the rectified image
+  DiceKeyImageProcessor rectifyingReader;
+  rectifyingReader.setPerspectiveRectification(true);
+  rectifyingReader.setFrameStatsCollection(true);
+  rectifyingReader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  ASSERT_TRUE(rectifyingReader.diceKeyRead().isInitialized());
+  const FrameStats &rectifiedStats = rectifyingReader.frameStatsOfLastImage();
+  ASSERT_EQ(rectifiedStats.ocrCalls, 2u * NumberOfFaces);
+  ASSERT_EQ(rectifiedStats.ocrCacheHits + rectifiedStats.ocrCacheMisses, rectifiedStats.ocrCalls);
+  ASSERT_GE(rectifiedStats.undoverlines, 2 * rectifiedStats.facesFound);
+  ASSERT_EQ(rectifiedStats.contours, stats.contours);
+  ASSERT_EQ(rectifiedStats.facesFound, stats.facesFound);
+}
+
+TEST(Trace, RecordsSpansAsChromeTraceEvents) {
+  const cv::Mat rgbaImage = loadTestImageAsRGBA(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(rgbaImage.empty());
+
+  clearTrace();
+  setTracingEnabled(true);
+  DiceKeyImageProcessor reader;
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  setTracingEnabled(false);
+  const std::string trace = traceToChromeJson();
+  ASSERT_EQ(trace.find("{\"traceEvents\":["), 0u);
+  if (isTracingCompiledIn()) {
+    ASSERT_NE(trace.find("\"name\":\"DiceKeyImageProcessor::processRGBAImage\",\"ph\":\"X\""), std::string::npos);
+    ASSERT_NE(trace.find("\"findRectangles\""), std::string::npos);
+    ASSERT_NE(trace.find("\"findReadableUndoverlines\""), std::string::npos);
+    ASSERT_NE(trace.find("\"readFaces\""), std::string::npos);
+  } else {
+    ASSERT_EQ(trace.find("\"name\""), std::string::npos);
+  }
+
+  // Spans recorded while tracing is disabled, or before the trace was cleared, are not kept
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  clearTrace();
+  ASSERT_EQ(traceToChromeJson().find("\"name\""), std::string::npos);
+}
+
+TEST(DiceKeyImageProcessor, ReadsTheTimeFromItsClock) {
+  const cv::Mat rgbaImage = loadTestImageAsRGBA(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(rgbaImage.empty());
+
+  // A simulated clock, read once per frame
+  int timesRead = 0;
+  std::chrono::system_clock::time_point simulatedNow = std::chrono::system_clock::time_point(std::chrono::hours(24));
+  DiceKeyImageProcessor reader;
+  reader.setClock([&timesRead, &simulatedNow]() {
+    timesRead++;
+    return simulatedNow;
+  });
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  ASSERT_EQ(timesRead, 1);
+  ASSERT_TRUE(reader.diceKeyRead().isInitialized());
+  ASSERT_LE(reader.diceKeyRead().maxError(), 2u);
+  // Correctable errors are given time to be removed, as measured by the clock
+  ASSERT_EQ(reader.isFinished(), reader.diceKeyRead().totalError() == 0);
+
+  simulatedNow += std::chrono::seconds(5);
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  ASSERT_EQ(timesRead, 2);
+  ASSERT_TRUE(reader.isFinished());
+}
+
+TEST(ReadDiceKeys, ReadsEachOfSeveralDiceKeysInOneImage) {
+  const cv::Mat grayscaleImage = loadTestImageAsGrayscale(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(grayscaleImage.empty());
+
+  // An image with only one DiceKey yields only one
+  const auto diceKeysInOriginal = readDiceKeys(grayscaleImage);
+  ASSERT_EQ(diceKeysInOriginal.size(), 1u);
+  ASSERT_LE(diceKeysInOriginal[0].diceKey.maxError(), 2u);
+
+  // Place two copies of the image side by side, separated by a white gap
+  const int gap = grayscaleImage.cols / 4;
+  cv::Mat twoDiceKeys(grayscaleImage.rows, 2 * grayscaleImage.cols + gap, CV_8UC1, cv::Scalar(255));
+  grayscaleImage.copyTo(twoDiceKeys(cv::Rect(0, 0, grayscaleImage.cols, grayscaleImage.rows)));
+  grayscaleImage.copyTo(twoDiceKeys(cv::Rect(grayscaleImage.cols + gap, 0, grayscaleImage.cols, grayscaleImage.rows)));
+
+  auto diceKeys = readDiceKeys(twoDiceKeys);
+  ASSERT_EQ(diceKeys.size(), 2u);
+  std::sort(diceKeys.begin(), diceKeys.end(), [](const DiceKeyReadFromImage &a, const DiceKeyReadFromImage &b) {
+    return a.bounds.center.x < b.bounds.center.x;
+  });
+  for (size_t i = 0; i < diceKeys.size(); i++) {
+    const auto &diceKey = diceKeys[i];
+    ASSERT_LE(diceKey.diceKey.maxError(), 2u);
+    ASSERT_EQ(diceKey.diceKey.toHumanReadableForm(true), diceKeysInOriginal[0].diceKey.toHumanReadableForm(true));
+    // Each key is bounded within its own copy of the image
+    const cv::Rect bounds = diceKey.bounds.boundingRect();
+    const int left = int(i) * (grayscaleImage.cols + gap);
+    ASSERT_GE(bounds.x, left - grayscaleImage.cols / 20);
+    ASSERT_LE(bounds.x + bounds.width, left + grayscaleImage.cols + grayscaleImage.cols / 20);
+    ASSERT_NEAR(diceKey.bounds.center.x - float(left), diceKeysInOriginal[0].bounds.center.x, 2.0f);
+    ASSERT_NEAR(diceKey.bounds.center.y, diceKeysInOriginal[0].bounds.center.y, 2.0f);
+  }
+}
+
+TEST(ReadDiceKeys, ReadsDiceKeysOfDifferentSizesInOneImage) {
+  const cv::Mat grayscaleImage = loadTestImageAsGrayscale(imageOfDiceKeyWithFewErrors);
+  ASSERT_FALSE(grayscaleImage.empty());
+  const auto diceKeysInOriginal = readDiceKeys(grayscaleImage);
+  ASSERT_EQ(diceKeysInOriginal.size(), 1u);
+
+  // Place the image beside a copy at 60% of its size, whose undoverlines have about
+  // a third of the area of the original's, so that the two can't share a modal area
+  cv::Mat smallerImage;
+  cv::resize(grayscaleImage, smallerImage, cv::Size(), 0.6, 0.6, cv::INTER_AREA);
+  const int gap = grayscaleImage.cols / 4;
+  cv::Mat twoDiceKeys(grayscaleImage.rows, grayscaleImage.cols + gap + smallerImage.cols, CV_8UC1, cv::Scalar(255));
+  grayscaleImage.copyTo(twoDiceKeys(cv::Rect(0, 0, grayscaleImage.cols, grayscaleImage.rows)));
+  smallerImage.copyTo(twoDiceKeys(cv::Rect(grayscaleImage.cols + gap, 0, smallerImage.cols, smallerImage.rows)));
+
+  auto diceKeys = readDiceKeys(twoDiceKeys);
+  ASSERT_EQ(diceKeys.size(), 2u);
+  std::sort(diceKeys.begin(), diceKeys.end(), [](const DiceKeyReadFromImage &a, const DiceKeyReadFromImage &b) {
+    return a.bounds.center.x < b.bounds.center.x;
+  });
+  for (const auto &diceKey : diceKeys) {
+    ASSERT_LE(diceKey.diceKey.maxError(), 2u);
+    ASSERT_EQ(diceKey.diceKey.toHumanReadableForm(true), diceKeysInOriginal[0].diceKey.toHumanReadableForm(true));
+  }
+  // The second key is the smaller copy
+  ASSERT_GE(diceKeys[1].bounds.center.x, float(grayscaleImage.cols + gap));
+  ASSERT_NEAR(diceKeys[1].bounds.size.width, 0.6f * diceKeys[0].bounds.size.width, 0.05f * diceKeys[0].bounds.size.width);
+}
+
+TEST(GeneratedImages, ReadBackAsTheKeyTheyAreLabeledWith) {
+  // A clean image, as generate-dicekey-images renders it with no distortions
+  std::mt19937 random(0);
+  GlyphCache glyphs;
+  const std::string key = randomKey(random);
+  const ImageOptions options;
+  const cv::Mat colorImage = renderImage(key, options, random, glyphs);
+  const std::string canonicalKey = DiceKeyFromString(key).rotateToCanonicalOrientation().toHumanReadableForm(true);
+
+  cv::Mat rgbaImage;
+  cv::cvtColor(colorImage, rgbaImage, cv::COLOR_BGR2RGBA);
+  DiceKeyImageProcessor reader;
+  reader.processRGBAImage(rgbaImage.cols, rgbaImage.rows, (uint32_t*) rgbaImage.data);
+  const DiceKey<FaceRead> &diceKey = reader.diceKeyRead();
+  ASSERT_TRUE(diceKey.isInitialized());
+  ASSERT_EQ(diceKey.totalError(), 0u);
+  ASSERT_EQ(diceKey.rotateToCanonicalOrientation().toHumanReadableForm(true), canonicalKey);
+
+  cv::Mat grayscaleImage;
+  cv::cvtColor(colorImage, grayscaleImage, cv::COLOR_BGR2GRAY);
+  const auto diceKeysRead = readDiceKeys(grayscaleImage);
+  ASSERT_EQ(diceKeysRead.size(), 1u);
+  ASSERT_EQ(diceKeysRead[0].diceKey.rotateToCanonicalOrientation().toHumanReadableForm(true), canonicalKey);
+}
+
 /**
  * Tests we hope to pass with algorithmic improvements
  * 
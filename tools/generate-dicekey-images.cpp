@@ -0,0 +1,175 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+Generate synthetic images of DiceKeys, labeled with the key each shows, for
+building benchmark corpora far larger than the photographs in the test image
+directory.
+
+Faces are rendered from the DiceKey specification: the undoverlines from the
+codes in letterIndexTimesSixPlusDigitIndexFaceWithUndoverlineCodes, laid out
+using FaceDimensionsFractional, and the letter and digit from the outlines of
+the Inconsolata font that the OCR recognizes.  The 5x5 grid of dice is then
+placed into a scene of the requested size with the requested distortions.
+
+Each distortion takes either a value or a range, min:max, from which a value
+is drawn for each image.  Random choices come from --seed, so the same command
+line always generates the same images.
+
+Each image is labeled with the key it shows, in human-readable form (letter,
+digit and orientation of each face, in the order they are laid out before the
+image is rotated), the same way the images in the test image directory are.
+Images written to a directory are named <key>-<index>.<format>.  Frames
+written to a raw frame container (see raw-frames.h) are labeled in a file
+beside it, named <container>.keys, with the key of each frame on its own line.
+
+Usage: generate-dicekey-images (--output <directory> | --raw <file>) [options]
+  --count N          the number of images (default 1)
+  --width W          image width in pixels (default 1280)
+  --height H         image height in pixels (default 720)
+  --format F         image file format, e.g. png or jpg (default png)
+  --key K            the key to render, in 75-character human-readable form
+                     (default: a new random key for each image)
+  --seed N           seed for the random choices (default 0)
+  --scale S          width of the DiceKey as a fraction of the image's shorter side (default 0.7)
+  --rotation D       rotation in degrees, clockwise (default 0)
+  --perspective P    how far to move each corner of the DiceKey, at most, as a
+                     fraction of its width, to skew it in perspective (default 0)
+  --blur SIGMA       standard deviation of a Gaussian blur, in pixels (default 0)
+  --noise SIGMA      standard deviation of per-pixel noise, in levels of 255 (default 0)
+  --glare G          brightness of a patch of glare, from 0 (none) to 1 (white) (default 0)
+  --clutter N        the number of shapes scattered behind the DiceKey, some of
+                     them resembling undoverlines (default 0)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <opencv2/imgcodecs.hpp>
+#include "graphics/cv.h"
+#include "render-dicekey-image.h"
+#include "raw-frames.h"
+
+static bool parseValueRange(const char *text, ValueRange &range) {
+  char *end;
+  range.min = range.max = strtod(text, &end);
+  if (end == text) {
+    return false;
+  }
+  if (*end == ':') {
+    const char *maxText = end + 1;
+    range.max = strtod(maxText, &end);
+    if (end == maxText) {
+      return false;
+    }
+  }
+  return *end == '\0' && range.max >= range.min;
+}
+
+int main(int argc, char **argv) {
+  std::string outputDirectory;
+  std::string rawFramesPath;
+  std::string format = "png";
+  std::string fixedKey;
+  size_t count = 1;
+  unsigned long seed = 0;
+  ImageOptions options;
+  for (int i = 1; i < argc; i++) {
+    const char *option = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    bool valid = value != NULL;
+    if (!valid) {
+      // Every option takes a value
+    } else if (strcmp(option, "--output") == 0) {
+      outputDirectory = value;
+    } else if (strcmp(option, "--raw") == 0) {
+      rawFramesPath = value;
+    } else if (strcmp(option, "--count") == 0) {
+      count = size_t(strtoull(value, NULL, 10));
+    } else if (strcmp(option, "--width") == 0) {
+      options.width = atoi(value);
+      valid = options.width > 0;
+    } else if (strcmp(option, "--height") == 0) {
+      options.height = atoi(value);
+      valid = options.height > 0;
+    } else if (strcmp(option, "--format") == 0) {
+      format = value;
+    } else if (strcmp(option, "--key") == 0) {
+      fixedKey = value;
+      valid = isValidKey(fixedKey);
+    } else if (strcmp(option, "--seed") == 0) {
+      seed = strtoul(value, NULL, 10);
+    } else if (strcmp(option, "--scale") == 0) {
+      valid = parseValueRange(value, options.scale) && options.scale.min > 0;
+    } else if (strcmp(option, "--rotation") == 0) {
+      valid = parseValueRange(value, options.rotation);
+    } else if (strcmp(option, "--perspective") == 0) {
+      valid = parseValueRange(value, options.perspective) && options.perspective.min >= 0;
+    } else if (strcmp(option, "--blur") == 0) {
+      valid = parseValueRange(value, options.blur) && options.blur.min >= 0;
+    } else if (strcmp(option, "--noise") == 0) {
+      valid = parseValueRange(value, options.noise) && options.noise.min >= 0;
+    } else if (strcmp(option, "--glare") == 0) {
+      valid = parseValueRange(value, options.glare) && options.glare.min >= 0 && options.glare.max <= 1;
+    } else if (strcmp(option, "--clutter") == 0) {
+      valid = parseValueRange(value, options.clutter) && options.clutter.min >= 0;
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      fprintf(stderr, "Invalid option %s%s%s\n", option, value ? " " : "", value ? value : "");
+      return 2;
+    }
+    i++;
+  }
+  if (outputDirectory.empty() == rawFramesPath.empty()) {
+    fprintf(stderr, "Usage: %s (--output <directory> | --raw <file>) [--count N] [--width W] [--height H] [--format F] [--key K] [--seed N]\n"
+      "  [--scale S] [--rotation D] [--perspective P] [--blur SIGMA] [--noise SIGMA] [--glare G] [--clutter N]\n"
+      "Distortions take a value or a range, min:max\n", argv[0]);
+    return 2;
+  }
+
+  std::unique_ptr<RawFramesWriter> rawFrames;
+  FILE *rawFrameKeys = NULL;
+  if (!rawFramesPath.empty()) {
+    rawFrames.reset(new RawFramesWriter(rawFramesPath));
+    rawFrameKeys = fopen((rawFramesPath + ".keys").c_str(), "w");
+    if (!rawFrames->isOpen() || rawFrameKeys == NULL) {
+      fprintf(stderr, "Could not create %s\n", rawFramesPath.c_str());
+      return 1;
+    }
+  }
+
+  std::mt19937 random(seed);
+  GlyphCache glyphs;
+  for (size_t index = 0; index < count; index++) {
+    const std::string key = fixedKey.empty() ? randomKey(random) : fixedKey;
+    const cv::Mat image = renderImage(key, options, random, glyphs);
+    bool written;
+    if (rawFrames != NULL) {
+      cv::Mat rgbaImage;
+      cv::cvtColor(image, rgbaImage, cv::COLOR_BGR2RGBA);
+      written = rawFrames->write(uint32_t(rgbaImage.cols), uint32_t(rgbaImage.rows), rgbaImage.data) &&
+        fprintf(rawFrameKeys, "%s\n", key.c_str()) > 0;
+    } else {
+      char indexSuffix[32];
+      snprintf(indexSuffix, sizeof(indexSuffix), "-%06zu.", index);
+      written = cv::imwrite(outputDirectory + "/" + key + indexSuffix + format, image);
+    }
+    if (!written) {
+      fprintf(stderr, "Could not write image %zu\n", index);
+      return 1;
+    }
+  }
+
+  if (rawFrames != NULL) {
+    const bool closed = rawFrames->close() && fclose(rawFrameKeys) == 0;
+    if (!closed) {
+      fprintf(stderr, "Could not write %s\n", rawFramesPath.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,148 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+/*
+A container of raw RGBA frames, as captured from a camera, for replaying a
+scanning session without decoding images.
+
+The file starts with the magic bytes "DKRF" and a version (uint32), followed
+by each frame: its width and height (uint32) and then width * height RGBA
+pixels, 4 bytes each, row by row with no padding.  Integers are little-endian.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <utility>
+#include <string>
+#include <vector>
+
+const char RawFramesMagic[4] = {'D', 'K', 'R', 'F'};
+const uint32_t RawFramesVersion = 1;
+// The bytes of the container's magic and version, and of each frame's width and height
+const uint64_t RawFramesHeaderSize = 8;
+const uint64_t RawFrameHeaderSize = 8;
+
+struct RawFrame {
+  uint32_t width;
+  uint32_t height;
+  // width * height pixels, each in RGBA byte order
+  std::vector<uint32_t> rgba;
+};
+
+inline bool rawFramesWriteUint32(FILE *file, uint32_t value) {
+  const unsigned char bytes[4] = {
+    (unsigned char)(value & 0xFF), (unsigned char)((value >> 8) & 0xFF),
+    (unsigned char)((value >> 16) & 0xFF), (unsigned char)(value >> 24)
+  };
+  return fwrite(bytes, 1, 4, file) == 4;
+}
+
+inline bool rawFramesReadUint32(FILE *file, uint32_t &value) {
+  unsigned char bytes[4];
+  if (fread(bytes, 1, 4, file) != 4) {
+    return false;
+  }
+  value = uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+  return true;
+}
+
+/*
+Writes frames to a raw frame container, one at a time.
+*/
+class RawFramesWriter {
+  FILE *file;
+public:
+  explicit RawFramesWriter(const std::string &path) : file(fopen(path.c_str(), "wb")) {
+    if (file != NULL && !(
+      fwrite(RawFramesMagic, 1, sizeof(RawFramesMagic), file) == sizeof(RawFramesMagic) &&
+      rawFramesWriteUint32(file, RawFramesVersion)
+    )) {
+      fclose(file);
+      file = NULL;
+    }
+  }
+  ~RawFramesWriter() { close(); }
+  RawFramesWriter(const RawFramesWriter&) = delete;
+  RawFramesWriter& operator=(const RawFramesWriter&) = delete;
+
+  bool isOpen() const { return file != NULL; }
+
+  // The pixels are bytes in RGBA order, width * 4 bytes per row
+  bool write(uint32_t width, uint32_t height, const void *rgba) {
+    return file != NULL &&
+      rawFramesWriteUint32(file, width) &&
+      rawFramesWriteUint32(file, height) &&
+      fwrite(rgba, 4, size_t(width) * size_t(height), file) == size_t(width) * size_t(height);
+  }
+
+  bool close() {
+    const bool closed = file != NULL && fclose(file) == 0;
+    file = NULL;
+    return closed;
+  }
+};
+
+enum class RawFramesReadResult {
+  // Every frame in the container was read
+  Read,
+  // The file could not be opened or is not a raw frame container
+  NotRawFrames,
+  // The container ends partway through a frame, or has a frame with no pixels
+  Corrupt
+};
+
+/*
+Read every frame in a raw frame container.  If the container is corrupt, the
+frames before the corrupt one are still appended to frames.
+*/
+inline RawFramesReadResult readRawFrames(const std::string &path, std::vector<RawFrame> &frames) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL) {
+    return RawFramesReadResult::NotRawFrames;
+  }
+  char magic[4];
+  uint32_t version = 0;
+  if (!(
+    fread(magic, 1, 4, file) == 4 && memcmp(magic, RawFramesMagic, 4) == 0 &&
+    rawFramesReadUint32(file, version) && version == RawFramesVersion
+  )) {
+    fclose(file);
+    return RawFramesReadResult::NotRawFrames;
+  }
+  // The pixels of each frame are allocated only once they are known to fit in
+  // what is left of the file, so that a corrupt frame size can't exhaust memory
+  struct stat status;
+  if (fstat(fileno(file), &status) != 0) {
+    fclose(file);
+    return RawFramesReadResult::Corrupt;
+  }
+  uint64_t bytesLeft = uint64_t(status.st_size) - RawFramesHeaderSize;
+  bool ok = true;
+  int nextByte;
+  // Stop where the file ends, which must be between frames
+  while (ok && (nextByte = fgetc(file)) != EOF) {
+    ungetc(nextByte, file);
+    RawFrame frame;
+    ok = rawFramesReadUint32(file, frame.width) && rawFramesReadUint32(file, frame.height) &&
+      frame.width > 0 && frame.height > 0;
+    if (ok) {
+      bytesLeft -= std::min(bytesLeft, RawFrameHeaderSize);
+      ok = uint64_t(frame.width) * uint64_t(frame.height) <= bytesLeft / 4;
+    }
+    if (ok) {
+      frame.rgba.resize(size_t(frame.width) * size_t(frame.height));
+      ok = fread(frame.rgba.data(), 4, frame.rgba.size(), file) == frame.rgba.size();
+      bytesLeft -= 4 * uint64_t(frame.rgba.size());
+    }
+    if (ok) {
+      frames.push_back(std::move(frame));
+    }
+  }
+  ok = ok && !ferror(file);
+  fclose(file);
+  return ok ? RawFramesReadResult::Read : RawFramesReadResult::Corrupt;
+}
@@ -0,0 +1,516 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+Read the DiceKey in each of a batch of still images, across a pool of worker
+threads, and write one line of JSON (NDJSON) per image to stdout, in the order
+the images were given.
+
+Each worker decodes an image and then reads it, so that while some workers
+decode, others read.  Images are the unit of parallelism: with more than one
+worker, the library's own parallel stages (see thread-pool.hpp) are limited to
+the thread calling them, so workers do not compete for the shared pool.
+
+The inputs are any mix of image files, directories (every file in the
+directory with an image's extension, in the order of their names), glob patterns (quoted, so that
+they are expanded here rather than by the shell), and "-", to read a list of
+files, one per line, from stdin.
+
+Each line of output is a JSON object:
+  {"file": F, "key": K, "totalError": E, "maxError": M, "decodeMicroseconds": D, "stats": S}
+where K is the key read, in human-readable form rotated to its canonical
+orientation (or null if no key was read), and S has the time spent in each
+stage of reading and the counts from each (see FrameStats).  An image that
+cannot be decoded is reported as {"file": F, "error": "could not decode"}.
+
+With --multi, every DiceKey in each image is read (see readDiceKeys in
+read-dicekey.hpp), as when several boxes are in view at once, and "key",
+"totalError", and "maxError" are replaced by:
+  "keys": [{"key": K, "totalError": E, "maxError": M, "bounds": {"x": X, "y": Y, "width": W, "height": H}}, ...]
+where the bounds are the rectangle of the image, in pixels, containing the key's
+grid of faces, from which the key's box can be cropped.
+
+With --video, the inputs are instead video files (and directories are searched
+for videos), each scanned as a camera would be until a DiceKey is read (see
+scan-video.h), with one worker per video.  Each line of output is then:
+  {"file": F, "finished": B, "frameIndex": I, "timestampMilliseconds": T, "framesDecoded": N,
+   "framesRead": N, "key": K, "totalError": E, "maxError": M, "readMicroseconds": R,
+   "waitForDecodeMicroseconds": W}
+where I and T give the frame after which the key was read (or the last frame
+read, if B is false).  A video that cannot be opened is reported as
+{"file": F, "error": "could not open"}.
+
+An input whose reading fails with an exception (e.g., a cv::Exception) is
+reported as {"file": F, "error": E}, with the exception's message, and the
+rest of the inputs are still read.
+
+Once every input has been read, a summary of the throughput is written to stderr.
+
+Usage: read-dicekey-cli [options] <file|directory|glob|->...
+  --jobs N    the number of worker threads (default: the number of hardware threads)
+  --rectify   correct perspective tilt before reading faces
+  --video     read video files rather than images (if built with DICEKEY_VIDEO_INPUT)
+  --multi     read every DiceKey in each image (not with --rectify or --video)
+
+Exits with 0 if every input could be decoded and read, 1 if any could not (or
+there were none), and 2 on a usage error.
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+#include "graphics/cv.h"
+#include "thread-pool.hpp"
+#include "json.h"
+#include "read-dicekey.hpp"
+#ifdef DICEKEY_VIDEO_INPUT
+#include "scan-video.h"
+#endif
+
+namespace JsonKeys {
+  namespace ImageRead {
+    const char file[] = "file";
+    const char error[] = "error";
+    const char key[] = "key";
+    const char totalError[] = "totalError";
+    const char maxError[] = "maxError";
+    const char decodeMicroseconds[] = "decodeMicroseconds";
+    const char stats[] = "stats";
+    const char keys[] = "keys";
+    const char bounds[] = "bounds";
+    const char x[] = "x";
+    const char y[] = "y";
+    const char width[] = "width";
+    const char height[] = "height";
+    const char finished[] = "finished";
+    const char frameIndex[] = "frameIndex";
+    const char timestampMilliseconds[] = "timestampMilliseconds";
+    const char framesDecoded[] = "framesDecoded";
+    const char framesRead[] = "framesRead";
+    const char readMicroseconds[] = "readMicroseconds";
+    const char waitForDecodeMicroseconds[] = "waitForDecodeMicroseconds";
+  };
+};
+
+// How many images workers may read ahead of the next one to be written,
+// per worker, which bounds the results held in memory
+const size_t ResultsBufferedPerWorker = 4;
+
+static bool isDirectory(const std::string &path) {
+  struct stat status;
+  return stat(path.c_str(), &status) == 0 && (status.st_mode & S_IFDIR) != 0;
+}
+
+static const char* const ImageExtensions[] = { "jpg", "jpeg", "png", "bmp", "tif", "tiff", "webp", "pgm", "ppm", NULL };
+static const char* const VideoExtensions[] = { "mp4", "m4v", "mov", "avi", "mkv", "webm", NULL };
+
+static bool hasExtension(const std::string &path, const char* const *extensions) {
+  const size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = path.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  for (; *extensions != NULL; extensions++) {
+    if (extension == *extensions) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void appendInput(const std::string &input, const char* const *extensionsInDirectories, std::vector<std::string> &paths) {
+  if (input == "-") {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      if (!line.empty() && line[line.size() - 1] == '\r') {
+        line.erase(line.size() - 1);
+      }
+      if (!line.empty()) {
+        paths.push_back(line);
+      }
+    }
+  } else if (isDirectory(input)) {
+    // Other files in the directory, such as a README, are not reported as inputs that could not be decoded
+    std::vector<cv::String> matches;
+    cv::glob(input + "/*", matches, false);
+    std::sort(matches.begin(), matches.end());
+    for (const cv::String &match : matches) {
+      if (hasExtension(match, extensionsInDirectories)) {
+        paths.push_back(match);
+      }
+    }
+  } else if (input.find_first_of("*?[") != std::string::npos) {
+    std::vector<cv::String> matches;
+    cv::glob(input, matches, false);
+    std::sort(matches.begin(), matches.end());
+    paths.insert(paths.end(), matches.begin(), matches.end());
+  } else {
+    paths.push_back(input);
+  }
+}
+
+// Append a string in quotes, escaping the characters JSON requires to be escaped
+static void appendJsonString(std::string &json, const std::string &value) {
+  json += '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      json += '\\';
+      json += c;
+    } else if ((unsigned char) c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned) (unsigned char) c);
+      json += escaped;
+    } else {
+      json += c;
+    }
+  }
+  json += '"';
+}
+
+struct InputResult {
+  bool done = false;
+  bool decoded = false;
+  uint64_t frames = 0;
+  uint64_t pixels = 0;
+  unsigned keysRead = 0;
+  unsigned keysReadWithoutError = 0;
+  std::string json;
+};
+
+static void appendKeyRead(std::string &json, const DiceKey<FaceRead> &diceKey) {
+  jsonAppendKey(json, JsonKeys::ImageRead::key);
+  if (!diceKey.isInitialized()) {
+    json += "null";
+    return;
+  }
+  appendJsonString(json, diceKey.rotateToCanonicalOrientation().toHumanReadableForm(true));
+  json += ", ";
+  jsonAppendKey(json, JsonKeys::ImageRead::totalError);
+  jsonAppendUnsigned(json, diceKey.totalError());
+  json += ", ";
+  jsonAppendKey(json, JsonKeys::ImageRead::maxError);
+  jsonAppendUnsigned(json, diceKey.maxError());
+}
+
+// Append the rectangle of the image containing a key's bounds
+static void appendBounds(std::string &json, const cv::RotatedRect &bounds, const cv::Size &imageSize) {
+  const cv::Rect rect = bounds.boundingRect() & cv::Rect(cv::Point(0, 0), imageSize);
+  jsonAppendKey(json, JsonKeys::ImageRead::bounds);
+  json += '{';
+  jsonAppendKey(json, JsonKeys::ImageRead::x);
+  jsonAppendUnsigned(json, unsigned(rect.x));
+  json += ", ";
+  jsonAppendKey(json, JsonKeys::ImageRead::y);
+  jsonAppendUnsigned(json, unsigned(rect.y));
+  json += ", ";
+  jsonAppendKey(json, JsonKeys::ImageRead::width);
+  jsonAppendUnsigned(json, unsigned(rect.width));
+  json += ", ";
+  jsonAppendKey(json, JsonKeys::ImageRead::height);
+  jsonAppendUnsigned(json, unsigned(rect.height));
+  json += '}';
+}
+
+/*
+Decode and read one image, describing the result as a line of JSON.
+*/
+static void readImage(const std::string &path, bool rectify, bool multi, InputResult &result) {
+  result.json.clear();
+  result.json += '{';
+  jsonAppendKey(result.json, JsonKeys::ImageRead::file);
+  appendJsonString(result.json, path);
+
+  const std::chrono::steady_clock::time_point decodeStart = std::chrono::steady_clock::now();
+  const cv::Mat colorImage = cv::imread(path, cv::IMREAD_COLOR);
+  if (colorImage.empty()) {
+    result.json += ", ";
+    jsonAppendKey(result.json, JsonKeys::ImageRead::error);
+    result.json += "\"could not decode\"}";
+    return;
+  }
+  cv::Mat grayscaleImage;
+  cv::cvtColor(colorImage, grayscaleImage, cv::COLOR_BGR2GRAY);
+  const double decodeMicroseconds =
+    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - decodeStart).count();
+  result.decoded = true;
+  result.frames = 1;
+  result.pixels = uint64_t(grayscaleImage.total());
+
+  if (multi) {
+    FrameStats frameStats;
+    const std::vector<DiceKeyReadFromImage> diceKeys = readDiceKeys(grayscaleImage, false, &frameStats);
+    result.json += ", ";
+    jsonAppendKey(result.json, JsonKeys::ImageRead::keys);
+    result.json += '[';
+    for (size_t i = 0; i < diceKeys.size(); i++) {
+      result.json += i == 0 ? "{" : ", {";
+      appendKeyRead(result.json, diceKeys[i].diceKey);
+      result.json += ", ";
+      appendBounds(result.json, diceKeys[i].bounds, grayscaleImage.size());
+      result.json += '}';
+      result.keysRead++;
+      result.keysReadWithoutError += diceKeys[i].diceKey.totalError() == 0 ? 1 : 0;
+    }
+    result.json += ']';
+    result.json += ", ";
+    jsonAppendKey(result.json, JsonKeys::ImageRead::decodeMicroseconds);
+    jsonAppendFloat(result.json, float(decodeMicroseconds));
+    result.json += ", ";
+    jsonAppendKey(result.json, JsonKeys::ImageRead::stats);
+    frameStats.appendJson(result.json);
+    result.json += '}';
+    return;
+  }
+
+  // Each image is a separate still, so each gets a processor of its own, rather
+  // than having its faces merged with those read from the images before it
+  DiceKeyImageProcessor processor;
+  processor.setFrameStatsCollection(true);
+  processor.setPerspectiveRectification(rectify);
+  processor.processImage(grayscaleImage.cols, grayscaleImage.rows, grayscaleImage.step, grayscaleImage.data);
+  const DiceKey<FaceRead> &diceKey = processor.diceKeyRead();
+  result.keysRead = diceKey.isInitialized() ? 1 : 0;
+  result.keysReadWithoutError = diceKey.isInitialized() && diceKey.totalError() == 0 ? 1 : 0;
+
+  result.json += ", ";
+  appendKeyRead(result.json, diceKey);
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::decodeMicroseconds);
+  jsonAppendFloat(result.json, float(decodeMicroseconds));
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::stats);
+  processor.frameStatsOfLastImage().appendJson(result.json);
+  result.json += '}';
+}
+
+/*
+Describe an input that could not be read as a line of JSON, discarding anything
+already recorded from reading it.
+*/
+static void describeError(const std::string &path, const std::string &error, InputResult &result) {
+  result = InputResult();
+  result.json += '{';
+  jsonAppendKey(result.json, JsonKeys::ImageRead::file);
+  appendJsonString(result.json, path);
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::error);
+  appendJsonString(result.json, error);
+  result.json += '}';
+}
+
+#ifdef DICEKEY_VIDEO_INPUT
+/*
+Scan a video until a DiceKey is read from it, describing the result as a line of JSON.
+*/
+static void readVideo(const std::string &path, bool rectify, InputResult &result) {
+  result.json.clear();
+  result.json += '{';
+  jsonAppendKey(result.json, JsonKeys::ImageRead::file);
+  appendJsonString(result.json, path);
+
+  DiceKeyImageProcessor processor;
+  processor.setPerspectiveRectification(rectify);
+  const VideoScanResult scan = scanVideo(path, processor);
+  result.json += ", ";
+  if (!scan.opened) {
+    jsonAppendKey(result.json, JsonKeys::ImageRead::error);
+    result.json += "\"could not open\"}";
+    return;
+  }
+  result.decoded = true;
+  result.frames = scan.framesRead;
+  const DiceKey<FaceRead> &diceKey = processor.diceKeyRead();
+  result.keysRead = diceKey.isInitialized() ? 1 : 0;
+  result.keysReadWithoutError = diceKey.isInitialized() && diceKey.totalError() == 0 ? 1 : 0;
+
+  jsonAppendKey(result.json, JsonKeys::ImageRead::finished);
+  result.json += scan.finished ? "true" : "false";
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::frameIndex);
+  jsonAppendUnsigned(result.json, unsigned(scan.frameIndex));
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::timestampMilliseconds);
+  jsonAppendFloat(result.json, float(scan.timestampMilliseconds));
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::framesDecoded);
+  jsonAppendUnsigned(result.json, unsigned(scan.framesDecoded));
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::framesRead);
+  jsonAppendUnsigned(result.json, unsigned(scan.framesRead));
+  result.json += ", ";
+  appendKeyRead(result.json, diceKey);
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::readMicroseconds);
+  jsonAppendFloat(result.json, float(scan.readMicroseconds));
+  result.json += ", ";
+  jsonAppendKey(result.json, JsonKeys::ImageRead::waitForDecodeMicroseconds);
+  jsonAppendFloat(result.json, float(scan.waitForDecodeMicroseconds));
+  result.json += '}';
+}
+#endif
+
+int main(int argc, char **argv) {
+  unsigned int jobs = std::thread::hardware_concurrency();
+  bool rectify = false;
+  bool video = false;
+  bool multi = false;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      jobs = unsigned(strtoul(argv[++i], NULL, 10));
+    } else if (strcmp(argv[i], "--rectify") == 0) {
+      rectify = true;
+    } else if (strcmp(argv[i], "--video") == 0) {
+#ifdef DICEKEY_VIDEO_INPUT
+      video = true;
+#else
+      fprintf(stderr, "This build cannot read video (OpenCV's videoio module was not found)\n");
+      return 2;
+#endif
+    } else if (strcmp(argv[i], "--multi") == 0) {
+      multi = true;
+    } else if (strncmp(argv[i], "--", 2) == 0) {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 2;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty()) {
+    fprintf(stderr, "Usage: %s [--jobs N] [--rectify] [--video] [--multi] <file|directory|glob|->...\n", argv[0]);
+    return 2;
+  }
+  if (multi && (rectify || video)) {
+    fprintf(stderr, "--multi reads still images without rectification, so cannot be combined with --rectify or --video\n");
+    return 2;
+  }
+  if (jobs == 0) {
+    jobs = 1;
+  }
+
+  std::vector<std::string> paths;
+  for (const std::string &input : inputs) {
+    appendInput(input, video ? VideoExtensions : ImageExtensions, paths);
+  }
+  if (paths.empty()) {
+    fprintf(stderr, "Nothing to read\n");
+    return 1;
+  }
+  if (jobs > 1) {
+    setMaxConcurrency(1);
+  }
+  if (size_t(jobs) > paths.size()) {
+    jobs = unsigned(paths.size());
+  }
+
+  // Workers claim inputs in order, but no further than the buffer's size
+  // ahead of the next input to be written, and write results into its slot
+  const size_t bufferSize = size_t(jobs) * ResultsBufferedPerWorker;
+  std::vector<InputResult> results(bufferSize);
+  std::mutex mutex;
+  std::condition_variable resultReady;
+  std::condition_variable slotFree;
+  size_t nextToClaim = 0;
+  size_t nextToWrite = 0;
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned int worker = 0; worker < jobs; worker++) {
+    workers.push_back(std::thread([&]() {
+      InputResult result;
+      while (true) {
+        size_t index;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          slotFree.wait(lock, [&]() { return nextToClaim >= paths.size() || nextToClaim < nextToWrite + bufferSize; });
+          if (nextToClaim >= paths.size()) {
+            return;
+          }
+          index = nextToClaim++;
+        }
+        result = InputResult();
+        // An exception reading one input is reported in that input's slot, so that
+        // the rest of the batch is still read and written in order
+        try {
+#ifdef DICEKEY_VIDEO_INPUT
+          if (video) {
+            readVideo(paths[index], rectify, result);
+          } else
+#endif
+          readImage(paths[index], rectify, multi, result);
+        } catch (const std::exception &exception) {
+          // Including cv::Exception, which derives from std::exception
+          describeError(paths[index], exception.what(), result);
+        } catch (...) {
+          describeError(paths[index], "unknown exception", result);
+        }
+        result.done = true;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          std::swap(results[index % bufferSize], result);
+        }
+        resultReady.notify_all();
+      }
+    }));
+  }
+
+  size_t decoded = 0;
+  size_t keysRead = 0;
+  size_t keysReadWithoutError = 0;
+  uint64_t frames = 0;
+  uint64_t pixels = 0;
+  InputResult result;
+  for (; nextToWrite < paths.size(); ) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      InputResult &slot = results[nextToWrite % bufferSize];
+      resultReady.wait(lock, [&]() { return slot.done; });
+      std::swap(slot, result);
+      slot.done = false;
+      nextToWrite++;
+    }
+    slotFree.notify_all();
+    fwrite(result.json.data(), 1, result.json.size(), stdout);
+    fputc('\n', stdout);
+    decoded += result.decoded ? 1 : 0;
+    keysRead += result.keysRead;
+    keysReadWithoutError += result.keysReadWithoutError;
+    frames += result.frames;
+    pixels += result.pixels;
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  fflush(stdout);
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (video) {
+    fprintf(stderr,
+      "%zu videos (%zu opened, %zu keys read, %zu without error) in %.3f s with %u workers: "
+      "%.1f frames/s\n",
+      paths.size(), decoded, keysRead, keysReadWithoutError, seconds, jobs,
+      seconds > 0 ? double(frames) / seconds : 0
+    );
+  } else {
+    fprintf(stderr,
+      "%zu images (%zu decoded, %zu keys read, %zu without error) in %.3f s with %u workers: "
+      "%.1f images/s, %.1f megapixels/s\n",
+      paths.size(), decoded, keysRead, keysReadWithoutError, seconds, jobs,
+      seconds > 0 ? double(frames) / seconds : 0,
+      seconds > 0 ? double(pixels) / 1e6 / seconds : 0
+    );
+  }
+  return decoded == paths.size() ? 0 : 1;
+}
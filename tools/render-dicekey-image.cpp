@@ -0,0 +1,426 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "../lib-dicekey/externally-generated/dicekey-face-specification.h"
+#include "render-dicekey-image.h"
+
+// The layout of the dice, in units of the width of a face's printed area
+const float DiePitch = 1.6f;
+const float DieSize = 1.3f;
+const float DieCornerRadius = 0.15f;
+const float BoxMargin = 0.6f;
+const float KeySizeInFaceWidths = 5 * DiePitch + 2 * BoxMargin;
+
+// Gray levels
+const unsigned char DieWhite = 235;
+const unsigned char InkBlack = 25;
+const unsigned char BoxBlack = 40;
+
+// Images are drawn at this multiple of their size, and then reduced, to smooth their edges
+const int Supersampling = 2;
+
+std::string randomKey(std::mt19937 &random) {
+  std::string letters(FaceLetters);
+  std::shuffle(letters.begin(), letters.end(), random);
+  std::uniform_int_distribution<int> digitIndex(0, int(strlen(FaceDigits)) - 1);
+  std::uniform_int_distribution<int> orientationIndex(0, 3);
+  std::string key;
+  for (char letter : letters) {
+    key += letter;
+    key += FaceDigits[digitIndex(random)];
+    key += FaceRotationLetters[orientationIndex(random)];
+  }
+  return key;
+}
+
+static const FaceSpecification* faceSpecification(char letter, char digit) {
+  const char *letterPosition = letter == '\0' ? NULL : strchr(FaceLetters, letter);
+  const char *digitPosition = digit == '\0' ? NULL : strchr(FaceDigits, digit);
+  if (letterPosition == NULL || digitPosition == NULL) {
+    return NULL;
+  }
+  return &letterIndexTimesSixPlusDigitIndexFaceWithUndoverlineCodes[
+    (letterPosition - FaceLetters) * 6 + (digitPosition - FaceDigits)
+  ];
+}
+
+bool isValidKey(const std::string &key) {
+  if (key.size() != 3 * 25) {
+    return false;
+  }
+  for (size_t i = 0; i < key.size(); i += 3) {
+    if (faceSpecification(key[i], key[i + 1]) == NULL || key[i + 2] == '\0' || strchr(FaceRotationLetters, key[i + 2]) == NULL) {
+      return false;
+    }
+  }
+  return true;
+}
+
+cv::Mat GlyphCache::fill(const OcrFont &font, const OcrAlphabet &alphabet, size_t characterIndex) {
+  const int width = font.outlineCharWidthInPixels;
+  const int height = font.outlineCharHeightInPixels;
+  cv::Mat glyph(height, width, CV_8UC1, cv::Scalar(0));
+  for (const UShortPoint &point : alphabet.characters[characterIndex].outlinePoints) {
+    if (point.x < width && point.y < height) {
+      glyph.at<uchar>(point.y, point.x) = 255;
+    }
+  }
+
+  // Flood fill each 4-connected region not on the outline, and keep it if most
+  // of its pixels fall where the OCR penalizes seeing white (i.e., expects ink)
+  const size_t numberOfCharacters = alphabet.characters.size();
+  std::vector<bool> visited(size_t(width) * size_t(height), false);
+  std::vector<cv::Point> region;
+  std::vector<cv::Point> toVisit;
+  for (int startY = 0; startY < height; startY++) {
+    for (int startX = 0; startX < width; startX++) {
+      if (visited[size_t(startY) * width + startX] || glyph.at<uchar>(startY, startX) != 0) {
+        continue;
+      }
+      region.clear();
+      toVisit.assign(1, cv::Point(startX, startY));
+      visited[size_t(startY) * width + startX] = true;
+      size_t pixelsExpectedToBeInk = 0;
+      while (!toVisit.empty()) {
+        const cv::Point p = toVisit.back();
+        toVisit.pop_back();
+        region.push_back(p);
+        const int ocrX = p.x * font.ocrCharWidthInPixels / width;
+        const int ocrY = p.y * font.ocrCharHeightInPixels / height;
+        const unsigned char penaltyEntry =
+          alphabet.penalties[(size_t(ocrY) * font.ocrCharWidthInPixels + ocrX) * numberOfCharacters + characterIndex];
+        if ((penaltyEntry >> 4) > (penaltyEntry & 0xf)) {
+          pixelsExpectedToBeInk++;
+        }
+        const cv::Point neighbors[4] = {
+          cv::Point(p.x - 1, p.y), cv::Point(p.x + 1, p.y), cv::Point(p.x, p.y - 1), cv::Point(p.x, p.y + 1)
+        };
+        for (const cv::Point &n : neighbors) {
+          if (n.x >= 0 && n.y >= 0 && n.x < width && n.y < height &&
+              !visited[size_t(n.y) * width + n.x] && glyph.at<uchar>(n.y, n.x) == 0) {
+            visited[size_t(n.y) * width + n.x] = true;
+            toVisit.push_back(n);
+          }
+        }
+      }
+      if (2 * pixelsExpectedToBeInk > region.size()) {
+        for (const cv::Point &p : region) {
+          glyph.at<uchar>(p.y, p.x) = 255;
+        }
+      }
+    }
+  }
+  return glyph;
+}
+
+bool GlyphCache::find(const OcrAlphabet &alphabet, char character, size_t &characterIndex) {
+  for (characterIndex = 0; characterIndex < alphabet.characters.size(); characterIndex++) {
+    if (alphabet.characters[characterIndex].character == character) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const cv::Mat& GlyphCache::get(char character) {
+  auto found = glyphs.find(character);
+  if (found != glyphs.end()) {
+    return found->second;
+  }
+  const OcrFont &font = *getFont();
+  size_t characterIndex;
+  cv::Mat &glyph = glyphs[character];
+  if (find(font.letters, character, characterIndex)) {
+    glyph = fill(font, font.letters, characterIndex);
+  } else if (find(font.digits, character, characterIndex)) {
+    glyph = fill(font, font.digits, characterIndex);
+  }
+  return glyph;
+}
+
+// Fill a rectangle given in units of the face's width, on a face pixelsPerFaceWidth wide
+static void fillFaceRect(cv::Mat &face, float pixelsPerFaceWidth, float left, float top, float width, float height, unsigned char gray) {
+  const cv::Point topLeft(int(round(left * pixelsPerFaceWidth)), int(round(top * pixelsPerFaceWidth)));
+  const cv::Point bottomRight(int(round((left + width) * pixelsPerFaceWidth)) - 1, int(round((top + height) * pixelsPerFaceWidth)) - 1);
+  cv::rectangle(face, topLeft, bottomRight, cv::Scalar(gray), cv::FILLED);
+}
+
+/*
+Draw an undoverline: a black bar with a white dot for each bit of its 11-bit
+coding that is 1, from the most significant bit at the left edge of the
+upright face (always 1, so that a reader can tell which end is which), then
+the bit that is 1 for an overline, the 8 bits of the letter and digit's code,
+and an always-0 bit at the right edge.
+*/
+static void drawUndoverline(cv::Mat &face, float pixelsPerFaceWidth, bool isOverline, unsigned char letterDigitEncoding) {
+  const float top = isOverline ? FaceDimensionsFractional::overlineTop : FaceDimensionsFractional::underlineTop;
+  const float dotTop = isOverline ? FaceDimensionsFractional::overlineDotTop : FaceDimensionsFractional::underlineDotTop;
+  fillFaceRect(face, pixelsPerFaceWidth,
+    FaceDimensionsFractional::undoverlineLeftEdge, top,
+    FaceDimensionsFractional::undoverlineLength, FaceDimensionsFractional::undoverlineThickness,
+    InkBlack);
+  const unsigned int binaryCoding = (1u << 10) | ((isOverline ? 1u : 0u) << 9) | (unsigned(letterDigitEncoding) << 1);
+  for (int dot = 0; dot < NumberOfDotsInUndoverline; dot++) {
+    if ((binaryCoding >> (NumberOfDotsInUndoverline - 1 - dot)) & 1) {
+      const float dotCenter = FaceDimensionsFractional::undoverlineLeftEdge +
+        FaceDimensionsFractional::dotCentersAsFractionOfUndoverline[dot] * FaceDimensionsFractional::undoverlineLength;
+      fillFaceRect(face, pixelsPerFaceWidth,
+        dotCenter - FaceDimensionsFractional::undoverlineDotWidth / 2, dotTop,
+        FaceDimensionsFractional::undoverlineDotWidth, FaceDimensionsFractional::undoverlineDotHeight,
+        DieWhite);
+    }
+  }
+}
+
+// Draw a glyph filling the box given in units of the face's width
+static void drawGlyph(cv::Mat &face, float pixelsPerFaceWidth, const cv::Mat &glyph, float left, float top, float width, float height) {
+  if (glyph.empty()) {
+    return;
+  }
+  const cv::Rect box(
+    int(round(left * pixelsPerFaceWidth)), int(round(top * pixelsPerFaceWidth)),
+    std::max(1, int(round(width * pixelsPerFaceWidth))), std::max(1, int(round(height * pixelsPerFaceWidth)))
+  );
+  cv::Mat inkCoverage;
+  cv::resize(glyph, inkCoverage, box.size(), 0, 0, cv::INTER_AREA);
+  for (int y = 0; y < box.height; y++) {
+    const uchar *coverageRow = inkCoverage.ptr<uchar>(y);
+    uchar *faceRow = face.ptr<uchar>(box.y + y);
+    for (int x = 0; x < box.width; x++) {
+      const int coverage = coverageRow[x];
+      uchar &pixel = faceRow[box.x + x];
+      pixel = uchar((int(pixel) * (255 - coverage) + int(InkBlack) * coverage) / 255);
+    }
+  }
+}
+
+/*
+The printed area of an upright face, a square pixelsPerFaceWidth wide.
+*/
+static cv::Mat renderFace(const FaceSpecification &face, int pixelsPerFaceWidth, GlyphCache &glyphs) {
+  const float scale = float(pixelsPerFaceWidth);
+  cv::Mat image(pixelsPerFaceWidth, pixelsPerFaceWidth, CV_8UC1, cv::Scalar(DieWhite));
+  drawUndoverline(image, scale, true, face.overlineCode);
+  drawUndoverline(image, scale, false, face.underlineCode);
+
+  // The letter and digit sit on the text's baseline, either side of the face's center
+  const OcrFont &font = *getFont();
+  const float charTop = FaceDimensionsFractional::textBaselineY - font.fontBaselineFraction * FaceDimensionsFractional::charHeight;
+  const float textLeft = FaceDimensionsFractional::center - FaceDimensionsFractional::textRegionWidth / 2;
+  const float digitLeft = textLeft + FaceDimensionsFractional::charWidth + FaceDimensionsFractional::spaceBetweenLetterAndDigit;
+  drawGlyph(image, scale, glyphs.get(face.letter),
+    textLeft, charTop, FaceDimensionsFractional::charWidth, FaceDimensionsFractional::charHeight);
+  drawGlyph(image, scale, glyphs.get(face.digit),
+    digitLeft, charTop, FaceDimensionsFractional::charWidth, FaceDimensionsFractional::charHeight);
+  return image;
+}
+
+static void fillRoundedSquare(cv::Mat &image, cv::Point2f center, float size, float cornerRadius, unsigned char gray) {
+  const int left = int(round(center.x - size / 2));
+  const int top = int(round(center.y - size / 2));
+  const int right = int(round(center.x + size / 2)) - 1;
+  const int bottom = int(round(center.y + size / 2)) - 1;
+  const int radius = int(round(cornerRadius));
+  const cv::Scalar color(gray);
+  cv::rectangle(image, cv::Point(left + radius, top), cv::Point(right - radius, bottom), color, cv::FILLED);
+  cv::rectangle(image, cv::Point(left, top + radius), cv::Point(right, bottom - radius), color, cv::FILLED);
+  cv::circle(image, cv::Point(left + radius, top + radius), radius, color, cv::FILLED);
+  cv::circle(image, cv::Point(right - radius, top + radius), radius, color, cv::FILLED);
+  cv::circle(image, cv::Point(left + radius, bottom - radius), radius, color, cv::FILLED);
+  cv::circle(image, cv::Point(right - radius, bottom - radius), radius, color, cv::FILLED);
+}
+
+/*
+A DiceKey (its 5x5 grid of dice in their box) viewed from straight above,
+with faces pixelsPerFaceWidth wide.
+*/
+static cv::Mat renderDiceKey(const std::string &key, int pixelsPerFaceWidth, GlyphCache &glyphs) {
+  const float scale = float(pixelsPerFaceWidth);
+  const int size = int(ceil(KeySizeInFaceWidths * scale));
+  cv::Mat image(size, size, CV_8UC1, cv::Scalar(BoxBlack));
+  for (int faceIndex = 0; faceIndex < 25; faceIndex++) {
+    const char letter = key[3 * faceIndex];
+    const char digit = key[3 * faceIndex + 1];
+    const char orientation = key[3 * faceIndex + 2];
+    const cv::Point2f dieCenter(
+      (BoxMargin + (float(faceIndex % 5) + 0.5f) * DiePitch) * scale,
+      (BoxMargin + (float(faceIndex / 5) + 0.5f) * DiePitch) * scale
+    );
+    fillRoundedSquare(image, dieCenter, DieSize * scale, DieCornerRadius * scale, DieWhite);
+
+    cv::Mat face = renderFace(*faceSpecification(letter, digit), pixelsPerFaceWidth, glyphs);
+    // Turn the face so its top points in the direction of its orientation
+    const int clockwiseTurns = int(strchr(FaceRotationLetters, orientation) - FaceRotationLetters);
+    if (clockwiseTurns != 0) {
+      cv::rotate(face, face,
+        clockwiseTurns == 1 ? cv::ROTATE_90_CLOCKWISE :
+        clockwiseTurns == 2 ? cv::ROTATE_180 :
+        cv::ROTATE_90_COUNTERCLOCKWISE);
+    }
+    const cv::Rect faceRect(
+      int(round(dieCenter.x - scale / 2)), int(round(dieCenter.y - scale / 2)),
+      pixelsPerFaceWidth, pixelsPerFaceWidth
+    );
+    face.copyTo(image(faceRect));
+  }
+  return image;
+}
+
+static cv::Scalar randomColor(std::mt19937 &random) {
+  std::uniform_int_distribution<int> level(0, 255);
+  return cv::Scalar(level(random), level(random), level(random));
+}
+
+/*
+Scatter shapes across a scene: rectangles, circles, lines, and bars with
+random dots that resemble undoverlines, sized relative to the
+faces of the DiceKey that will be placed over them.
+*/
+static void drawClutter(cv::Mat &scene, int numberOfShapes, float pixelsPerFaceWidth, std::mt19937 &random) {
+  std::uniform_real_distribution<float> x(0, float(scene.cols));
+  std::uniform_real_distribution<float> y(0, float(scene.rows));
+  std::uniform_real_distribution<float> faceWidths(0.3f, 4.0f);
+  std::uniform_real_distribution<float> degrees(0, 180);
+  std::uniform_int_distribution<int> shape(0, 3);
+  std::uniform_int_distribution<int> bit(0, 1);
+  for (int i = 0; i < numberOfShapes; i++) {
+    const cv::Point2f center(x(random), y(random));
+    const float width = faceWidths(random) * pixelsPerFaceWidth;
+    const float height = faceWidths(random) * pixelsPerFaceWidth;
+    switch (shape(random)) {
+      case 0: {
+        cv::Point2f corners[4];
+        cv::RotatedRect(center, cv::Size2f(width, height), degrees(random)).points(corners);
+        const cv::Point points[4] = { corners[0], corners[1], corners[2], corners[3] };
+        cv::fillConvexPoly(scene, points, 4, randomColor(random), cv::LINE_AA);
+        break;
+      }
+      case 1:
+        cv::circle(scene, center, int(width / 2), randomColor(random), cv::FILLED, cv::LINE_AA);
+        break;
+      case 2:
+        cv::line(scene, center, cv::Point2f(x(random), y(random)), randomColor(random),
+          std::max(1, int(height / 8)), cv::LINE_AA);
+        break;
+      default: {
+        // A black bar the size of an undoverline with white dots along it
+        cv::Mat bar(
+          std::max(1, int(round(FaceDimensionsFractional::undoverlineThickness * pixelsPerFaceWidth))),
+          std::max(1, int(round(FaceDimensionsFractional::undoverlineLength * pixelsPerFaceWidth))),
+          CV_8UC3, cv::Scalar(InkBlack, InkBlack, InkBlack));
+        for (int dot = 0; dot < NumberOfDotsInUndoverline; dot++) {
+          if (bit(random)) {
+            const float dotCenter = FaceDimensionsFractional::dotCentersAsFractionOfUndoverline[dot] * pixelsPerFaceWidth;
+            const float dotWidth = FaceDimensionsFractional::undoverlineDotWidth * pixelsPerFaceWidth;
+            cv::rectangle(bar,
+              cv::Point(int(round(dotCenter - dotWidth / 2)), int(round(FaceDimensionsFractional::overlineDotTop * pixelsPerFaceWidth))),
+              cv::Point(int(round(dotCenter + dotWidth / 2)) - 1, int(round((FaceDimensionsFractional::overlineDotTop + FaceDimensionsFractional::undoverlineDotHeight) * pixelsPerFaceWidth)) - 1),
+              cv::Scalar(DieWhite, DieWhite, DieWhite), cv::FILLED);
+          }
+        }
+        const float angleInRadians = float(degrees(random) * M_PI / 180);
+        const cv::Point2f barCenter(float(bar.cols) / 2, float(bar.rows) / 2);
+        const double placement[6] = {
+          cos(angleInRadians), -sin(angleInRadians), center.x - (cos(angleInRadians) * barCenter.x - sin(angleInRadians) * barCenter.y),
+          sin(angleInRadians), cos(angleInRadians), center.y - (sin(angleInRadians) * barCenter.x + cos(angleInRadians) * barCenter.y)
+        };
+        cv::warpAffine(bar, scene, cv::Mat(2, 3, CV_64F, (void*) placement), scene.size(), cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+      }
+    }
+  }
+}
+
+/*
+An image (BGR) of the DiceKey in a scene, distorted as the options specify.
+*/
+cv::Mat renderImage(const std::string &key, const ImageOptions &options, std::mt19937 &random, GlyphCache &glyphs) {
+  const float shorterSide = float(std::min(options.width, options.height));
+  const float keyWidth = float(options.scale.draw(random)) * shorterSide;
+  const float pixelsPerFaceWidth = keyWidth / KeySizeInFaceWidths;
+
+  // Draw the scene, and the DiceKey, at a multiple of the image's size so that
+  // reducing it to the image's size smooths the edges
+  const cv::Size sceneSize(options.width * Supersampling, options.height * Supersampling);
+  cv::Mat scene(sceneSize, CV_8UC3);
+  const cv::Scalar top = randomColor(random);
+  const cv::Scalar bottom = randomColor(random);
+  for (int y = 0; y < scene.rows; y++) {
+    const double fraction = double(y) / double(scene.rows);
+    scene.row(y).setTo(top * (1 - fraction) + bottom * fraction);
+  }
+  drawClutter(scene, int(round(options.clutter.draw(random))), pixelsPerFaceWidth * Supersampling, random);
+
+  const int renderedPixelsPerFaceWidth = std::max(16, int(ceil(pixelsPerFaceWidth * Supersampling)));
+  cv::Mat diceKeyGray = renderDiceKey(key, renderedPixelsPerFaceWidth, glyphs);
+  cv::Mat diceKey;
+  cv::cvtColor(diceKeyGray, diceKey, cv::COLOR_GRAY2BGR);
+
+  // Map the corners of the DiceKey to a square at the center of the scene, rotated,
+  // then move each corner to skew it in perspective
+  const float halfWidth = keyWidth * Supersampling / 2;
+  const float angleInRadians = float(options.rotation.draw(random) * M_PI / 180);
+  const float cosAngle = cos(angleInRadians);
+  const float sinAngle = sin(angleInRadians);
+  const cv::Point2f sceneCenter(float(sceneSize.width) / 2, float(sceneSize.height) / 2);
+  const float perspective = float(options.perspective.draw(random)) * keyWidth * Supersampling;
+  std::uniform_real_distribution<float> cornerMovement(-1, 1);
+  const float diceKeySize = float(diceKey.cols);
+  const cv::Point2f source[4] = {
+    cv::Point2f(0, 0), cv::Point2f(diceKeySize, 0), cv::Point2f(diceKeySize, diceKeySize), cv::Point2f(0, diceKeySize)
+  };
+  const cv::Point2f cornerDirections[4] = {
+    cv::Point2f(-1, -1), cv::Point2f(1, -1), cv::Point2f(1, 1), cv::Point2f(-1, 1)
+  };
+  cv::Point2f destination[4];
+  for (int corner = 0; corner < 4; corner++) {
+    const cv::Point2f d = cornerDirections[corner] * halfWidth;
+    destination[corner] = cv::Point2f(
+      sceneCenter.x + d.x * cosAngle - d.y * sinAngle + perspective * cornerMovement(random),
+      sceneCenter.y + d.x * sinAngle + d.y * cosAngle + perspective * cornerMovement(random)
+    );
+  }
+  cv::warpPerspective(diceKey, scene, cv::getPerspectiveTransform(source, destination), sceneSize,
+    cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+
+  cv::Mat image;
+  cv::resize(scene, image, cv::Size(options.width, options.height), 0, 0, cv::INTER_AREA);
+
+  // Glare: a patch, somewhere over the DiceKey, washed out toward white
+  const double glare = options.glare.draw(random);
+  if (glare > 0) {
+    std::uniform_real_distribution<float> offset(-keyWidth / 2, keyWidth / 2);
+    const cv::Point2f glareCenter(float(options.width) / 2 + offset(random), float(options.height) / 2 + offset(random));
+    const float glareRadius = std::uniform_real_distribution<float>(0.1f, 0.3f)(random) * keyWidth;
+    for (int y = 0; y < image.rows; y++) {
+      cv::Vec3b *row = image.ptr<cv::Vec3b>(y);
+      for (int x = 0; x < image.cols; x++) {
+        const float dx = float(x) - glareCenter.x;
+        const float dy = float(y) - glareCenter.y;
+        const double washout = glare * exp(-double(dx * dx + dy * dy) / double(2 * glareRadius * glareRadius));
+        for (int channel = 0; channel < 3; channel++) {
+          row[x][channel] = cv::saturate_cast<uchar>(row[x][channel] + (255 - row[x][channel]) * washout);
+        }
+      }
+    }
+  }
+
+  const double blur = options.blur.draw(random);
+  if (blur > 0) {
+    cv::GaussianBlur(image, image, cv::Size(0, 0), blur);
+  }
+
+  const double noise = options.noise.draw(random);
+  if (noise > 0) {
+    std::normal_distribution<float> sensorNoise(0, float(noise));
+    for (int y = 0; y < image.rows; y++) {
+      uchar *row = image.ptr<uchar>(y);
+      for (int i = 0; i < image.cols * 3; i++) {
+        row[i] = cv::saturate_cast<uchar>(float(row[i]) + sensorNoise(random));
+      }
+    }
+  }
+  return image;
+}
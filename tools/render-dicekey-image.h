@@ -0,0 +1,70 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+/*
+Rendering of synthetic images of DiceKeys, from the DiceKey specification and
+the outlines of the font the OCR recognizes (see generate-dicekey-images.cpp).
+*/
+
+#include <map>
+#include <random>
+#include <string>
+#include "graphics/cv.h"
+#include "font.h"
+
+/*
+A value for each image, drawn uniformly from [min, max].
+*/
+struct ValueRange {
+  double min;
+  double max;
+
+  double draw(std::mt19937 &random) const {
+    return max > min ? std::uniform_real_distribution<double>(min, max)(random) : min;
+  }
+};
+
+/*
+The 75-character human-readable form of a random DiceKey, which, like a real
+one, has each letter on exactly one die.
+*/
+std::string randomKey(std::mt19937 &random);
+
+// True if the key is in 75-character human-readable form
+bool isValidKey(const std::string &key);
+
+/*
+Glyphs of the font, filled, at the resolution of its outlines (255 where there is ink).
+
+The font records only the outline of each glyph, so the outline is filled by
+finding the regions it separates and filling those that the OCR's penalty
+table expects to be ink (which leaves the holes of glyphs such as 'A' empty).
+*/
+class GlyphCache {
+  std::map<char, cv::Mat> glyphs;
+
+  static cv::Mat fill(const OcrFont &font, const OcrAlphabet &alphabet, size_t characterIndex);
+  static bool find(const OcrAlphabet &alphabet, char character, size_t &characterIndex);
+
+public:
+  // The filled glyph of a letter or digit, or an empty Mat if it is not in the font
+  const cv::Mat& get(char character);
+};
+
+struct ImageOptions {
+  int width = 1280;
+  int height = 720;
+  ValueRange scale = { 0.7, 0.7 };
+  ValueRange rotation = { 0, 0 };
+  ValueRange perspective = { 0, 0 };
+  ValueRange blur = { 0, 0 };
+  ValueRange noise = { 0, 0 };
+  ValueRange glare = { 0, 0 };
+  ValueRange clutter = { 0, 0 };
+};
+
+/*
+An image (BGR) of the DiceKey in a scene, distorted as the options specify.
+*/
+cv::Mat renderImage(const std::string &key, const ImageOptions &options, std::mt19937 &random, GlyphCache &glyphs);
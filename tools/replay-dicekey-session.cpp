@@ -0,0 +1,164 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+/*
+Replay a recorded scanning session through a DiceKeyImageProcessor at a
+simulated frame rate, and report how many frames, and how many simulated
+milliseconds, it took for the processor to finish (isFinished()), the
+totalError of the key it finished with, and percentiles of the time taken
+to process each frame.
+
+The processor's clock advances by one frame period per frame, so the frames
+it terminates after do not depend on how fast this machine processes them.
+
+The session is either a directory of images, replayed in the order of their
+file names, or a raw frame container (see raw-frames.h).
+
+Usage: replay-dicekey-session <directory-or-raw-frames> [options]
+  --fps N         the simulated frame rate (default 30)
+  --loop          replay the session repeatedly until the processor finishes
+  --max-frames N  stop after N frames even if not finished (default 10000 with --loop)
+  --json          report as a JSON object
+
+Exits with 0 if the processor finished, 3 if it did not, and 1 if no frames
+could be read or a raw frame container is truncated.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+#include "graphics/cv.h"
+#include "read-dicekey.hpp"
+#include "raw-frames.h"
+
+static bool loadImages(const std::string &directory, std::vector<RawFrame> &frames) {
+  std::vector<cv::String> paths;
+  cv::glob(directory + "/*", paths, false);
+  std::sort(paths.begin(), paths.end());
+  for (const cv::String &path : paths) {
+    const cv::Mat colorImage = cv::imread(path, cv::IMREAD_COLOR);
+    if (colorImage.empty()) {
+      // Not an image
+      continue;
+    }
+    cv::Mat rgbaImage;
+    cv::cvtColor(colorImage, rgbaImage, cv::COLOR_BGR2RGBA);
+    RawFrame frame;
+    frame.width = uint32_t(rgbaImage.cols);
+    frame.height = uint32_t(rgbaImage.rows);
+    frame.rgba.assign((const uint32_t*) rgbaImage.data, (const uint32_t*) rgbaImage.data + rgbaImage.total());
+    frames.push_back(std::move(frame));
+  }
+  return !frames.empty();
+}
+
+// The latency below which the given fraction of frames were processed
+static double percentile(const std::vector<double> &sortedValues, double fraction) {
+  if (sortedValues.empty()) {
+    return 0;
+  }
+  const size_t index = size_t(fraction * double(sortedValues.size() - 1) + 0.5);
+  return sortedValues[std::min(index, sortedValues.size() - 1)];
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <directory-or-raw-frames> [--fps N] [--loop] [--max-frames N] [--json]\n", argv[0]);
+    return 2;
+  }
+  const std::string sessionPath = argv[1];
+  double fps = 30;
+  bool loop = false;
+  size_t maxFrames = 0;
+  bool json = false;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+      fps = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--loop") == 0) {
+      loop = true;
+    } else if (strcmp(argv[i], "--max-frames") == 0 && i + 1 < argc) {
+      maxFrames = size_t(strtoull(argv[++i], NULL, 10));
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (fps <= 0) {
+    fprintf(stderr, "The frame rate must be positive\n");
+    return 2;
+  }
+
+  // Decode every frame before replaying, so that decoding is not timed
+  std::vector<RawFrame> frames;
+  const RawFramesReadResult rawFramesRead = readRawFrames(sessionPath, frames);
+  if (rawFramesRead == RawFramesReadResult::Corrupt) {
+    fprintf(stderr, "%s is truncated or corrupt after frame %zu\n", sessionPath.c_str(), frames.size());
+    return 1;
+  }
+  if (rawFramesRead == RawFramesReadResult::NotRawFrames && !loadImages(sessionPath, frames)) {
+    fprintf(stderr, "No frames could be read from %s\n", sessionPath.c_str());
+    return 1;
+  }
+  if (maxFrames == 0) {
+    maxFrames = loop ? 10000 : frames.size();
+  }
+
+  // The simulated clock starts at an arbitrary fixed time and advances one
+  // frame period before each frame is processed
+  const std::chrono::system_clock::time_point sessionStart = std::chrono::system_clock::time_point(std::chrono::hours(24));
+  const std::chrono::system_clock::duration framePeriod =
+    std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double>(1.0 / fps));
+  std::chrono::system_clock::time_point simulatedNow = sessionStart;
+
+  DiceKeyImageProcessor processor;
+  processor.setClock([&simulatedNow]() { return simulatedNow; });
+
+  std::vector<double> latenciesInMilliseconds;
+  size_t framesProcessed = 0;
+  bool finished = false;
+  while (!finished && framesProcessed < maxFrames) {
+    if (!loop && framesProcessed == frames.size()) {
+      break;
+    }
+    const RawFrame &frame = frames[framesProcessed % frames.size()];
+    simulatedNow = sessionStart + framePeriod * int(framesProcessed);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    processor.processRGBAImage(int(frame.width), int(frame.height), frame.rgba.data());
+    latenciesInMilliseconds.push_back(
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    framesProcessed++;
+    finished = processor.isFinished();
+  }
+
+  const double simulatedMilliseconds = std::chrono::duration<double, std::milli>(framePeriod).count() * double(framesProcessed);
+  const DiceKey<FaceRead> &diceKey = processor.diceKeyRead();
+  // -1 if no key was read
+  const long long totalError = diceKey.isInitialized() ? (long long) diceKey.totalError() : -1;
+  std::vector<double> sortedLatencies = latenciesInMilliseconds;
+  std::sort(sortedLatencies.begin(), sortedLatencies.end());
+  const double p50 = percentile(sortedLatencies, 0.5);
+  const double p90 = percentile(sortedLatencies, 0.9);
+  const double p99 = percentile(sortedLatencies, 0.99);
+  const double max = sortedLatencies.empty() ? 0 : sortedLatencies.back();
+
+  if (json) {
+    printf(
+      "{\"finished\": %s, \"frames\": %zu, \"simulatedMilliseconds\": %.3f, \"totalError\": %lld, "
+      "\"latencyMilliseconds\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}}\n",
+      finished ? "true" : "false", framesProcessed, simulatedMilliseconds, totalError, p50, p90, p99, max
+    );
+  } else {
+    printf("%-24s %s\n", "finished", finished ? "yes" : "no");
+    printf("%-24s %zu\n", "frames", framesProcessed);
+    printf("%-24s %.3f\n", "simulated ms", simulatedMilliseconds);
+    printf("%-24s %lld\n", "total error", totalError);
+    printf("%-24s p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", "frame latency (ms)", p50, p90, p99, max);
+  }
+  return finished ? 0 : 3;
+}
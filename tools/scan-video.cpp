@@ -0,0 +1,164 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/videoio.hpp>
+#include "graphics/cv.h"
+#include "scan-video.h"
+
+namespace {
+
+struct VideoFrame {
+  cv::Mat grayscale;
+  size_t index = 0;
+  double timestampMilliseconds = 0;
+};
+
+/*
+A ring of decoded frames, filled by the decoding thread and emptied by the
+reading thread.  Each slot is written only by the decoder while it is free,
+and read only by the reader while it holds a frame, so the mutex guards only
+the counts of frames decoded and read.
+*/
+class VideoFrameRing {
+  std::vector<VideoFrame> slots;
+  size_t framesDecoded = 0;
+  size_t framesRead = 0;
+  bool endOfVideo = false;
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable slotFree;
+  std::condition_variable frameDecoded;
+
+public:
+  explicit VideoFrameRing(size_t size) : slots(size) {}
+
+  // The next slot to decode into, or nullptr if reading has stopped
+  VideoFrame* waitForFreeSlot() {
+    std::unique_lock<std::mutex> lock(mutex);
+    slotFree.wait(lock, [this]() { return stopping || framesDecoded - framesRead < slots.size(); });
+    return stopping ? nullptr : &slots[framesDecoded % slots.size()];
+  }
+
+  void decoded() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      framesDecoded++;
+    }
+    frameDecoded.notify_one();
+  }
+
+  void ended() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      endOfVideo = true;
+    }
+    frameDecoded.notify_one();
+  }
+
+  // The next frame to read, which stays valid until read() is called,
+  // or nullptr if the video has ended
+  VideoFrame* waitForFrame() {
+    std::unique_lock<std::mutex> lock(mutex);
+    frameDecoded.wait(lock, [this]() { return endOfVideo || framesDecoded > framesRead; });
+    return framesDecoded > framesRead ? &slots[framesRead % slots.size()] : nullptr;
+  }
+
+  void read() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      framesRead++;
+    }
+    slotFree.notify_one();
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    slotFree.notify_one();
+  }
+};
+
+void decodeFrames(cv::VideoCapture &capture, VideoFrameRing &ring, size_t &framesDecoded) {
+  const double framesPerSecond = capture.get(cv::CAP_PROP_FPS);
+  // The decoder's output, whose buffer the decoder reuses between frames
+  cv::Mat decoded;
+  while (VideoFrame* slot = ring.waitForFreeSlot()) {
+    if (!capture.read(decoded) || decoded.empty()) {
+      break;
+    }
+    if (decoded.channels() == 1) {
+      decoded.copyTo(slot->grayscale);
+    } else {
+      cv::cvtColor(decoded, slot->grayscale, decoded.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+    slot->index = framesDecoded;
+    slot->timestampMilliseconds = capture.get(cv::CAP_PROP_POS_MSEC);
+    if (slot->timestampMilliseconds <= 0 && framesDecoded > 0 && framesPerSecond > 0) {
+      // Some backends don't report timestamps, so infer them from the frame rate
+      slot->timestampMilliseconds = double(framesDecoded) * 1000.0 / framesPerSecond;
+    }
+    framesDecoded++;
+    ring.decoded();
+  }
+  ring.ended();
+}
+
+}
+
+VideoScanResult scanVideo(
+  const std::string &path,
+  DiceKeyImageProcessor &processor,
+  size_t frameRingSize
+) {
+  VideoScanResult result;
+  cv::VideoCapture capture(path);
+  if (!capture.isOpened()) {
+    return result;
+  }
+  result.opened = true;
+
+  // The processor's clock reads the timestamp of the frame being read
+  const std::chrono::system_clock::time_point videoStart = std::chrono::system_clock::time_point(std::chrono::hours(24));
+  double timestampMilliseconds = 0;
+  processor.setClock([&videoStart, &timestampMilliseconds]() {
+    return videoStart + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+      std::chrono::duration<double, std::milli>(timestampMilliseconds));
+  });
+
+  VideoFrameRing ring(frameRingSize > 0 ? frameRingSize : 1);
+  size_t framesDecoded = 0;
+  std::thread decoder(decodeFrames, std::ref(capture), std::ref(ring), std::ref(framesDecoded));
+
+  while (true) {
+    const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    VideoFrame* frame = ring.waitForFrame();
+    const std::chrono::steady_clock::time_point readStart = std::chrono::steady_clock::now();
+    result.waitForDecodeMicroseconds += std::chrono::duration<double, std::micro>(readStart - waitStart).count();
+    if (frame == nullptr) {
+      break;
+    }
+    timestampMilliseconds = frame->timestampMilliseconds;
+    processor.processImage(frame->grayscale.cols, frame->grayscale.rows, frame->grayscale.step, frame->grayscale.data);
+    result.readMicroseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - readStart).count();
+    result.framesRead++;
+    result.frameIndex = frame->index;
+    result.timestampMilliseconds = frame->timestampMilliseconds;
+    ring.read();
+    if (processor.isFinished()) {
+      result.finished = true;
+      break;
+    }
+  }
+  ring.stop();
+  decoder.join();
+  result.framesDecoded = framesDecoded;
+  // Leave the processor with a clock that remains valid after returning
+  processor.setClock(std::chrono::system_clock::now);
+  return result;
+}
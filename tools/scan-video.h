@@ -0,0 +1,51 @@
+//  © 2019 Stuart Edward Schechter (Github: @uppajung)
+
+#pragma once
+
+/*
+Scan a video file, as a camera would be scanned, until a DiceKeyImageProcessor
+finishes reading a DiceKey (isFinished()) or the video ends.
+
+Frames are decoded (with cv::VideoCapture) on a thread of their own, into a
+bounded ring of grayscale frames that the processor reads from, so decoding
+the next frames overlaps reading the current one.  Each frame is converted
+from the decoder's output straight into the grayscale buffer of its slot in
+the ring, which the processor reads in place, and the slots' buffers are
+reused from frame to frame.
+
+The processor's clock follows the video's timestamps, so it gives up on
+correcting errors after the same stretch of video however fast frames are
+read.
+
+Requires OpenCV's videoio module (see DICEKEY_VIDEO_INPUT in CMakeLists.txt).
+*/
+
+#include <stddef.h>
+#include <string>
+#include "read-dicekey.hpp"
+
+// The number of decoded frames that may wait to be read
+const size_t DefaultVideoFrameRingSize = 4;
+
+struct VideoScanResult {
+  // False if the file could not be opened as a video
+  bool opened = false;
+  // True if the processor finished reading a DiceKey before the video ended
+  bool finished = false;
+  size_t framesDecoded = 0;
+  size_t framesRead = 0;
+  // The index and timestamp (in milliseconds from the start of the video) of
+  // the frame after which the processor finished, or of the last frame read
+  // if it did not finish
+  size_t frameIndex = 0;
+  double timestampMilliseconds = 0;
+  // Time spent reading frames, and waiting for frames to be decoded, in microseconds
+  double readMicroseconds = 0;
+  double waitForDecodeMicroseconds = 0;
+};
+
+VideoScanResult scanVideo(
+  const std::string &path,
+  DiceKeyImageProcessor &processor,
+  size_t frameRingSize = DefaultVideoFrameRingSize
+);